@@ -0,0 +1,92 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Every benchmark is a single translation unit including this header, it counts the allocations of the benchmark.
+#define MODBUS_DEFINE_ALLOCATION_COUNTER
+#include <modbus/allocation_counter.hpp>
+
+namespace modbus::bench {
+
+/// Result of a single benchmark case.
+struct result {
+  std::string name;
+  std::size_t iterations;
+  double ns_per_op;
+  double allocations_per_op;
+};
+
+/// Print a result as a single table row.
+inline void print(result const& res) {
+  std::cout << std::left << std::setw(72) << res.name << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+            << res.ns_per_op << " ns/op" << std::setw(10) << std::setprecision(2) << res.allocations_per_op
+            << " allocs/op\n";
+}
+
+/// Print results as a JSON document, for comparing runs between releases.
+/**
+ * {"benchmarks": [{"name": ..., "iterations": ..., "ns_per_op": ..., "allocations_per_op": ...}, ...]}
+ */
+inline void print_json(std::span<result const> results, std::ostream& out = std::cout) {
+  out << "{\"benchmarks\": [";
+  for (std::size_t index = 0; index < results.size(); ++index) {
+    auto const& res = results[index];
+    out << (index == 0 ? "\n" : ",\n") << "  {\"name\": \"";
+    for (char character : res.name) {
+      if (character == '"' || character == '\\') {
+        out << '\\';
+      }
+      out << character;
+    }
+    out << "\", \"iterations\": " << res.iterations << std::fixed << std::setprecision(3)
+        << ", \"ns_per_op\": " << res.ns_per_op << ", \"allocations_per_op\": " << res.allocations_per_op << '}';
+  }
+  out << "\n]}\n";
+}
+
+/// Keep the compiler from dropping the computation of value or hoisting it out of the benchmark loop.
+template <typename value_t>
+inline void do_not_optimize(value_t const& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// Measures elapsed time and allocations of the calling thread from construction until stop.
+struct stopwatch {
+  std::uint64_t allocations_start{ thread_allocation_count().allocations };
+  std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+
+  [[nodiscard]] auto stop(std::string_view name, std::size_t iterations) const -> result {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto allocations = thread_allocation_count().allocations - allocations_start;
+    return { std::string{ name }, iterations,
+             static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+                 static_cast<double>(iterations),
+             static_cast<double>(allocations) / static_cast<double>(iterations) };
+  }
+};
+
+/// Measure the time and calling thread allocations of iterations calls to run.
+/**
+ * warmup calls are made first so caches, pools and connections are in steady state.
+ */
+template <typename function_t>
+auto measure(std::string_view name, std::size_t iterations, function_t&& run, std::size_t warmup = 100) -> result {
+  for (std::size_t i = 0; i < warmup; ++i) {
+    run();
+  }
+  stopwatch watch{};
+  for (std::size_t i = 0; i < iterations; ++i) {
+    run();
+  }
+  return watch.stop(name, iterations);
+}
+
+}  // namespace modbus::bench
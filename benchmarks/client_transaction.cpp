@@ -0,0 +1,137 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// Per request overhead of the client against a loopback server running on its own thread.
+// Compares the previous co_spawn + async_compose transaction path with the composed operation used now.
+
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include <modbus/client.hpp>
+#include <modbus/default_handler.hpp>
+#include <modbus/server.hpp>
+
+#include "bench.hpp"
+
+namespace {
+
+/// Client sending requests the way the client did before transactions became a composed operation.
+class legacy_client : public modbus::client {
+public:
+  using modbus::client::client;
+
+  template <typename completion_token>
+  auto read_holding_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, completion_token&& token) {
+    using response_type = modbus::response::read_holding_registers;
+    return modbus::async_compose<completion_token, void(std::expected<response_type, std::error_code>)>(
+        [this, unit, request = modbus::request::read_holding_registers{ address, count }](auto& self_outer) {
+          co_spawn(
+              ctx_,
+              [this, unit, request, self = std::move(self_outer)]() mutable -> asio::awaitable<void> {
+                modbus::tcp_mbap request_header{ .transaction = ++next_id_,
+                                                 .protocol = 0,
+                                                 .length = static_cast<uint16_t>(request.length() + 1U),
+                                                 .unit = unit };
+                auto header_encoded = request_header.to_bytes();
+                auto request_serialized = modbus::impl::serialize_request(request);
+                std::vector<asio::const_buffer> buffers{ { asio::buffer(header_encoded),
+                                                           asio::buffer(request_serialized) } };
+                co_await asio::async_write(socket_, buffers, asio::use_awaitable);
+
+                std::array<uint8_t, modbus::tcp_mbap::size> header_buffer{};
+                auto [header_error, header_size] =
+                    co_await asio::async_read(socket_, asio::buffer(header_buffer), asio::as_tuple(asio::use_awaitable));
+                if (header_error) {
+                  self.complete(std::unexpected(header_error));
+                  co_return;
+                }
+                auto header = modbus::tcp_mbap::from_bytes(header_buffer);
+                std::array<uint8_t, modbus::modbus_max_pdu> read_buffer{};
+                auto [body_error, body_size] = co_await asio::async_read(
+                    socket_, asio::buffer(read_buffer, header.length - 1), asio::as_tuple(asio::use_awaitable));
+                if (body_error) {
+                  self.complete(std::unexpected(body_error));
+                  co_return;
+                }
+                auto response = modbus::impl::deserialize_response(read_buffer, response_type::function);
+                if (!response) {
+                  self.complete(std::unexpected(response.error()));
+                  co_return;
+                }
+                self.complete(std::move(std::get<response_type>(response.value())));
+              },
+              asio::detached);
+        },
+        token, ctx_);
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+  std::uint16_t port = 15510;
+
+  asio::io_context server_ctx;
+  auto handler = std::make_shared<modbus::default_handler>();
+  modbus::server server{ server_ctx, handler, port };
+  server.start();
+  std::thread server_thread{ [&server_ctx]() { server_ctx.run(); } };
+
+  asio::io_context ctx;
+  legacy_client client{ ctx };
+
+  co_spawn(
+      ctx,
+      [&]() -> asio::awaitable<void> {
+        auto [connect_error] =
+            co_await client.connect("127.0.0.1", std::to_string(port), asio::as_tuple(asio::use_awaitable));
+        if (connect_error) {
+          std::cerr << "Error connecting: " << connect_error.message() << '\n';
+          co_return;
+        }
+
+        auto legacy = [&]() -> asio::awaitable<void> {
+          auto res = co_await client.read_holding_registers(0, 0, 16, asio::use_awaitable);
+          if (!res) {
+            std::cerr << "Error reading: " << res.error().message() << '\n';
+          }
+        };
+        auto composed = [&]() -> asio::awaitable<void> {
+          auto res = co_await client.modbus::client::read_holding_registers(0, 0, 16, asio::use_awaitable);
+          if (!res) {
+            std::cerr << "Error reading: " << res.error().message() << '\n';
+          }
+        };
+        auto view = [&]() -> asio::awaitable<void> {
+          auto res = co_await client.read_holding_registers_view(0, 0, 16, asio::use_awaitable);
+          if (!res) {
+            std::cerr << "Error reading: " << res.error().message() << '\n';
+          }
+        };
+
+        auto run = [&](std::string_view name, auto& function) -> asio::awaitable<void> {
+          for (std::size_t i = 0; i < 100; ++i) {
+            co_await function();
+          }
+          modbus::bench::stopwatch watch{};
+          for (std::size_t i = 0; i < iterations; ++i) {
+            co_await function();
+          }
+          modbus::bench::print(watch.stop(name, iterations));
+        };
+
+        co_await run("read_holding_registers co_spawn + async_compose (before)", legacy);
+        co_await run("read_holding_registers composed op", composed);
+        co_await run("read_holding_registers_view composed op", view);
+
+        auto stats = modbus::recycling_pool::this_thread().stats();
+        std::cout << "client thread recycling pool: " << stats.hits << " hits, " << stats.misses << " misses\n";
+        client.close();
+      },
+      asio::detached);
+  ctx.run();
+
+  server_ctx.stop();
+  server_thread.join();
+}
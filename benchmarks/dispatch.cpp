@@ -0,0 +1,119 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// Cost of decoding a request, calling the handler and encoding the response, per function code.
+// Compares the previous three std::visit path with the compile time dispatch table used now, and
+// register reads from host order storage with reads from wire order storage and from the response cache.
+
+#include <array>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <modbus/default_handler.hpp>
+#include <modbus/response_cache.hpp>
+#include <modbus/server.hpp>
+
+#include "bench.hpp"
+
+namespace {
+
+/// Request handling the way the server did it before the dispatch table.
+auto legacy_handle_request(modbus::tcp_mbap const& header, std::span<uint8_t const> data, auto& handler)
+    -> std::expected<std::vector<uint8_t>, modbus::errc_t> {
+  auto req_variant = modbus::impl::deserialize_request(data, static_cast<modbus::function_e>(data[0]));
+  if (!req_variant) {
+    return std::unexpected(modbus::errc_t::illegal_data_value);
+  }
+  return std::visit(
+      [&](auto& request) -> std::expected<std::vector<uint8_t>, modbus::errc_t> {
+        modbus::errc_t error = modbus::errc_t::no_error;
+        modbus::response::responses resp = handler->handle(header.unit, request, error);
+        if (error) {
+          return std::unexpected(error);
+        }
+        return modbus::impl::serialize_response(resp);
+      },
+      req_variant.value());
+}
+
+template <typename request_t>
+void compare(std::string_view name,
+             request_t const& request,
+             std::shared_ptr<modbus::default_handler>& handler,
+             std::size_t iterations) {
+  auto encoded = request.serialize();
+  std::span<uint8_t const> pdu{ encoded };
+  modbus::tcp_mbap header{
+    .transaction = 1, .protocol = 0, .length = static_cast<uint16_t>(encoded.size() + 1), .unit = 0
+  };
+  std::size_t bytes{};
+  std::string legacy_name = std::string{ name } + " three visits";
+  std::string table_name = std::string{ name } + " dispatch table";
+  modbus::bench::print(modbus::bench::measure(legacy_name, iterations, [&]() {
+    bytes += legacy_handle_request(header, pdu, handler)->size();
+  }));
+  modbus::bench::print(modbus::bench::measure(table_name, iterations, [&]() {
+    bytes += modbus::handle_request(header, pdu, handler)->size();
+  }));
+  if (bytes == 0) {
+    std::cerr << "no response for " << name << '\n';
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  auto handler = std::make_shared<modbus::default_handler>();
+
+  compare("read_coils", modbus::request::read_coils{ 0, 16 }, handler, iterations);
+  compare("read_discrete_inputs", modbus::request::read_discrete_inputs{ 0, 16 }, handler, iterations);
+  compare("read_holding_registers", modbus::request::read_holding_registers{ 0, 16 }, handler, iterations);
+  compare("read_input_registers", modbus::request::read_input_registers{ 0, 16 }, handler, iterations);
+  compare("write_single_coil", modbus::request::write_single_coil{ 0, true }, handler, iterations);
+  compare("write_single_register", modbus::request::write_single_register{ 0, 42 }, handler, iterations);
+  compare("write_multiple_coils", modbus::request::write_multiple_coils{ 0, std::vector<bool>(16, true) }, handler,
+          iterations);
+  compare("write_multiple_registers", modbus::request::write_multiple_registers{ 0, std::vector<uint16_t>(16, 42) },
+          handler, iterations);
+  compare("mask_write_register", modbus::request::mask_write_register{ 0, 0xff00, 0x00ff }, handler, iterations);
+  compare("read_write_multiple_registers",
+          modbus::request::read_write_multiple_registers{ 0, 16, 16, std::vector<uint16_t>(16, 42) }, handler,
+          iterations);
+
+  // Unsupported function codes are rejected without building a request
+  std::array<uint8_t, 4> encoded{ 0x2b, 0x0e, 0x01, 0x00 };
+  std::span<uint8_t const> unsupported{ encoded };
+  modbus::tcp_mbap header{ .transaction = 1, .protocol = 0, .length = 5, .unit = 0 };
+  std::size_t rejected{};
+  modbus::bench::print(modbus::bench::measure("unsupported function dispatch table", iterations, [&]() {
+    rejected += modbus::handle_request(header, unsupported, handler).has_value() ? 0 : 1;
+  }));
+  if (rejected == 0) {
+    std::cerr << "unsupported function was answered\n";
+  }
+
+  // Register reads from host order storage against wire order storage
+  auto wire_handler = std::make_shared<modbus::wire_default_handler>();
+  std::vector<uint16_t> values(125, 42);
+  handler->registers.write(0, values);
+  wire_handler->registers.write(0, values);
+  auto read_request = modbus::request::read_holding_registers{ 0, 125 }.serialize();
+  std::span<uint8_t const> read_pdu{ read_request };
+  header.length = static_cast<uint16_t>(read_request.size() + 1);
+  std::size_t bytes{};
+  modbus::bench::print(modbus::bench::measure("read 125 registers host order", iterations, [&]() {
+    bytes += modbus::handle_request(header, read_pdu, handler)->size();
+  }));
+  modbus::bench::print(modbus::bench::measure("read 125 registers wire order", iterations, [&]() {
+    bytes += modbus::handle_request(header, read_pdu, wire_handler)->size();
+  }));
+  auto cache = std::make_shared<modbus::response_cache<modbus::default_handler>>(handler);
+  modbus::bench::print(modbus::bench::measure("read 125 registers cached", iterations, [&]() {
+    bytes += modbus::handle_request(header, read_pdu, cache)->size();
+  }));
+  if (bytes == 0) {
+    std::cerr << "no response for register reads\n";
+  }
+}
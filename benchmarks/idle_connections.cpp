@@ -0,0 +1,147 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// Resident memory of the server per idle client connection.
+// The clients run in a separate process so only the memory of the server side is measured.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <modbus/default_handler.hpp>
+#include <modbus/server.hpp>
+
+namespace {
+
+constexpr std::uint16_t port = 15520;
+
+/// Connections from a single source address to a single destination are limited by the ephemeral ports.
+constexpr std::size_t connections_per_address = 20000;
+
+auto resident_bytes() -> std::size_t {
+  std::ifstream statm{ "/proc/self/statm" };
+  std::size_t size{};
+  std::size_t resident{};
+  statm >> size >> resident;
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+/// Open count connections to the server and keep them open until killed.
+[[noreturn]] void run_clients(std::size_t count, int ready_fd, int done_fd) {
+  char byte{};
+  if (read(ready_fd, &byte, 1) != 1) {
+    std::_Exit(1);
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    // Spread the connections over 127.0.0.1, 127.0.0.2, ... to stay within the ephemeral port range.
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK + static_cast<std::uint32_t>(i / connections_per_address));
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+      std::cerr << "connect failed after " << i << " connections\n";
+      std::_Exit(1);
+    }
+  }
+  if (write(done_fd, &byte, 1) != 1) {
+    std::_Exit(1);
+  }
+  for (;;) {
+    pause();
+  }
+}
+
+/// Run a server with count idle connections and report its resident memory per connection.
+[[noreturn]] void run_server(std::size_t count, bool park_idle_connections) {
+  std::array<int, 2> ready{};
+  std::array<int, 2> done{};
+  if (pipe(ready.data()) != 0 || pipe(done.data()) != 0) {
+    std::_Exit(1);
+  }
+  pid_t clients = fork();
+  if (clients == 0) {
+    run_clients(count, ready[0], done[1]);
+  }
+
+  asio::io_context ctx;
+  auto handler = std::make_shared<modbus::default_handler>();
+  modbus::server server{ ctx, handler, port,
+                         modbus::server_options{ .idle_timeout = {}, .park_idle_connections = park_idle_connections } };
+  server.start();
+  ctx.poll();
+  auto before = resident_bytes();
+
+  char byte{};
+  if (write(ready[1], &byte, 1) != 1) {
+    std::_Exit(1);
+  }
+  bool clients_done = false;
+  asio::steady_timer poll_timer{ ctx };
+  std::function<void()> check = [&]() {
+    if (!clients_done) {
+      pollfd done_poll{ .fd = done[0], .events = POLLIN, .revents = 0 };
+      clients_done = poll(&done_poll, 1, 0) == 1;
+    }
+    if (clients_done && server.connections() == count) {
+      ctx.stop();
+      return;
+    }
+    poll_timer.expires_after(std::chrono::milliseconds(10));
+    poll_timer.async_wait([&](std::error_code const&) { check(); });
+  };
+  check();
+  ctx.run();
+  auto after = resident_bytes();
+
+  std::string name = std::to_string(count) + " idle connections, park_idle_connections=" +
+                     (park_idle_connections ? "true" : "false");
+  std::cout << std::left << std::setw(60) << name << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+            << static_cast<double>(after - before) / static_cast<double>(count) << " bytes/conn" << std::setw(12)
+            << (after - before) / 1024 << " KiB total" << std::endl;
+
+  kill(clients, SIGKILL);
+  waitpid(clients, nullptr, 0);
+  std::_Exit(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  rlimit files{};
+  getrlimit(RLIMIT_NOFILE, &files);
+  files.rlim_cur = files.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &files);
+
+  std::vector<std::size_t> counts{ 10000, 100000 };
+  if (argc > 1) {
+    counts = { std::strtoul(argv[1], nullptr, 10) };
+  }
+  for (auto count : counts) {
+    if (count + 64 > files.rlim_cur) {
+      std::cout << "skipping " << count << " connections, open file limit is " << files.rlim_cur << '\n';
+      continue;
+    }
+    for (bool park_idle_connections : { false, true }) {
+      std::cout.flush();
+      pid_t server = fork();
+      if (server == 0) {
+        run_server(count, park_idle_connections);
+      }
+      int status{};
+      waitpid(server, &status, 0);
+    }
+  }
+}
@@ -0,0 +1,387 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// Throughput and latency of a server<default_handler> driven by many clients over loopback.
+// Sweeps the number of connections, the pipelining depth, the function mix and the payload size and
+// reports requests per second, round trip percentiles, CPU time per request and resident memory.
+//
+// Connections with a depth of 1 are modbus::client instances. The client runs one transaction at a time, so
+// deeper pipelines write depth encoded requests back to back on a plain socket and then read the depth responses.
+// The server runs on its own thread, all connections share a second one. With --delay or --jitter the
+// connections go through a fault_proxy on the server thread holding every frame for the delay plus up to
+// the jitter, in microseconds.
+//
+// usage: loopback_benchmark [--connections 1,10,...] [--depth 1,8,...] [--mix read,write,mixed]
+//                           [--registers 16,...] [--duration milliseconds] [--delay us] [--jitter us] [--json]
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <modbus/client.hpp>
+#include <modbus/default_handler.hpp>
+#include <modbus/fault_proxy.hpp>
+#include <modbus/metrics.hpp>
+#include <modbus/server.hpp>
+
+namespace {
+
+constexpr std::uint16_t port = 15530;
+
+enum struct mix_e : std::uint8_t {
+  /// Only read_holding_registers.
+  read,
+  /// Only write_multiple_registers.
+  write,
+  /// Four reads to every write.
+  mixed,
+};
+
+constexpr std::array<std::string_view, 3> mix_names{ "read", "write", "mixed" };
+
+struct scenario {
+  std::size_t connections;
+  std::size_t depth;
+  mix_e mix;
+  std::size_t registers;
+};
+
+struct outcome {
+  scenario setup;
+  double requests_per_second;
+  std::chrono::nanoseconds p50;
+  std::chrono::nanoseconds p99;
+  std::chrono::nanoseconds p999;
+  double cpu_ns_per_request;
+  std::size_t resident_bytes;
+  std::uint64_t errors;
+};
+
+auto is_write(mix_e mix, std::size_t transaction) -> bool {
+  return mix == mix_e::write || (mix == mix_e::mixed && transaction % 5 == 4);
+}
+
+auto cpu_time() -> std::chrono::nanoseconds {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  auto seconds = std::chrono::seconds{ usage.ru_utime.tv_sec + usage.ru_stime.tv_sec };
+  auto microseconds = std::chrono::microseconds{ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec };
+  return seconds + microseconds;
+}
+
+auto resident_bytes() -> std::size_t {
+  std::ifstream statm{ "/proc/self/statm" };
+  std::size_t size{};
+  std::size_t resident{};
+  statm >> size >> resident;
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+/// Run transactions on a client until deadline, the client records them in its metrics.
+auto drive_client(modbus::client& client,
+                  scenario setup,
+                  std::chrono::steady_clock::time_point deadline,
+                  std::uint64_t& errors) -> asio::awaitable<void> {
+  auto count = static_cast<std::uint16_t>(setup.registers);
+  std::vector<std::uint16_t> values(std::min<std::size_t>(setup.registers, 123), 42);
+  for (std::size_t transaction = 0; std::chrono::steady_clock::now() < deadline; ++transaction) {
+    if (is_write(setup.mix, transaction)) {
+      errors += (co_await client.write_multiple_registers(1, 0, values, asio::use_awaitable)).has_value() ? 0 : 1;
+    } else {
+      errors += (co_await client.read_holding_registers_view(1, 0, count, asio::use_awaitable)).has_value() ? 0 : 1;
+    }
+  }
+}
+
+/// Write depth requests at a time on socket and read their responses until deadline.
+auto drive_pipeline(asio::ip::tcp::socket& socket,
+                    scenario setup,
+                    std::chrono::steady_clock::time_point deadline,
+                    modbus::metrics& registry,
+                    std::uint64_t& errors) -> asio::awaitable<void> {
+  modbus::request::read_holding_registers read{ 0, static_cast<std::uint16_t>(setup.registers) };
+  modbus::request::write_multiple_registers write{ 0,
+                                                   std::vector<std::uint16_t>(std::min<std::size_t>(setup.registers, 123),
+                                                                              42) };
+  std::vector<std::uint8_t> requests((modbus::tcp_mbap::size + modbus::modbus_max_pdu) * setup.depth);
+  std::array<std::uint8_t, modbus::tcp_mbap::size> header_buffer{};
+  std::array<std::uint8_t, modbus::modbus_max_pdu> body{};
+  std::uint16_t next_id{};
+  for (std::size_t transaction = 0; std::chrono::steady_clock::now() < deadline;) {
+    std::size_t size{};
+    for (std::size_t request = 0; request < setup.depth; ++request, ++transaction) {
+      auto encode = [&](auto const& message) {
+        modbus::tcp_mbap header{ .transaction = ++next_id,
+                                 .protocol = 0,
+                                 .length = static_cast<std::uint16_t>(message.length() + 1),
+                                 .unit = 1 };
+        std::ranges::copy(header.to_bytes(), requests.begin() + static_cast<std::ptrdiff_t>(size));
+        size += modbus::tcp_mbap::size;
+        size += message.serialize(std::span(requests).subspan(size));
+        registry.request(std::to_underlying(std::decay_t<decltype(message)>::function));
+      };
+      if (is_write(setup.mix, transaction)) {
+        encode(write);
+      } else {
+        encode(read);
+      }
+    }
+    auto sent = std::chrono::steady_clock::now();
+    auto [write_error, written] =
+        co_await asio::async_write(socket, asio::buffer(requests.data(), size), asio::as_tuple(asio::use_awaitable));
+    if (write_error) {
+      ++errors;
+      co_return;
+    }
+    for (std::size_t response = 0; response < setup.depth; ++response) {
+      auto [header_error, header_size] =
+          co_await asio::async_read(socket, asio::buffer(header_buffer), asio::as_tuple(asio::use_awaitable));
+      auto header = modbus::tcp_mbap::from_bytes(header_buffer);
+      if (header_error || header.length < 2 || header.length - 1U > body.size()) {
+        ++errors;
+        co_return;
+      }
+      auto [body_error, body_size] = co_await asio::async_read(socket, asio::buffer(body, header.length - 1U),
+                                                               asio::as_tuple(asio::use_awaitable));
+      if (body_error) {
+        ++errors;
+        co_return;
+      }
+      registry.round_trip(std::chrono::steady_clock::now() - sent);
+      errors += (body[0] & 0x80U) != 0 ? 1 : 0;
+    }
+  }
+}
+
+auto run(scenario setup, std::chrono::milliseconds duration, std::uint16_t target) -> outcome {
+  asio::io_context ctx;
+  auto registry = std::make_shared<modbus::metrics>(1);
+  std::vector<std::unique_ptr<modbus::client>> clients;
+  std::vector<std::unique_ptr<asio::ip::tcp::socket>> sockets;
+  std::uint64_t errors{};
+
+  // Connect one at a time, so the listen backlog of the server is never exceeded.
+  co_spawn(
+      ctx,
+      [&]() -> asio::awaitable<void> {
+        asio::ip::tcp::endpoint server{ asio::ip::make_address("127.0.0.1"), target };
+        for (std::size_t index = 0; index < setup.connections; ++index) {
+          if (setup.depth == 1) {
+            auto& client = clients.emplace_back(std::make_unique<modbus::client>(ctx));
+            client->set_metrics(registry);
+            auto [error] =
+                co_await client->connect("127.0.0.1", std::to_string(target), asio::as_tuple(asio::use_awaitable));
+            errors += error ? 1 : 0;
+          } else {
+            auto& socket = sockets.emplace_back(std::make_unique<asio::ip::tcp::socket>(ctx));
+            auto [error] = co_await socket->async_connect(server, asio::as_tuple(asio::use_awaitable));
+            errors += error ? 1 : 0;
+            socket->set_option(asio::ip::tcp::no_delay{ true });
+          }
+        }
+      },
+      asio::detached);
+  ctx.run();
+  ctx.restart();
+
+  auto cpu_start = cpu_time();
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + duration;
+  for (auto& client : clients) {
+    co_spawn(ctx, drive_client(*client, setup, deadline, errors), asio::detached);
+  }
+  for (auto& socket : sockets) {
+    co_spawn(ctx, drive_pipeline(*socket, setup, deadline, *registry, errors), asio::detached);
+  }
+  ctx.run();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  auto cpu = cpu_time() - cpu_start;
+  auto resident = resident_bytes();
+
+  for (auto& client : clients) {
+    client->close();
+  }
+  for (auto& socket : sockets) {
+    asio::error_code ignored;
+    socket->close(ignored);
+  }
+
+  auto snapshot = registry->snapshot();
+  auto requests = snapshot.round_trip.count();
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  return { setup,
+           static_cast<double>(requests) / seconds,
+           snapshot.round_trip.percentile(0.5),
+           snapshot.round_trip.percentile(0.99),
+           snapshot.round_trip.percentile(0.999),
+           requests == 0 ? 0.0 : static_cast<double>(cpu.count()) / static_cast<double>(requests),
+           resident,
+           errors };
+}
+
+void print(outcome const& result) {
+  auto microseconds = [](std::chrono::nanoseconds value) { return static_cast<double>(value.count()) / 1000.0; };
+  std::cout << std::right << std::setw(11) << result.setup.connections << std::setw(7) << result.setup.depth
+            << std::setw(7) << mix_names[static_cast<std::size_t>(result.setup.mix)] << std::setw(10)
+            << result.setup.registers << std::fixed << std::setprecision(0) << std::setw(13)
+            << result.requests_per_second << std::setprecision(1) << std::setw(11) << microseconds(result.p50)
+            << std::setw(11) << microseconds(result.p99) << std::setw(11) << microseconds(result.p999) << std::setw(12)
+            << result.cpu_ns_per_request << std::setw(10) << result.resident_bytes / (1024 * 1024) << std::setw(8)
+            << result.errors << '\n';
+}
+
+void print_json(std::span<outcome const> results) {
+  std::cout << "{\"benchmarks\": [";
+  for (std::size_t index = 0; index < results.size(); ++index) {
+    auto const& result = results[index];
+    std::cout << (index == 0 ? "\n" : ",\n") << "  {\"connections\": " << result.setup.connections
+              << ", \"depth\": " << result.setup.depth << ", \"mix\": \""
+              << mix_names[static_cast<std::size_t>(result.setup.mix)] << "\", \"registers\": " << result.setup.registers
+              << std::fixed << std::setprecision(1) << ", \"requests_per_second\": " << result.requests_per_second
+              << ", \"p50_ns\": " << result.p50.count() << ", \"p99_ns\": " << result.p99.count()
+              << ", \"p999_ns\": " << result.p999.count() << ", \"cpu_ns_per_request\": " << result.cpu_ns_per_request
+              << ", \"resident_bytes\": " << result.resident_bytes << ", \"errors\": " << result.errors << '}';
+  }
+  std::cout << "\n]}\n";
+}
+
+/// Wait for the server to close the connections of the last scenario.
+template <typename server_t>
+void wait_closed(server_t& server, asio::io_context& server_ctx) {
+  for (int attempt = 0; attempt < 500; ++attempt) {
+    std::promise<std::size_t> open;
+    asio::post(server_ctx, [&server, &open]() { open.set_value(server.connections()); });
+    if (open.get_future().get() == 0) {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+  }
+}
+
+auto parse_list(std::string_view text) -> std::vector<std::size_t> {
+  std::vector<std::size_t> values;
+  while (!text.empty()) {
+    auto comma = text.find(',');
+    values.push_back(std::strtoul(std::string{ text.substr(0, comma) }.c_str(), nullptr, 10));
+    text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+  }
+  return values;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::size_t> connections{ 1, 10, 100, 1000, 10000 };
+  std::vector<std::size_t> depths{ 1, 8 };
+  std::vector<mix_e> mixes{ mix_e::read, mix_e::mixed };
+  std::vector<std::size_t> registers{ 16 };
+  std::chrono::milliseconds duration{ 1000 };
+  modbus::delay_distribution delay{};
+  bool json = false;
+  for (int index = 1; index < argc; ++index) {
+    std::string_view option{ argv[index] };
+    std::string_view value{ index + 1 < argc ? argv[index + 1] : "" };
+    if (option == "--json") {
+      json = true;
+      continue;
+    }
+    ++index;
+    if (option == "--connections") {
+      connections = parse_list(value);
+    } else if (option == "--depth") {
+      depths = parse_list(value);
+    } else if (option == "--registers") {
+      registers = parse_list(value);
+    } else if (option == "--duration") {
+      duration = std::chrono::milliseconds{ std::strtol(std::string{ value }.c_str(), nullptr, 10) };
+    } else if (option == "--delay") {
+      delay.base = std::chrono::microseconds{ std::strtol(std::string{ value }.c_str(), nullptr, 10) };
+    } else if (option == "--jitter") {
+      delay.jitter = std::chrono::microseconds{ std::strtol(std::string{ value }.c_str(), nullptr, 10) };
+    } else if (option == "--mix") {
+      mixes.clear();
+      for (std::size_t mix = 0; mix < mix_names.size(); ++mix) {
+        if (value.find(mix_names[mix]) != std::string_view::npos) {
+          mixes.push_back(static_cast<mix_e>(mix));
+        }
+      }
+    } else {
+      std::cerr << "unknown option " << option << '\n';
+      return 1;
+    }
+  }
+
+  // Both ends of every connection live in this process.
+  rlimit files{};
+  getrlimit(RLIMIT_NOFILE, &files);
+  files.rlim_cur = files.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &files);
+
+  // Every connection closed at the end of a scenario would be logged.
+  modbus::default_logger().set_level(modbus::log_level::warning);
+
+  asio::io_context server_ctx;
+  auto handler = std::make_shared<modbus::default_handler>();
+  modbus::server server{ server_ctx, handler, port };
+  server.start();
+  std::unique_ptr<modbus::fault_proxy> proxy;
+  auto target = port;
+  if (delay.base.count() > 0 || delay.jitter.count() > 0) {
+    modbus::fault_proxy_options options{};
+    options.to_server.delay = delay;
+    options.to_client.delay = delay;
+    proxy = std::make_unique<modbus::fault_proxy>(
+        server_ctx, asio::ip::tcp::endpoint{ asio::ip::address_v4::loopback(), port }, options);
+    proxy->start();
+    target = proxy->local_endpoint().port();
+  }
+  auto work = asio::make_work_guard(server_ctx);
+  std::thread server_thread{ [&server_ctx]() { server_ctx.run(); } };
+
+  if (!json) {
+    std::cout << "connections  depth    mix registers  requests/s    p50 us     p99 us   p99.9 us  cpu ns/req   rss MiB"
+                 "  errors\n";
+  }
+  std::vector<outcome> results;
+  // Two descriptors per connection, four through the proxy, and a few to spare.
+  auto max_connections = (static_cast<std::size_t>(files.rlim_cur) - 64) / (proxy ? 4 : 2);
+  for (auto count : connections) {
+    if (count > max_connections) {
+      std::cerr << "skipping " << count << " connections, the file descriptor limit allows " << max_connections << '\n';
+      continue;
+    }
+    for (auto depth : depths) {
+      for (auto mix : mixes) {
+        for (auto size : registers) {
+          results.push_back(run({ count, std::max<std::size_t>(depth, 1), mix, std::clamp<std::size_t>(size, 1, 125) },
+                                duration, target));
+          if (!json) {
+            print(results.back());
+          }
+          wait_closed(server, server_ctx);
+        }
+      }
+    }
+  }
+  if (json) {
+    print_json(results);
+  }
+
+  if (proxy) {
+    asio::post(server_ctx, [&proxy]() { proxy->stop(); });
+  }
+  work.reset();
+  server_ctx.stop();
+  server_thread.join();
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// Cost of encoding and decoding every request and response type, for payloads from a single value to the
+// largest a PDU holds, and of decoding through the deserialize_request and deserialize_response dispatch.
+//
+// usage: serialization_benchmark [iterations] [--json]
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <modbus/client.hpp>
+
+#include "bench.hpp"
+
+namespace {
+
+/// Payload sizes, from a single value to as many as a read response holds.
+constexpr std::array<std::size_t, 3> coil_counts{ 1, 256, 2000 };
+constexpr std::array<std::size_t, 3> register_counts{ 1, 16, 125 };
+
+class suite {
+public:
+  explicit suite(std::size_t iterations) : iterations_{ iterations } {}
+
+  /// Measure serialize, deserialize and the deserialize_request or deserialize_response dispatch of message.
+  template <typename message_t>
+  void run(std::string_view kind, std::string_view type, std::string_view payload, message_t const& message) {
+    std::string name{ kind };
+    name.append(" ").append(type);
+    if (!payload.empty()) {
+      name.append(" ").append(payload);
+    }
+    std::size_t bytes{};
+
+    results_.push_back(modbus::bench::measure(name + " serialize", iterations_, [&]() {
+      bytes += message.serialize().size();
+    }));
+    if constexpr (requires(std::span<uint8_t> buffer) { message.serialize(buffer); }) {
+      std::array<uint8_t, 260> buffer{};
+      results_.push_back(modbus::bench::measure(name + " serialize into buffer", iterations_, [&]() {
+        bytes += message.serialize(std::span(buffer));
+        modbus::bench::do_not_optimize(buffer);
+      }));
+    }
+
+    auto encoded = message.serialize();
+    std::span<uint8_t const> pdu{ encoded };
+    std::size_t failures{};
+    results_.push_back(modbus::bench::measure(name + " deserialize", iterations_, [&]() {
+      message_t decoded{};
+      modbus::bench::do_not_optimize(pdu);
+      failures += decoded.deserialize(pdu) ? 1 : 0;
+      modbus::bench::do_not_optimize(decoded);
+    }));
+    results_.push_back(modbus::bench::measure(name + " dispatch", iterations_, [&]() {
+      if constexpr (requires { typename message_t::response; }) {
+        failures += modbus::impl::deserialize_request(pdu, message_t::function).has_value() ? 0 : 1;
+      } else {
+        failures += modbus::impl::deserialize_response(pdu, message_t::function).has_value() ? 0 : 1;
+      }
+    }));
+
+    if (bytes == 0 || failures != 0) {
+      std::cerr << name << " failed to round trip\n";
+    }
+  }
+
+  void print(bool json) const {
+    if (json) {
+      modbus::bench::print_json(results_);
+      return;
+    }
+    for (auto const& res : results_) {
+      modbus::bench::print(res);
+    }
+  }
+
+private:
+  std::size_t iterations_;
+  std::vector<modbus::bench::result> results_;
+};
+
+auto payload_name(std::size_t count, std::string_view unit) -> std::string {
+  return std::to_string(count) + " " + std::string{ unit };
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t iterations = 1000000;
+  bool json = false;
+  for (int index = 1; index < argc; ++index) {
+    std::string_view argument{ argv[index] };
+    if (argument == "--json") {
+      json = true;
+    } else {
+      iterations = std::strtoul(argv[index], nullptr, 10);
+    }
+  }
+  suite benchmarks{ iterations };
+  namespace request = modbus::request;
+  namespace response = modbus::response;
+
+  benchmarks.run("request", "read_coils", "", request::read_coils{ 0, 2000 });
+  benchmarks.run("request", "read_discrete_inputs", "", request::read_discrete_inputs{ 0, 2000 });
+  benchmarks.run("request", "read_holding_registers", "", request::read_holding_registers{ 0, 125 });
+  benchmarks.run("request", "read_input_registers", "", request::read_input_registers{ 0, 125 });
+  benchmarks.run("request", "write_single_coil", "", request::write_single_coil{ 0, true });
+  benchmarks.run("request", "write_single_register", "", request::write_single_register{ 0, 42 });
+  benchmarks.run("request", "mask_write_register", "", request::mask_write_register{ 0, 0xff00, 0x00ff });
+  for (auto count : coil_counts) {
+    // A write request holds at most 1968 coils.
+    count = std::min<std::size_t>(count, 1968);
+    benchmarks.run("request", "write_multiple_coils", payload_name(count, "coils"),
+                   request::write_multiple_coils{ 0, std::vector<bool>(count, true) });
+  }
+  for (auto count : register_counts) {
+    // Write requests hold at most 123 registers, read_write_multiple_registers 121.
+    benchmarks.run("request", "write_multiple_registers", payload_name(std::min<std::size_t>(count, 123), "registers"),
+                   request::write_multiple_registers{ 0, std::vector<uint16_t>(std::min<std::size_t>(count, 123), 42) });
+    benchmarks.run("request", "read_write_multiple_registers",
+                   payload_name(std::min<std::size_t>(count, 121), "registers"),
+                   request::read_write_multiple_registers{
+                       0, 125, 0, std::vector<uint16_t>(std::min<std::size_t>(count, 121), 42) });
+  }
+
+  for (auto count : coil_counts) {
+    benchmarks.run("response", "read_coils", payload_name(count, "coils"),
+                   response::read_coils{ std::vector<bool>(count, true) });
+    benchmarks.run("response", "read_discrete_inputs", payload_name(count, "coils"),
+                   response::read_discrete_inputs{ std::vector<bool>(count, true) });
+  }
+  for (auto count : register_counts) {
+    benchmarks.run("response", "read_holding_registers", payload_name(count, "registers"),
+                   response::read_holding_registers{ std::vector<uint16_t>(count, 42) });
+    benchmarks.run("response", "read_input_registers", payload_name(count, "registers"),
+                   response::read_input_registers{ std::vector<uint16_t>(count, 42) });
+    benchmarks.run("response", "read_write_multiple_registers", payload_name(count, "registers"),
+                   response::read_write_multiple_registers{ std::vector<uint16_t>(count, 42) });
+  }
+  benchmarks.run("response", "write_single_coil", "", response::write_single_coil{ 0, true });
+  benchmarks.run("response", "write_single_register", "", response::write_single_register{ 0, 42 });
+  benchmarks.run("response", "write_multiple_coils", "", response::write_multiple_coils{ 0, 1968 });
+  benchmarks.run("response", "write_multiple_registers", "", response::write_multiple_registers{ 0, 123 });
+  benchmarks.run("response", "mask_write_register", "", response::mask_write_register{ 0, 0xff00, 0x00ff });
+
+  benchmarks.print(json);
+}
@@ -1,7 +1,10 @@
 // Copyright (c) 2023, Skaginn3x (https://skaginn3x.com)
 
+#include <csignal>
 #include <iostream>
 
+#include <asio/signal_set.hpp>
+
 #include <modbus/default_handler.hpp>
 #include <modbus/server.hpp>
 
@@ -81,6 +84,12 @@ int main(int argc, char* argv[]) {
   modbus::server<modbus::default_handler> server{ ctx, handler, port };
   server.start();
 
+  // Answer in-flight requests before exiting on Ctrl+C
+  asio::signal_set signals{ ctx, SIGINT, SIGTERM };
+  signals.async_wait([&server](std::error_code const&, int) {
+    server.drain([]() { std::cout << "All connections closed, stopping." << std::endl; });
+  });
+
   std::cout << "Starting example server!" << std::endl;
   ctx.run();
 }
\ No newline at end of file
@@ -0,0 +1,138 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace modbus {
+
+/// Calls to the global operator new and operator delete.
+struct allocation_counts {
+  std::uint64_t allocations{};
+  std::uint64_t deallocations{};
+  /// Bytes requested by the allocations.
+  std::uint64_t bytes{};
+
+  friend auto operator-(allocation_counts const& lhs, allocation_counts const& rhs) -> allocation_counts {
+    return { lhs.allocations - rhs.allocations, lhs.deallocations - rhs.deallocations, lhs.bytes - rhs.bytes };
+  }
+};
+
+/// Called on every counted allocation with its size, e.g. to capture a stack trace or break in a debugger.
+using allocation_hook = void (*)(std::size_t size);
+
+namespace impl {
+struct allocation_counters {
+  std::atomic<std::uint64_t> allocations{};
+  std::atomic<std::uint64_t> deallocations{};
+  std::atomic<std::uint64_t> bytes{};
+  std::atomic<allocation_hook> hook{};
+};
+
+inline auto global_allocation_counters() -> allocation_counters& {
+  static allocation_counters counters;
+  return counters;
+}
+
+inline auto thread_allocation_counts() -> allocation_counts& {
+  thread_local allocation_counts counts;
+  return counts;
+}
+
+inline void count_allocation(std::size_t size) {
+  auto& local = thread_allocation_counts();
+  ++local.allocations;
+  local.bytes += size;
+  auto& counters = global_allocation_counters();
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  counters.bytes.fetch_add(size, std::memory_order_relaxed);
+  if (auto* hook = counters.hook.load(std::memory_order_relaxed); hook != nullptr) {
+    // Allocations made by the hook itself are counted but not reported again.
+    thread_local bool in_hook = false;
+    if (!in_hook) {
+      in_hook = true;
+      hook(size);
+      in_hook = false;
+    }
+  }
+}
+
+inline void count_deallocation() {
+  ++thread_allocation_counts().deallocations;
+  global_allocation_counters().deallocations.fetch_add(1, std::memory_order_relaxed);
+}
+}  // namespace impl
+
+/// Allocations of all threads so far.
+/**
+ * Only counted in programs where exactly one translation unit defines MODBUS_DEFINE_ALLOCATION_COUNTER
+ * before including this header, which replaces the global operator new and operator delete with
+ * counting versions. Everywhere else the counts stay zero.
+ *
+ * Take the difference of two counts around steady state transactions to check that a hot path does
+ * not allocate, and install a hook with set_allocation_hook to find out where the allocations come from.
+ */
+inline auto allocation_count() -> allocation_counts {
+  auto const& counters = impl::global_allocation_counters();
+  return { counters.allocations.load(std::memory_order_relaxed), counters.deallocations.load(std::memory_order_relaxed),
+           counters.bytes.load(std::memory_order_relaxed) };
+}
+
+/// Allocations of the calling thread so far, to tell the client from a server running on another thread.
+inline auto thread_allocation_count() -> allocation_counts {
+  return impl::thread_allocation_counts();
+}
+
+/// Install hook to be called on every allocation, nullptr removes it.
+inline void set_allocation_hook(allocation_hook hook) {
+  impl::global_allocation_counters().hook.store(hook, std::memory_order_relaxed);
+}
+
+}  // namespace modbus
+
+#ifdef MODBUS_DEFINE_ALLOCATION_COUNTER
+
+// The array and nothrow forms of the standard library call these.
+auto operator new(std::size_t size) -> void* {
+  modbus::impl::count_allocation(size);
+  if (auto* pointer = std::malloc(size == 0 ? 1 : size); pointer != nullptr) {
+    return pointer;
+  }
+  throw std::bad_alloc{};
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void* {
+  modbus::impl::count_allocation(size);
+  auto align = static_cast<std::size_t>(alignment);
+  size = size == 0 ? 1 : size;
+  // aligned_alloc requires a size that is a multiple of the alignment.
+  if (auto* pointer = std::aligned_alloc(align, (size + align - 1) / align * align); pointer != nullptr) {
+    return pointer;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer != nullptr) {
+    modbus::impl::count_deallocation();
+  }
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  ::operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  ::operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+  ::operator delete(pointer);
+}
+
+#endif
@@ -0,0 +1,208 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace modbus {
+
+/// Groups of consecutive registers that are always written and read as one unit.
+/**
+ * Values spanning several registers, 32 bit floats or 64 bit counters, tear when a client reads
+ * them while another thread is half way through updating them. Declaring the registers of such a
+ * value as a group makes every update of the group atomic.
+ *
+ * Readers take a snapshot of a group without locking: each group carries a sequence number which
+ * is odd while the group is being written, a reader retries until it copied the values under the
+ * same even sequence number. Writers are serialized by a mutex, hold it across several accesses
+ * to make a read modify write atomic with respect to other writers.
+ *
+ * Groups must be declared before the registers are accessed concurrently.
+ */
+class atomic_groups {
+public:
+  static constexpr std::size_t max_group_size = 4;
+
+  /// Declare the count registers starting at address as a group.
+  /**
+   * \return false if count is not between 2 and max_group_size, the group does not fit the
+   *         address space or overlaps a group declared before.
+   */
+  auto declare(std::uint16_t address, std::size_t count) -> bool {
+    if (count < 2 || count > max_group_size || address + count > 0x10000) {
+      return false;
+    }
+    auto next = std::ranges::upper_bound(groups_, address, {}, group_address);
+    if ((next != groups_.end() && (*next)->address < address + count) ||
+        (next != groups_.begin() && (*std::prev(next))->end() > address)) {
+      return false;
+    }
+    auto added = std::make_unique<group>();
+    added->address = address;
+    added->count = count;
+    groups_.insert(next, std::move(added));
+    return true;
+  }
+
+  /// Number of declared groups.
+  [[nodiscard]] auto size() const -> std::size_t { return groups_.size(); }
+
+  /// Take the writer lock, pass it to write.
+  [[nodiscard]] auto lock() -> std::unique_lock<std::mutex> { return std::unique_lock{ mutex_ }; }
+
+  /// Update the registers of every group overlapping [address, address + values.size()).
+  /**
+   * Registers of a group outside of the range keep their value, the whole group still changes at once.
+   * \param held The lock returned by lock().
+   */
+  void write(std::uint16_t address, std::span<std::uint16_t const> values, std::unique_lock<std::mutex> const& held) {
+    (void)held;
+    for_each_group(address, values.size(), [&](group& target) {
+      auto snapshot = snapshot_of(target);
+      for (std::size_t i = 0; i < target.count; ++i) {
+        auto position = target.address + i;
+        if (position >= address && position < address + values.size()) {
+          snapshot[i] = values[position - address];
+        }
+      }
+      publish(target, snapshot);
+    });
+  }
+
+  /// Call function(address, value) with a consistent snapshot of every group register in [address, address + count).
+  template <typename function_t>
+  void read(std::uint16_t address, std::size_t count, function_t&& function) const {
+    for_each_group(address, count, [&](group const& source) {
+      auto snapshot = snapshot_of(source);
+      for (std::size_t i = 0; i < source.count; ++i) {
+        auto position = source.address + i;
+        if (position >= address && position < address + count) {
+          function(static_cast<std::uint16_t>(position), snapshot[i]);
+        }
+      }
+    });
+  }
+
+  /// Get the value stored in the group starting at address, most significant register first.
+  /**
+   * The group must have been declared with sizeof(value_t) / 2 registers.
+   */
+  template <typename value_t>
+    requires std::is_trivially_copyable_v<value_t> && (sizeof(value_t) % 2 == 0) && (sizeof(value_t) <= 8)
+  [[nodiscard]] auto load(std::uint16_t address) const -> value_t {
+    std::array<std::uint16_t, sizeof(value_t) / 2> words{};
+    read(address, words.size(), [&](std::uint16_t position, std::uint16_t value) { words[position - address] = value; });
+    return from_words<value_t>(words);
+  }
+
+  /// Store value in the group starting at address, most significant register first.
+  /**
+   * The group must have been declared with sizeof(value_t) / 2 registers.
+   */
+  template <typename value_t>
+    requires std::is_trivially_copyable_v<value_t> && (sizeof(value_t) % 2 == 0) && (sizeof(value_t) <= 8)
+  void store(std::uint16_t address, value_t value) {
+    auto words = to_words(value);
+    write(address, words, lock());
+    version_.fetch_add(1, std::memory_order_release);
+  }
+
+  /// Number of completed store calls, changes when the application updated a group.
+  [[nodiscard]] auto version() const -> std::uint64_t { return version_.load(std::memory_order_acquire); }
+
+private:
+  struct group {
+    std::uint16_t address{};
+    std::size_t count{};
+    std::atomic<std::uint32_t> sequence{};
+    std::array<std::atomic<std::uint16_t>, max_group_size> values{};
+
+    [[nodiscard]] auto end() const -> std::size_t { return address + count; }
+  };
+
+  using snapshot_type = std::array<std::uint16_t, max_group_size>;
+
+  static auto group_address(std::unique_ptr<group> const& entry) -> std::uint16_t { return entry->address; }
+
+  static auto snapshot_of(group const& source) -> snapshot_type {
+    snapshot_type snapshot{};
+    while (true) {
+      auto before = source.sequence.load(std::memory_order_acquire);
+      if ((before & 1U) == 0) {
+        for (std::size_t i = 0; i < source.count; ++i) {
+          snapshot[i] = source.values[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (source.sequence.load(std::memory_order_relaxed) == before) {
+          return snapshot;
+        }
+      }
+    }
+  }
+
+  static void publish(group& target, snapshot_type const& snapshot) {
+    auto sequence = target.sequence.load(std::memory_order_relaxed);
+    target.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < target.count; ++i) {
+      target.values[i].store(snapshot[i], std::memory_order_relaxed);
+    }
+    target.sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  /// Call function for each group overlapping [address, address + count).
+  template <typename function_t>
+  void for_each_group(std::uint16_t address, std::size_t count, function_t&& function) const {
+    auto current = std::ranges::upper_bound(groups_, address, {}, group_address);
+    if (current != groups_.begin() && (*std::prev(current))->end() > address) {
+      --current;
+    }
+    for (; current != groups_.end() && (*current)->address < address + count; ++current) {
+      function(**current);
+    }
+  }
+
+  template <typename value_t, std::size_t words>
+  static auto from_words(std::array<std::uint16_t, words> const& values) -> value_t {
+    std::array<std::uint8_t, 2 * words> bytes{};
+    for (std::size_t i = 0; i < words; ++i) {
+      bytes[2 * i] = static_cast<std::uint8_t>(values[i] >> 8U);
+      bytes[2 * i + 1] = static_cast<std::uint8_t>(values[i] & 0xffU);
+    }
+    if constexpr (std::endian::native == std::endian::little) {
+      std::ranges::reverse(bytes);
+    }
+    return std::bit_cast<value_t>(bytes);
+  }
+
+  template <typename value_t>
+  static auto to_words(value_t value) -> std::array<std::uint16_t, sizeof(value_t) / 2> {
+    auto bytes = std::bit_cast<std::array<std::uint8_t, sizeof(value_t)>>(value);
+    if constexpr (std::endian::native == std::endian::little) {
+      std::ranges::reverse(bytes);
+    }
+    std::array<std::uint16_t, sizeof(value_t) / 2> values{};
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      values[i] = static_cast<std::uint16_t>((bytes[2 * i] << 8U) | bytes[2 * i + 1]);
+    }
+    return values;
+  }
+
+  std::vector<std::unique_ptr<group>> groups_;
+  std::mutex mutex_;
+  std::atomic<std::uint64_t> version_{};
+};
+
+}  // namespace modbus
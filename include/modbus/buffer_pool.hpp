@@ -0,0 +1,122 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <modbus/constants.hpp>
+#include <modbus/tcp.hpp>
+
+namespace modbus {
+
+/// Pool of fixed size frame buffers carved out of larger slabs.
+/**
+ * Each buffer fits a complete Modbus TCP frame. Connections borrow a buffer only while a request
+ * is being processed, so the memory held by idle connections does not grow with the frame size.
+ * Slabs are allocated on demand and kept for the lifetime of the pool.
+ *
+ * Not thread safe, all calls must be made from the executor of the server.
+ */
+class buffer_pool {
+public:
+  static constexpr std::size_t buffer_size = tcp_mbap::size + modbus_max_pdu;
+
+  /// A borrowed buffer, returned to its pool on destruction.
+  class buffer {
+  public:
+    buffer() = default;
+    buffer(buffer const&) = delete;
+    auto operator=(buffer const&) -> buffer& = delete;
+    buffer(buffer&& other) noexcept
+        : pool_{ std::exchange(other.pool_, nullptr) }, data_{ std::exchange(other.data_, nullptr) } {}
+    auto operator=(buffer&& other) noexcept -> buffer& {
+      if (this != &other) {
+        release();
+        pool_ = std::exchange(other.pool_, nullptr);
+        data_ = std::exchange(other.data_, nullptr);
+      }
+      return *this;
+    }
+    ~buffer() { release(); }
+
+    /// The memory of the buffer, empty if nothing is borrowed.
+    [[nodiscard]] auto data() const -> std::span<std::uint8_t> {
+      return { data_, data_ != nullptr ? buffer_size : 0 };
+    }
+
+    /// Return the memory to the pool early.
+    void release() {
+      if (pool_ != nullptr) {
+        pool_->release(data_);
+        pool_ = nullptr;
+        data_ = nullptr;
+      }
+    }
+
+    [[nodiscard]] explicit operator bool() const { return data_ != nullptr; }
+
+  private:
+    friend class buffer_pool;
+    buffer(buffer_pool* pool, std::uint8_t* data) : pool_{ pool }, data_{ data } {}
+
+    buffer_pool* pool_{ nullptr };
+    std::uint8_t* data_{ nullptr };
+  };
+
+  /// \param buffers_per_slab Number of buffers allocated at once when the pool runs dry.
+  explicit buffer_pool(std::size_t buffers_per_slab = 64) : buffers_per_slab_{ buffers_per_slab } {}
+
+  buffer_pool(buffer_pool const&) = delete;
+  auto operator=(buffer_pool const&) -> buffer_pool& = delete;
+
+  /// Borrow a buffer.
+  [[nodiscard]] auto acquire() -> buffer {
+    if (free_ == nullptr) {
+      grow();
+    }
+    auto* block = free_;
+    free_ = free_->next;
+    --available_;
+    return { this, reinterpret_cast<std::uint8_t*>(block) };
+  }
+
+  /// Number of buffers ready to be borrowed.
+  [[nodiscard]] auto available() const -> std::size_t { return available_; }
+
+  /// Number of buffers allocated by the pool, borrowed or not.
+  [[nodiscard]] auto capacity() const -> std::size_t { return slabs_.size() * buffers_per_slab_; }
+
+private:
+  union block {
+    block* next;
+    std::uint8_t data[buffer_size];
+  };
+
+  void grow() {
+    auto& slab = slabs_.emplace_back(std::make_unique_for_overwrite<block[]>(buffers_per_slab_));
+    for (std::size_t i = 0; i < buffers_per_slab_; ++i) {
+      slab[i].next = free_;
+      free_ = &slab[i];
+    }
+    available_ += buffers_per_slab_;
+  }
+
+  void release(std::uint8_t* data) {
+    auto* released = reinterpret_cast<block*>(data);
+    released->next = free_;
+    free_ = released;
+    ++available_;
+  }
+
+  std::size_t buffers_per_slab_;
+  std::vector<std::unique_ptr<block[]>> slabs_;
+  block* free_{ nullptr };
+  std::size_t available_{};
+};
+
+}  // namespace modbus
@@ -0,0 +1,286 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+namespace modbus {
+
+/// Which way a captured ADU travelled.
+enum struct capture_direction : std::uint8_t {
+  /// A request.
+  to_server,
+  /// A response.
+  to_client,
+};
+
+/// The TCP ports of a connection, the same on both ends so client and server captures line up.
+struct capture_ports {
+  std::uint16_t client{};
+  std::uint16_t server{};
+};
+
+/// An ADU read back from a capture file.
+struct captured_adu {
+  /// Nanoseconds since the epoch of std::chrono::system_clock.
+  std::int64_t timestamp{};
+  capture_ports ports{};
+  capture_direction direction{};
+  /// The MBAP header and the PDU.
+  std::vector<std::uint8_t> adu;
+};
+
+/// Append only log of ADUs in a memory mapped file, shared by any number of clients and server connections.
+/**
+ * The file starts with a 16 byte header, the magic "MBCAP\0\0\1" and the number of bytes of records
+ * after the header. Every record is a 16 byte header, the timestamp in nanoseconds since the unix
+ * epoch, the client port, the server port, the direction, a reserved byte and the size of the ADU,
+ * followed by the ADU, padded to a multiple of 8 bytes. Values are in host byte order.
+ *
+ * The file is mapped at its full capacity up front. Recording claims space with a compare and
+ * exchange and copies the record into the mapping, records arriving when the file is full are
+ * counted in dropped(). The file is truncated to the recorded records when the log is destroyed,
+ * readers of a log that was not closed stop at the first record that was never written.
+ */
+class capture_log {
+public:
+  static constexpr std::array<char, 8> magic{ 'M', 'B', 'C', 'A', 'P', '\0', '\0', '\1' };
+  static constexpr std::size_t file_header_size = 16;
+  static constexpr std::size_t record_header_size = 16;
+
+  /// Create or overwrite the capture file at path, throws std::system_error if it can not be mapped.
+  /**
+   * \param capacity Bytes of records the file holds.
+   */
+  explicit capture_log(std::filesystem::path const& path, std::size_t capacity = std::size_t{ 64 } << 20U)
+      : capacity_{ capacity } {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::system_category(), "open " + path.string());
+    }
+    if (::ftruncate(fd_, static_cast<off_t>(file_header_size + capacity_)) != 0) {
+      auto error = errno;
+      ::close(fd_);
+      throw std::system_error(error, std::system_category(), "resize " + path.string());
+    }
+    void* mapping = ::mmap(nullptr, file_header_size + capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+      auto error = errno;
+      ::close(fd_);
+      throw std::system_error(error, std::system_category(), "map " + path.string());
+    }
+    data_ = static_cast<std::uint8_t*>(mapping);
+    std::ranges::copy(magic, data_);
+  }
+
+  capture_log(capture_log const&) = delete;
+  auto operator=(capture_log const&) -> capture_log& = delete;
+
+  ~capture_log() {
+    auto used = static_cast<std::uint64_t>(head_.load(std::memory_order_acquire));
+    std::memcpy(data_ + magic.size(), &used, sizeof(used));
+    ::munmap(data_, file_header_size + capacity_);
+    std::ignore = ::ftruncate(fd_, static_cast<off_t>(file_header_size + used));
+    ::close(fd_);
+  }
+
+  /// Append an ADU given as its MBAP header and the PDU, or as a single span with an empty pdu.
+  void record(capture_direction direction,
+              capture_ports ports,
+              std::span<std::uint8_t const> header,
+              std::span<std::uint8_t const> pdu = {}) {
+    auto size = header.size() + pdu.size();
+    auto total = record_header_size + ((size + 7) & ~std::size_t{ 7 });
+    auto offset = head_.load(std::memory_order_relaxed);
+    do {
+      if (offset + total > capacity_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    } while (!head_.compare_exchange_weak(offset, offset + total, std::memory_order_relaxed));
+
+    auto* record = data_ + file_header_size + offset;
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    auto length = static_cast<std::uint16_t>(size);
+    std::memcpy(record, &timestamp, sizeof(timestamp));
+    std::memcpy(record + 8, &ports.client, sizeof(ports.client));
+    std::memcpy(record + 10, &ports.server, sizeof(ports.server));
+    record[12] = static_cast<std::uint8_t>(direction);
+    record[13] = 0;
+    std::memcpy(record + 14, &length, sizeof(length));
+    std::ranges::copy(header, record + record_header_size);
+    std::ranges::copy(pdu, record + record_header_size + header.size());
+  }
+
+  /// Records lost because the file was full.
+  [[nodiscard]] auto dropped() const -> std::size_t { return dropped_.load(std::memory_order_relaxed); }
+
+  /// Bytes of records written so far.
+  [[nodiscard]] auto size() const -> std::size_t { return head_.load(std::memory_order_relaxed); }
+
+private:
+  std::size_t capacity_;
+  int fd_{ -1 };
+  std::uint8_t* data_{ nullptr };
+  alignas(64) std::atomic<std::size_t> head_{};
+  std::atomic<std::size_t> dropped_{};
+};
+
+/// Read the records of a capture file written by capture_log.
+inline auto read_capture(std::filesystem::path const& path) -> std::expected<std::vector<captured_adu>, std::error_code> {
+  std::ifstream file{ path, std::ios::binary };
+  if (!file) {
+    return std::unexpected(std::make_error_code(std::errc::no_such_file_or_directory));
+  }
+  std::vector<std::uint8_t> data{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+  if (data.size() < capture_log::file_header_size || !std::equal(capture_log::magic.begin(), capture_log::magic.end(),
+                                                                 data.begin())) {
+    return std::unexpected(std::make_error_code(std::errc::illegal_byte_sequence));
+  }
+  std::uint64_t used{};
+  std::memcpy(&used, data.data() + capture_log::magic.size(), sizeof(used));
+  auto records = std::span(data).subspan(capture_log::file_header_size);
+  if (used != 0) {
+    records = records.first(std::min<std::size_t>(used, records.size()));
+  }
+
+  std::vector<captured_adu> result;
+  while (records.size() >= capture_log::record_header_size) {
+    captured_adu entry{};
+    std::uint16_t length{};
+    std::memcpy(&entry.timestamp, records.data(), sizeof(entry.timestamp));
+    std::memcpy(&entry.ports.client, records.data() + 8, sizeof(entry.ports.client));
+    std::memcpy(&entry.ports.server, records.data() + 10, sizeof(entry.ports.server));
+    entry.direction = static_cast<capture_direction>(records[12]);
+    std::memcpy(&length, records.data() + 14, sizeof(length));
+    auto total = capture_log::record_header_size + ((length + 7U) & ~7U);
+    // Space claimed by a writer that never finished, or the unused end of a log that was not closed.
+    if (entry.timestamp == 0 || length == 0 || total > records.size()) {
+      break;
+    }
+    auto adu = records.subspan(capture_log::record_header_size, length);
+    entry.adu.assign(adu.begin(), adu.end());
+    result.push_back(std::move(entry));
+    records = records.subspan(total);
+  }
+  std::ranges::stable_sort(result, {}, &captured_adu::timestamp);
+  return result;
+}
+
+namespace impl {
+template <typename value_t>
+void append_host(std::string& out, value_t value) {
+  std::array<char, sizeof(value_t)> bytes{};
+  std::memcpy(bytes.data(), &value, sizeof(value_t));
+  out.append(bytes.data(), bytes.size());
+}
+
+inline void append_network(std::string& out, std::uint32_t value, std::size_t size) {
+  for (auto index = size; index > 0; --index) {
+    out += static_cast<char>((value >> ((index - 1) * 8U)) & 0xffU);
+  }
+}
+}  // namespace impl
+
+/// Append adus as a pcapng capture that Wireshark opens.
+/**
+ * Every ADU becomes a TCP segment between 127.0.0.1 ports of its connection, with sequence numbers
+ * continuing over the ADUs of each direction. Wireshark decodes Modbus/TCP on port 502, use
+ * "Decode As" for servers listening on other ports.
+ */
+inline void write_pcapng(std::span<captured_adu const> adus, std::string& out) {
+  // Section header block.
+  impl::append_host(out, std::uint32_t{ 0x0a0d0d0a });
+  impl::append_host(out, std::uint32_t{ 28 });
+  impl::append_host(out, std::uint32_t{ 0x1a2b3c4d });
+  impl::append_host(out, std::uint16_t{ 1 });
+  impl::append_host(out, std::uint16_t{ 0 });
+  impl::append_host(out, std::int64_t{ -1 });
+  impl::append_host(out, std::uint32_t{ 28 });
+
+  // Interface description block of raw IPv4 packets with nanosecond timestamps.
+  impl::append_host(out, std::uint32_t{ 1 });
+  impl::append_host(out, std::uint32_t{ 32 });
+  impl::append_host(out, std::uint16_t{ 101 });
+  impl::append_host(out, std::uint16_t{ 0 });
+  impl::append_host(out, std::uint32_t{ 0 });
+  impl::append_host(out, std::uint16_t{ 9 });
+  impl::append_host(out, std::uint16_t{ 1 });
+  out.append(std::string_view{ "\x09\0\0\0", 4 });
+  impl::append_host(out, std::uint32_t{ 0 });
+  impl::append_host(out, std::uint32_t{ 32 });
+
+  // Next sequence number by connection and direction.
+  std::map<std::tuple<std::uint16_t, std::uint16_t, capture_direction>, std::uint32_t> sequence;
+  constexpr std::size_t ip_header_size = 20;
+  constexpr std::size_t tcp_header_size = 20;
+  for (auto const& entry : adus) {
+    auto from_client = entry.direction == capture_direction::to_server;
+    auto& seq = sequence.try_emplace({ entry.ports.client, entry.ports.server, entry.direction }, 1).first->second;
+    auto reverse = from_client ? capture_direction::to_client : capture_direction::to_server;
+    auto ack = sequence.try_emplace({ entry.ports.client, entry.ports.server, reverse }, 1).first->second;
+    auto packet_size = static_cast<std::uint32_t>(ip_header_size + tcp_header_size + entry.adu.size());
+    auto padded = (packet_size + 3U) & ~3U;
+
+    // Enhanced packet block.
+    impl::append_host(out, std::uint32_t{ 6 });
+    impl::append_host(out, static_cast<std::uint32_t>(32 + padded));
+    impl::append_host(out, std::uint32_t{ 0 });
+    auto timestamp = static_cast<std::uint64_t>(entry.timestamp);
+    impl::append_host(out, static_cast<std::uint32_t>(timestamp >> 32U));
+    impl::append_host(out, static_cast<std::uint32_t>(timestamp & 0xffffffffU));
+    impl::append_host(out, packet_size);
+    impl::append_host(out, packet_size);
+
+    // IPv4 header from and to 127.0.0.1, not fragmented, protocol TCP.
+    std::array<std::uint16_t, 10> ip{ 0x4500, static_cast<std::uint16_t>(packet_size), 0, 0x4000, 0x4006, 0,
+                                      0x7f00, 0x0001, 0x7f00, 0x0001 };
+    std::uint32_t sum{};
+    for (auto word : ip) {
+      sum += word;
+    }
+    sum = (sum & 0xffffU) + (sum >> 16U);
+    ip[5] = static_cast<std::uint16_t>(~(sum + (sum >> 16U)));
+    for (auto word : ip) {
+      impl::append_network(out, word, 2);
+    }
+
+    // TCP header with PSH and ACK set, the checksum is left zero.
+    impl::append_network(out, from_client ? entry.ports.client : entry.ports.server, 2);
+    impl::append_network(out, from_client ? entry.ports.server : entry.ports.client, 2);
+    impl::append_network(out, seq, 4);
+    impl::append_network(out, ack, 4);
+    impl::append_network(out, 0x5018, 2);
+    impl::append_network(out, 0xffff, 2);
+    impl::append_network(out, 0, 4);
+    seq += static_cast<std::uint32_t>(entry.adu.size());
+
+    out.append(reinterpret_cast<char const*>(entry.adu.data()), entry.adu.size());
+    out.append(padded - packet_size, '\0');
+    impl::append_host(out, static_cast<std::uint32_t>(32 + padded));
+  }
+}
+
+}  // namespace modbus
@@ -0,0 +1,211 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ranges>
+#include <span>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace modbus {
+
+/// The writable data tables.
+enum struct data_table : std::uint8_t {
+  coils,
+  holding_registers,
+};
+
+/// A write accepted by the server.
+struct write_event {
+  /// Coils or registers of the largest write request.
+  static constexpr std::size_t max_registers = 123;
+  static constexpr std::size_t max_coils = max_registers * 16;
+
+  std::uint8_t unit{};
+  data_table table{};
+  std::uint16_t address{};
+  std::uint16_t count{};
+  std::chrono::system_clock::time_point timestamp{};
+
+  /// The new values, registers or coils packed 16 to a word with the first coil in the lowest bit.
+  std::array<std::uint16_t, max_registers> values{};
+
+  /// The written registers, if table is holding_registers.
+  [[nodiscard]] auto registers() const -> std::span<std::uint16_t const> { return { values.data(), count }; }
+
+  /// The written coil at index, if table is coils.
+  [[nodiscard]] auto coil(std::size_t index) const -> bool { return ((values[index / 16] >> (index % 16)) & 1U) != 0; }
+};
+
+/// Bounded queue of the writes accepted by the server for the application to drain.
+/**
+ * Any number of threads may publish, a single thread consumes. Publishing never blocks or
+ * allocates, writes arriving while the queue is full are counted in dropped() and lost, the
+ * application should then fall back to reading the tables.
+ *
+ * On Linux the consumer can wait on an eventfd, which becomes readable when events are published.
+ * It costs a system call per published event and is off unless enable_eventfd is called.
+ */
+class change_feed {
+public:
+  /// \param capacity Number of events the queue holds, rounded up to a power of two.
+  explicit change_feed(std::size_t capacity = 1024)
+      : mask_{ std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1 },
+        slots_{ std::make_unique<slot[]>(mask_ + 1) } {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  change_feed(change_feed const&) = delete;
+  auto operator=(change_feed const&) -> change_feed& = delete;
+
+  ~change_feed() {
+#ifdef __linux__
+    if (event_fd_ >= 0) {
+      ::close(event_fd_);
+    }
+#endif
+  }
+
+  /// Signal published events through an eventfd, before anything is published.
+  /**
+   * \return the file descriptor, -1 if eventfd is not available.
+   */
+  auto enable_eventfd() -> int {
+#ifdef __linux__
+    if (event_fd_ < 0) {
+      event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+#endif
+    return event_fd_;
+  }
+
+  /// Record a register write.
+  auto publish(std::uint8_t unit, std::uint16_t address, std::span<std::uint16_t const> values) -> bool {
+    return push([&](write_event& event) {
+      event.unit = unit;
+      event.table = data_table::holding_registers;
+      event.address = address;
+      event.count = static_cast<std::uint16_t>(std::min(values.size(), write_event::max_registers));
+      std::ranges::copy(values.first(event.count), event.values.begin());
+    });
+  }
+
+  /// Record a coil write.
+  template <std::ranges::sized_range range_t>
+  auto publish_coils(std::uint8_t unit, std::uint16_t address, range_t const& values) -> bool {
+    return push([&](write_event& event) {
+      event.unit = unit;
+      event.table = data_table::coils;
+      event.address = address;
+      event.count = static_cast<std::uint16_t>(std::min<std::size_t>(std::ranges::size(values), write_event::max_coils));
+      event.values.fill(0);
+      std::size_t index = 0;
+      for (bool value : values) {
+        if (index == event.count) {
+          break;
+        }
+        event.values[index / 16] |= static_cast<std::uint16_t>(value ? 1U << (index % 16) : 0U);
+        ++index;
+      }
+    });
+  }
+
+  /// Take the oldest event, only from the consuming thread.
+  auto try_pop(write_event& event) -> bool {
+    auto& entry = slots_[tail_ & mask_];
+    if (entry.sequence.load(std::memory_order_acquire) != tail_ + 1) {
+      return false;
+    }
+    event = entry.event;
+    entry.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+    return true;
+  }
+
+  /// Call function for every queued event, only from the consuming thread.
+  /**
+   * \return the number of events.
+   */
+  template <typename function_t>
+  auto drain(function_t&& function) -> std::size_t {
+#ifdef __linux__
+    std::uint64_t signalled{};
+    if (event_fd_ >= 0) {
+      (void)::read(event_fd_, &signalled, sizeof(signalled));
+    }
+#endif
+    std::size_t count = 0;
+    write_event event;
+    while (try_pop(event)) {
+      function(event);
+      ++count;
+    }
+    return count;
+  }
+
+  /// Number of writes lost because the queue was full.
+  [[nodiscard]] auto dropped() const -> std::size_t { return dropped_.load(std::memory_order_relaxed); }
+
+  /// File descriptor that is readable while events are queued, -1 if the eventfd is not enabled.
+  [[nodiscard]] auto native_handle() const -> int { return event_fd_; }
+
+private:
+  struct slot {
+    std::atomic<std::size_t> sequence{};
+    write_event event{};
+  };
+
+  template <typename fill_t>
+  auto push(fill_t&& fill) -> bool {
+    auto position = head_.load(std::memory_order_relaxed);
+    while (true) {
+      auto& entry = slots_[position & mask_];
+      auto sequence = entry.sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          fill(entry.event);
+          entry.event.timestamp = std::chrono::system_clock::now();
+          entry.sequence.store(position + 1, std::memory_order_release);
+          signal();
+          return true;
+        }
+      } else if (static_cast<std::ptrdiff_t>(sequence - position) < 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        position = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void signal() const {
+#ifdef __linux__
+    if (event_fd_ >= 0) {
+      std::uint64_t one = 1;
+      (void)::write(event_fd_, &one, sizeof(one));
+    }
+#endif
+  }
+
+  std::size_t mask_;
+  std::unique_ptr<slot[]> slots_;
+  alignas(64) std::atomic<std::size_t> head_{};
+  alignas(64) std::size_t tail_{};
+  std::atomic<std::size_t> dropped_{};
+  int event_fd_{ -1 };
+};
+
+}  // namespace modbus
@@ -25,10 +25,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <bitset>
+#include <chrono>
 #include <cstdint>
 #include <expected>
 #include <functional>
+#include <memory>
+#include <span>
 #include <string>
 #include <unordered_map>
 
@@ -38,12 +43,17 @@
 #include <asio/strand.hpp>
 #include <asio/streambuf.hpp>
 
+#include <modbus/capture.hpp>
 #include <modbus/constants.hpp>
 #include <modbus/error.hpp>
 #include <modbus/functions.hpp>
+#include <modbus/metrics.hpp>
+#include <modbus/recycling_allocator.hpp>
 #include <modbus/request.hpp>
 #include <modbus/response.hpp>
+#include <modbus/response_view.hpp>
 #include <modbus/tcp.hpp>
+#include <modbus/tracing.hpp>
 
 #include <modbus/impl/deserialize.hpp>
 #include <modbus/impl/serialize.hpp>
@@ -56,7 +66,12 @@ using asio::async_compose;
 using tcp = ip::tcp;
 
 /// A connection to a Modbus server.
-class client {
+/**
+ * tracing_t timestamps the steps of every transaction, see tracing_policy. The default no_tracing
+ * compiles to nothing.
+ */
+template <tracing_policy tracing_t = no_tracing>
+class basic_client {
 protected:
   /// Execution context
   asio::io_context& ctx_;
@@ -70,13 +85,37 @@ protected:
   /// Track connected state of client.
   bool connected_{ false };
 
+  /// Set once the client has been connected, later connects are counted as reconnects.
+  bool was_connected_{ false };
+
+  /// Where transactions are counted, if anywhere.
+  std::shared_ptr<metrics> metrics_{};
+
+  /// Where requests and responses are recorded, if anywhere.
+  std::shared_ptr<capture_log> capture_{};
+
+  /// Ports of the current connection, identify it in captures.
+  capture_ports capture_ports_{};
+
+  [[no_unique_address]] tracing_t tracing_{};
+
+  /// Local port of the socket, identifies the connection in traces.
+  std::uint16_t trace_source_{};
+
   /// Socket options
   asio::ip::tcp::no_delay no_delay_option{ true };
   asio::socket_base::keep_alive keep_alive_option{ true };
 
 public:
   /// Construct a client.
-  explicit client(asio::io_context& io_context) : ctx_{ io_context }, socket_{ io_context } {}
+  explicit basic_client(asio::io_context& io_context, tracing_t tracing = {})
+      : ctx_{ io_context }, socket_{ io_context }, tracing_{ std::move(tracing) } {}
+
+  /// Count transactions, bytes, exceptions, reconnects and round trip times in registry.
+  void set_metrics(std::shared_ptr<metrics> registry) { metrics_ = std::move(registry); }
+
+  /// Record every request and response in log, set it before connecting.
+  void set_capture(std::shared_ptr<capture_log> log) { capture_ = std::move(log); }
 
   /// Get the IO executor used by the client.
   auto io_executor() -> tcp::socket::executor_type { return socket_.get_executor(); };
@@ -106,6 +145,18 @@ public:
                 }
 
                 connected_ = true;
+                if (metrics_ && was_connected_) {
+                  metrics_->add(metric::reconnects);
+                }
+                was_connected_ = true;
+                if constexpr (tracing_t::enabled) {
+                  asio::error_code ignored;
+                  trace_source_ = socket_.local_endpoint(ignored).port();
+                }
+                if (capture_) {
+                  asio::error_code ignored;
+                  capture_ports_ = { socket_.local_endpoint(ignored).port(), socket_.remote_endpoint(ignored).port() };
+                }
 
                 // Set socket options as recommended by the modbus spec.
                 socket_.set_option(no_delay_option);
@@ -126,9 +177,10 @@ public:
    */
   void close() {
     if (socket_.is_open()) {
-      // Shutdown and close socket.
-      socket_.shutdown(asio::socket_base::shutdown_type::shutdown_both);
-      socket_.close();
+      // Shutdown and close socket, the shutdown fails once the server has reset the connection.
+      asio::error_code ignored;
+      socket_.shutdown(asio::socket_base::shutdown_type::shutdown_both, ignored);
+      socket_.close(ignored);
     }
     connected_ = false;
   }
@@ -169,6 +221,98 @@ public:
                                           std::forward<decltype(token)>(token));
   }
 
+  /// Read a number of coils and complete with a view borrowed from the receive buffer.
+  /**
+   * The view is only valid until the completion handler returns or the next request is started.
+   */
+  template <typename completion_token>
+  auto read_coils_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, completion_token&& token) {
+    return send_bits_view<completion_token>(unit, request::read_coils{ address, count },
+                                            std::forward<decltype(token)>(token));
+  }
+
+  /// Read a number of discrete inputs and complete with a view borrowed from the receive buffer.
+  /**
+   * The view is only valid until the completion handler returns or the next request is started.
+   */
+  template <typename completion_token>
+  auto read_discrete_inputs_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, completion_token&& token) {
+    return send_bits_view<completion_token>(unit, request::read_discrete_inputs{ address, count },
+                                            std::forward<decltype(token)>(token));
+  }
+
+  /// Read a number of holding registers and complete with a view borrowed from the receive buffer.
+  /**
+   * The view is only valid until the completion handler returns or the next request is started.
+   */
+  template <typename completion_token>
+  auto read_holding_registers_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, completion_token&& token) {
+    return send_words_view<completion_token>(unit, request::read_holding_registers{ address, count },
+                                             std::forward<decltype(token)>(token));
+  }
+
+  /// Read a number of input registers and complete with a view borrowed from the receive buffer.
+  /**
+   * The view is only valid until the completion handler returns or the next request is started.
+   */
+  template <typename completion_token>
+  auto read_input_registers_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, completion_token&& token) {
+    return send_words_view<completion_token>(unit, request::read_input_registers{ address, count },
+                                             std::forward<decltype(token)>(token));
+  }
+
+  /// Read values.size() coils directly into values.
+  /**
+   * values must stay alive until the operation completes.
+   */
+  template <std::size_t bit_count, typename completion_token>
+  auto read_coils(std::uint8_t unit, std::uint16_t address, std::bitset<bit_count>& values, completion_token&& token) {
+    return read_bits_into<completion_token>(unit, request::read_coils{ address, static_cast<std::uint16_t>(bit_count) },
+                                            values, std::forward<decltype(token)>(token));
+  }
+
+  /// Read values.size() discrete inputs directly into values.
+  /**
+   * values must stay alive until the operation completes.
+   */
+  template <std::size_t bit_count, typename completion_token>
+  auto read_discrete_inputs(std::uint8_t unit,
+                            std::uint16_t address,
+                            std::bitset<bit_count>& values,
+                            completion_token&& token) {
+    return read_bits_into<completion_token>(
+        unit, request::read_discrete_inputs{ address, static_cast<std::uint16_t>(bit_count) }, values,
+        std::forward<decltype(token)>(token));
+  }
+
+  /// Read values.size() holding registers directly into values.
+  /**
+   * values must stay alive until the operation completes.
+   */
+  template <typename completion_token>
+  auto read_holding_registers(std::uint8_t unit,
+                              std::uint16_t address,
+                              std::span<std::uint16_t> values,
+                              completion_token&& token) {
+    return read_words_into<completion_token>(
+        unit, request::read_holding_registers{ address, static_cast<std::uint16_t>(values.size()) }, values,
+        std::forward<decltype(token)>(token));
+  }
+
+  /// Read values.size() input registers directly into values.
+  /**
+   * values must stay alive until the operation completes.
+   */
+  template <typename completion_token>
+  auto read_input_registers(std::uint8_t unit,
+                            std::uint16_t address,
+                            std::span<std::uint16_t> values,
+                            completion_token&& token) {
+    return read_words_into<completion_token>(
+        unit, request::read_input_registers{ address, static_cast<std::uint16_t>(values.size()) }, values,
+        std::forward<decltype(token)>(token));
+  }
+
   /// Write to a single coil on the connected server.
   template <typename completion_token>
   auto write_single_coil(std::uint8_t unit, std::uint16_t address, bool value, completion_token&& token) {
@@ -228,99 +372,284 @@ public:
                                      std::vector<std::uint16_t> values,
                                      completion_token&& token) {
     return send_message<completion_token>(
-        unit, request::read_write_multiple_registers{ read_address, read_count, write_address, values },
+        unit, request::read_write_multiple_registers{ read_address, read_count, write_address, std::move(values) },
         std::forward<decltype(token)>(token));
   }
 
 protected:
-  /// Send a Modbus request to the server.
+  /// Send a Modbus request and complete with the response.
   template <typename completion_token>
-  auto send_message(std::uint8_t unit, auto const send_request, completion_token&& token) {
+  auto send_message(std::uint8_t unit, auto send_request, completion_token&& token) {
     using response_type = typename decltype(send_request)::response;
-    return async_compose<completion_token, void(std::expected<response_type, std::error_code>)>(
-        [&, send_request](auto& self_outer) {
-          co_spawn(
-              ctx_,
-              [&, self = std::move(self_outer), request = std::move(send_request)]() mutable -> asio::awaitable<void> {
-                assert(request.length() <= std::numeric_limits<uint16_t>::max() - 1 && "Request length too large for type");
-                tcp_mbap request_header{ .transaction = ++next_id_,
-                                         .protocol = static_cast<uint16_t>(0),
-                                         .length = static_cast<uint16_t>(request.length() + 1U),
-                                         .unit = unit };
-
-                auto header_encoded = request_header.to_bytes();
-                auto request_serialized = impl::serialize_request(request);
-
-                std::vector<asio::const_buffer> buffers{ { asio::buffer(header_encoded),
-                                                           asio::buffer(request_serialized) } };
-
-                co_await asio::async_write(socket_, buffers, asio::use_awaitable);
-
-                /// Buffer for read operations.
-                std::array<uint8_t, tcp_mbap::size> header_buffer{};
-                // Read the response
-                auto [header_error, bytes_transferred] = co_await socket_.async_read_some(
-                    asio::buffer(header_buffer, tcp_mbap::size), asio::as_tuple(asio::use_awaitable));
-                if (header_error) {
-                  self.complete(std::unexpected(header_error));
-                  co_return;
-                }
-                auto header = tcp_mbap::from_bytes(header_buffer);
+    return send_decoded<std::expected<response_type, std::error_code>>(
+        unit, std::move(send_request),
+        [](std::expected<std::span<std::uint8_t const>, std::error_code> pdu)
+            -> std::expected<response_type, std::error_code> {
+          if (!pdu) {
+            return std::unexpected(pdu.error());
+          }
+          if constexpr (requires { response_type::length(); }) {
+            if (pdu->size() < response_type::length()) {
+              return std::unexpected(modbus_error(errc::message_size_mismatch));
+            }
+          }
+          response_type response{};
+          if (auto error = response.deserialize(pdu.value())) {
+            return std::unexpected(error);
+          }
+          return response;
+        },
+        std::forward<decltype(token)>(token));
+  }
 
-                // Make sure the message contains at least a function code. and a unit
-                if (header.length < 2) {
-                  self.complete(std::unexpected(modbus_error(errc::message_size_mismatch)));
-                  co_return;
-                }
+  /// Send a read request and complete with a borrowed view of the returned words.
+  template <typename completion_token>
+  auto send_words_view(std::uint8_t unit, auto const send_request, completion_token&& token) {
+    return send_decoded<std::expected<words_view, std::error_code>>(
+        unit, send_request,
+        [count = send_request.count](std::expected<std::span<std::uint8_t const>, std::error_code> pdu)
+            -> std::expected<words_view, std::error_code> {
+          auto payload = check_payload(pdu, count * 2U);
+          if (!payload) {
+            return std::unexpected(payload.error());
+          }
+          return words_view{ payload.value() };
+        },
+        std::forward<decltype(token)>(token));
+  }
 
-                std::array<uint8_t, modbus_max_pdu> read_buffer{};
-                auto [body_error, size_of_body] =
-                    co_await socket_.async_read_some(asio::buffer(read_buffer,
-                                                                  header.length - 1),  // -1 header.unit is inside the count
-                                                     asio::as_tuple(asio::use_awaitable));
-                if (body_error) {
-                  self.complete(std::unexpected(body_error));
-                  co_return;
-                }
-                if (size_of_body + 1 != static_cast<size_t>(header.length)) {
-                  self.complete(std::unexpected(modbus_error(errc::message_size_mismatch)));
-                  co_return;
-                }
-                // Parse and process all complete messages in the buffer.
-                auto function = response_type::function;
-                auto response = impl::deserialize_response(read_buffer, function);
-
-                // Handle deserialization errors in TCP MBAP.
-                // Cant send an error to a specific transaction and can't continue to read from the connection.
-                if (!response) {
-                  self.complete(std::unexpected(response.error()));
-                  co_return;
-                }
-                if (std::visit(
-                        [&](auto res) {
-                          // Function codes 128 and above are exception responses.
-                          if (static_cast<uint8_t>(res.function) >= 128) {
-                            self.complete(std::unexpected{
-                                modbus_error(header.length >= 3 ? errc_t(res.function) : errc::message_size_mismatch) });
-                            return true;
-                          }
-                          return false;
-                        },
-                        response.value())) {
-                  co_return;
-                }
+  /// Send a read request and complete with a borrowed view of the returned bits.
+  template <typename completion_token>
+  auto send_bits_view(std::uint8_t unit, auto const send_request, completion_token&& token) {
+    return send_decoded<std::expected<bits_view, std::error_code>>(
+        unit, send_request,
+        [count = send_request.count](std::expected<std::span<std::uint8_t const>, std::error_code> pdu)
+            -> std::expected<bits_view, std::error_code> {
+          auto payload = check_payload(pdu, (count + 7U) / 8U);
+          if (!payload) {
+            return std::unexpected(payload.error());
+          }
+          return bits_view{ payload.value(), count };
+        },
+        std::forward<decltype(token)>(token));
+  }
 
-                auto* value = std::get_if<response_type>(&response.value());
-                if (value) {
-                  self.complete(std::move(*value));
-                } else {
-                  self.complete(std::unexpected(modbus_error(errc::unexpected_function_code)));
-                }
-              },
-              asio::detached);
+  /// Send a read request and decode the returned words into values.
+  template <typename completion_token>
+  auto read_words_into(std::uint8_t unit,
+                       auto const send_request,
+                       std::span<std::uint16_t> values,
+                       completion_token&& token) {
+    return send_decoded<std::error_code>(
+        unit, send_request,
+        [values](std::expected<std::span<std::uint8_t const>, std::error_code> pdu) -> std::error_code {
+          auto payload = check_payload(pdu, values.size() * 2);
+          if (!payload) {
+            return payload.error();
+          }
+          words_view{ payload.value() }.copy_to(values);
+          return {};
         },
-        token, ctx_);
+        std::forward<decltype(token)>(token));
+  }
+
+  /// Send a read request and decode the returned bits into values.
+  template <typename completion_token, std::size_t bit_count>
+  auto read_bits_into(std::uint8_t unit,
+                      auto const send_request,
+                      std::bitset<bit_count>& values,
+                      completion_token&& token) {
+    return send_decoded<std::error_code>(
+        unit, send_request,
+        [&values](std::expected<std::span<std::uint8_t const>, std::error_code> pdu) -> std::error_code {
+          auto payload = check_payload(pdu, (bit_count + 7) / 8);
+          if (!payload) {
+            return payload.error();
+          }
+          bits_view{ payload.value(), bit_count }.copy_to(values);
+          return {};
+        },
+        std::forward<decltype(token)>(token));
   }
+
+  /// Check the byte count of a read response and return its payload.
+  static auto check_payload(std::expected<std::span<std::uint8_t const>, std::error_code> const& pdu,
+                            std::size_t expected_bytes) -> std::expected<std::span<std::uint8_t const>, std::error_code> {
+    if (!pdu) {
+      return std::unexpected(pdu.error());
+    }
+    // function code, byte count, payload
+    if (pdu->size() < 2 || pdu->size() - 2 < expected_bytes || (*pdu)[1] != expected_bytes) {
+      return std::unexpected(modbus_error(errc::message_size_mismatch));
+    }
+    return pdu->subspan(2, expected_bytes);
+  }
+
+  /// Send a Modbus request and complete with the result of decode applied to the raw response.
+  /**
+   * decode is invoked with the response PDU while it is still held in the receive buffer of the client.
+   * The transaction runs as a single composed operation on the socket, the only memory it needs besides
+   * the buffers of the client is the handler memory of the socket operations, which is taken from the
+   * recycling_pool of the calling thread.
+   */
+  template <typename result_type, typename completion_token>
+  auto send_decoded(std::uint8_t unit, auto request, auto decode, completion_token&& token) {
+    return async_compose<completion_token, void(result_type)>(
+        transaction_op<decltype(request), decltype(decode)>{ .client_ = *this,
+                                                             .request = std::move(request),
+                                                             .decode = std::move(decode),
+                                                             .unit = unit },
+        token, socket_);
+  }
+
+  /// Composed operation performing a single transaction with the server.
+  /**
+   * Numbers and encodes the request into write_buffer_ once the operation is started, so lazily started
+   * operations neither consume transaction ids nor overwrite the request of another transaction.
+   * Then writes the request, reads the MBAP header and then the PDU into read_buffer_.
+   */
+  template <typename request_t, typename decode_t>
+  struct transaction_op {
+    enum struct state_e : std::uint8_t { write, read_header, read_body, done };
+
+    static constexpr std::uint8_t function = std::to_underlying(request_t::function);
+
+    basic_client& client_;
+    request_t request;
+    decode_t decode;
+    std::uint8_t unit;
+    std::size_t request_size{};
+    std::uint16_t transaction{};
+    state_e state{ state_e::write };
+    std::chrono::steady_clock::time_point started{};
+
+    template <typename self_t>
+    void operator()(self_t& self, std::error_code error = {}, std::size_t bytes_transferred = 0) {
+      if (error) {
+        self.complete(decode(std::unexpected(error)));
+        return;
+      }
+      switch (state) {
+        case state_e::write: {
+          // Requests with more values than fit into a PDU cannot be encoded into write_buffer_.
+          if (request.length() > modbus_max_pdu) {
+            self.complete(decode(std::unexpected(modbus_error(errc::message_size_mismatch))));
+            return;
+          }
+          transaction = ++client_.next_id_;
+          tcp_mbap request_header{ .transaction = transaction,
+                                   .protocol = static_cast<uint16_t>(0),
+                                   .length = static_cast<uint16_t>(request.length() + 1U),
+                                   .unit = unit };
+          std::ranges::copy(request_header.to_bytes(), client_.write_buffer_.begin());
+          request_size =
+              tcp_mbap::size + request.serialize(std::span(client_.write_buffer_).subspan(tcp_mbap::size));
+          state = state_e::read_header;
+          started = std::chrono::steady_clock::now();
+          client_.trace(trace_point::write_start, function);
+          if (client_.capture_) {
+            client_.capture_->record(capture_direction::to_server, client_.capture_ports_,
+                                     std::span(client_.write_buffer_).first(request_size));
+          }
+          asio::async_write(client_.socket_, asio::buffer(client_.write_buffer_, request_size),
+                            impl::recycled(std::move(self)));
+          return;
+        }
+        case state_e::read_header:
+          client_.trace(trace_point::write_finish, function);
+          state = state_e::read_body;
+          asio::async_read(client_.socket_, asio::buffer(client_.header_buffer_), impl::recycled(std::move(self)));
+          return;
+        case state_e::read_body: {
+          client_.trace(trace_point::first_byte, function);
+          auto header = tcp_mbap::from_bytes(client_.header_buffer_);
+          // A response to another transaction leaves the stream out of step with the requests, give up on it.
+          if (header.transaction != transaction) {
+            client_.close();
+            self.complete(decode(std::unexpected(modbus_error(errc::unexpected_transaction_id))));
+            return;
+          }
+          // Make sure the message contains at least a function code. and a unit
+          if (header.length < 2 || header.length - 1U > client_.read_buffer_.size()) {
+            client_.close();
+            self.complete(decode(std::unexpected(modbus_error(errc::message_size_mismatch))));
+            return;
+          }
+          state = state_e::done;
+          // -1 header.unit is inside the count
+          asio::async_read(client_.socket_, asio::buffer(client_.read_buffer_, header.length - 1U),
+                           impl::recycled(std::move(self)));
+          return;
+        }
+        case state_e::done: {
+          client_.trace(trace_point::frame_complete, function);
+          client_.count_transaction(function, request_size, bytes_transferred, started);
+          if (client_.capture_) {
+            client_.capture_->record(capture_direction::to_client, client_.capture_ports_, client_.header_buffer_,
+                                     std::span(client_.read_buffer_).first(bytes_transferred));
+          }
+          auto result = decode(client_.response_pdu(function, bytes_transferred));
+          client_.trace(trace_point::decode_complete, function);
+          self.complete(std::move(result));
+          return;
+        }
+      }
+    }
+  };
+
+  /// Record a step of the transaction whose request is held in write_buffer_.
+  void trace(trace_point point, std::uint8_t function) const {
+    if constexpr (tracing_t::enabled) {
+      auto transaction = static_cast<std::uint16_t>((write_buffer_[0] << 8U) | write_buffer_[1]);
+      tracing_.record(trace_side::client, point, { trace_source_, transaction, write_buffer_[6], function });
+    }
+  }
+
+  /// Record a completed transaction in the metrics of the client.
+  void count_transaction(std::uint8_t function,
+                         std::size_t request_size,
+                         std::size_t response_size,
+                         std::chrono::steady_clock::time_point started) {
+    if (!metrics_) {
+      return;
+    }
+    metrics_->round_trip(std::chrono::steady_clock::now() - started);
+    metrics_->request(function);
+    metrics_->add(metric::bytes_out, static_cast<std::int64_t>(request_size));
+    metrics_->add(metric::bytes_in, static_cast<std::int64_t>(tcp_mbap::size + response_size));
+    if (read_buffer_[0] == (function | 0x80) && response_size >= 2) {
+      metrics_->exception(read_buffer_[1]);
+    }
+  }
+
+  /// Get the response PDU of the last transaction from the receive buffer.
+  /**
+   * \return The response PDU, including the function code. The span points into the receive
+   * buffer of the client and is only valid until the next transaction is started.
+   * Exception responses are returned as their modbus error code.
+   */
+  auto response_pdu(std::uint8_t function, std::size_t size) const
+      -> std::expected<std::span<std::uint8_t const>, std::error_code> {
+    // Function codes 128 and above are exception responses.
+    if (read_buffer_[0] == (function | 0x80)) {
+      return std::unexpected(modbus_error(size >= 2 ? errc_t(read_buffer_[1]) : errc::message_size_mismatch));
+    }
+    if (read_buffer_[0] != function) {
+      return std::unexpected(modbus_error(errc::unexpected_function_code));
+    }
+    return std::span<std::uint8_t const>(read_buffer_.data(), size);
+  }
+
+  /// Buffer for the encoded header and PDU of the current request.
+  std::array<std::uint8_t, tcp_mbap::size + modbus_max_pdu> write_buffer_{};
+
+  /// Buffer for the header of the current response.
+  std::array<std::uint8_t, tcp_mbap::size> header_buffer_{};
+
+  /// Buffer for the PDU of the current response, borrowed views point into this buffer.
+  std::array<std::uint8_t, modbus_max_pdu> read_buffer_{};
 };
 
+using client = basic_client<>;
+
 }  // namespace modbus
@@ -0,0 +1,263 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <asio/compose.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/post.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <modbus/capture.hpp>
+#include <modbus/logger.hpp>
+#include <modbus/metrics.hpp>
+#include <modbus/timer_wheel.hpp>
+
+namespace modbus {
+
+class connection_registry;
+
+/// State of a single client connection of the server.
+struct connection_state final : timer_wheel::entry {
+  explicit connection_state(asio::ip::tcp::socket&& client) : client_(std::move(client)) {
+    asio::error_code ignored;
+    endpoint_ = client_.remote_endpoint(ignored);
+  }
+
+  ~connection_state();
+
+  /// Mark the connection as active, refreshes the idle timeout and the eviction order.
+  void touch();
+
+  /// Check if the registry of the connection is draining.
+  [[nodiscard]] auto draining() const -> bool;
+
+  /// Close the socket, any pending operation completes with operation_aborted.
+  /**
+   * \param reason Logged when the connection state is destroyed.
+   */
+  void close(std::string_view reason) {
+    close_reason_ = reason;
+    asio::error_code ignored;
+    client_.close(ignored);
+  }
+
+  /// Called from the idle timer wheel.
+  void expire() override {
+    if (metrics_ != nullptr) {
+      metrics_->add(metric::timeouts);
+    }
+    close("timeout");
+  }
+
+  asio::ip::tcp::socket client_;
+
+  /// Address of the client, kept for logging after the socket is closed.
+  asio::ip::tcp::endpoint endpoint_;
+
+  /// Number of requests read but not yet answered.
+  /**
+   * A connection with requests in flight is busy, it is never evicted and is drained gracefully.
+   */
+  std::size_t in_flight_{};
+
+  /// Set while a response is being written, further responses are queued in write_queue_.
+  bool writing_{ false };
+
+  /// Complete response frames waiting for the current write to finish.
+  std::vector<std::vector<std::uint8_t>> write_queue_;
+
+  /// Why the server closed the connection, empty if it was not closed by the server.
+  std::string_view close_reason_{};
+
+  /// Where the traffic of the connection is counted, if anywhere.
+  metrics* metrics_{ nullptr };
+
+  /// Where the ADUs of the connection are recorded, if anywhere.
+  capture_log* capture_{ nullptr };
+
+  /// Ports of the connection, set along with capture_.
+  capture_ports capture_ports_{};
+
+private:
+  friend class connection_registry;
+
+  connection_state* prev_{ nullptr };
+  connection_state* next_{ nullptr };
+  connection_registry* registry_{ nullptr };
+};
+
+/// Book keeping of the open connections of a server.
+/**
+ * Connections are kept in an intrusive list ordered from least to most recently active, so
+ * admitting, refreshing and removing a connection never allocates. When the registry is full
+ * the least recently active connection that is not handling a request is evicted to make room.
+ *
+ * Not thread safe, all calls must be made from the executor of the server.
+ */
+class connection_registry {
+public:
+  /// \param max_connections Maximum number of open connections, zero for no limit.
+  connection_registry(asio::any_io_executor const& executor, std::size_t max_connections)
+      : empty_{ executor }, max_connections_{ max_connections } {}
+
+  connection_registry(connection_registry const&) = delete;
+  auto operator=(connection_registry const&) -> connection_registry& = delete;
+
+  ~connection_registry() {
+    while (head_ != nullptr) {
+      unlink(*head_);
+    }
+  }
+
+  /// Register a new connection.
+  /**
+   * \return false if the registry is full and no idle connection could be evicted,
+   *         or if the registry is draining.
+   */
+  [[nodiscard]] auto admit(connection_state& connection) -> bool {
+    if (draining_) {
+      return false;
+    }
+    if (max_connections_ != 0 && size_ >= max_connections_) {
+      auto* victim = head_;
+      while (victim != nullptr && victim->in_flight_ != 0) {
+        victim = victim->next_;
+      }
+      if (victim == nullptr) {
+        return false;
+      }
+      unlink(*victim);
+      victim->close("evicted");
+    }
+    push_back(connection);
+    return true;
+  }
+
+  /// Move the connection to the most recently active end.
+  void touch(connection_state& connection) {
+    if (connection.registry_ != this || tail_ == &connection) {
+      return;
+    }
+    unlink(connection);
+    push_back(connection);
+  }
+
+  /// Unregister a connection, completes pending wait_empty operations when it was the last one.
+  void remove(connection_state& connection) {
+    if (connection.registry_ != this) {
+      return;
+    }
+    unlink(connection);
+    if (size_ == 0) {
+      empty_.cancel();
+    }
+  }
+
+  /// Stop admitting connections and close all connections that are not handling a request.
+  /**
+   * Busy connections are expected to close themselves once their requests are answered.
+   */
+  void drain() {
+    draining_ = true;
+    auto* connection = head_;
+    while (connection != nullptr) {
+      auto* next = connection->next_;
+      if (connection->in_flight_ == 0) {
+        unlink(*connection);
+        connection->close("drained");
+      }
+      connection = next;
+    }
+    if (size_ == 0) {
+      empty_.cancel();
+    }
+  }
+
+  /// Check if drain has been called.
+  [[nodiscard]] auto draining() const -> bool { return draining_; }
+
+  /// Number of registered connections.
+  [[nodiscard]] auto size() const -> std::size_t { return size_; }
+
+  /// Wait until no connections are registered.
+  /**
+   * Completion signature void()
+   */
+  template <typename completion_token>
+  auto wait_empty(completion_token&& token) {
+    return asio::async_compose<completion_token, void()>(
+        [this, waiting = false](auto& self, asio::error_code = {}) mutable {
+          if (waiting) {
+            self.complete();
+            return;
+          }
+          waiting = true;
+          if (size_ == 0) {
+            asio::post(empty_.get_executor(), std::move(self));
+            return;
+          }
+          empty_.expires_at(std::chrono::steady_clock::time_point::max());
+          empty_.async_wait(std::move(self));
+        },
+        token, empty_);
+  }
+
+private:
+  void push_back(connection_state& connection) {
+    connection.registry_ = this;
+    connection.prev_ = tail_;
+    connection.next_ = nullptr;
+    if (tail_ != nullptr) {
+      tail_->next_ = &connection;
+    } else {
+      head_ = &connection;
+    }
+    tail_ = &connection;
+    ++size_;
+  }
+
+  void unlink(connection_state& connection) {
+    (connection.prev_ != nullptr ? connection.prev_->next_ : head_) = connection.next_;
+    (connection.next_ != nullptr ? connection.next_->prev_ : tail_) = connection.prev_;
+    connection.prev_ = nullptr;
+    connection.next_ = nullptr;
+    connection.registry_ = nullptr;
+    --size_;
+  }
+
+  asio::steady_timer empty_;
+  std::size_t max_connections_;
+  std::size_t size_{};
+  connection_state* head_{ nullptr };
+  connection_state* tail_{ nullptr };
+  bool draining_{ false };
+};
+
+inline connection_state::~connection_state() {
+  if (!close_reason_.empty()) {
+    log<log_level::info>(log_category::connection, close_reason_, endpoint_);
+  }
+  if (registry_ != nullptr) {
+    registry_->remove(*this);
+  }
+}
+
+inline void connection_state::touch() {
+  timer_wheel::entry::touch();
+  if (registry_ != nullptr) {
+    registry_->touch(*this);
+  }
+}
+
+inline auto connection_state::draining() const -> bool {
+  return registry_ != nullptr && registry_->draining();
+}
+
+}  // namespace modbus
@@ -1,117 +1,266 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include <modbus/atomic_groups.hpp>
+#include <modbus/change_feed.hpp>
 #include <modbus/error.hpp>
+#include <modbus/paged_table.hpp>
 #include <modbus/server.hpp>
+#include <modbus/wire_table.hpp>
 
 // TODO: Create a simpler default handler and write tests for both
 namespace modbus {
-struct default_handler {
-  default_handler() : registers(0x20000), coils(0x20000), input_registers(0x20000), desc_input(0x20000) {}
-
-  modbus::response::read_coils handle(uint8_t, const modbus::request::read_coils& req, modbus::errc_t&) const {
+/// Handler answering requests from in memory data tables.
+/**
+ * The tables are paged_table instances, so only the pages of the address space that have been
+ * written take memory. Mark pages absent or read only to answer requests on them with illegal_data_address.
+ *
+ * register_table_t stores the holding and input registers, paged_table<std::uint16_t> in host order
+ * or wire_table in wire order. Register reads from a wire_table are answered with the stored bytes, which the
+ * server copies straight into the response frame.
+ */
+template <typename register_table_t = paged_table<std::uint16_t>>
+struct basic_default_handler {
+  modbus::response::read_coils handle(uint8_t, const modbus::request::read_coils& req, modbus::errc_t& error) const {
     modbus::response::read_coils resp{};
-    resp.values.insert(resp.values.end(), coils.cbegin() + req.address, coils.cbegin() + req.address + req.count);
+    error = coils.read(req.address, req.count, std::back_inserter(resp.values));
     return resp;
   }
 
   modbus::response::read_discrete_inputs handle(uint8_t,
                                                 const modbus::request::read_discrete_inputs& req,
-                                                modbus::errc_t&) const {
+                                                modbus::errc_t& error) const {
     modbus::response::read_discrete_inputs resp{};
-    resp.values.insert(resp.values.end(), desc_input.cbegin() + req.address, desc_input.cbegin() + req.address + req.count);
+    error = desc_input.read(req.address, req.count, std::back_inserter(resp.values));
     return resp;
   }
 
-  modbus::response::read_holding_registers handle(uint8_t,
-                                                  const modbus::request::read_holding_registers& req,
-                                                  modbus::errc_t&) const {
-    modbus::response::read_holding_registers resp{};
-    resp.values.insert(resp.values.end(), registers.cbegin() + req.address, registers.cbegin() + req.address + req.count);
-    return resp;
+  auto handle(uint8_t, const modbus::request::read_holding_registers& req, modbus::errc_t& error) const {
+    return read_registers<modbus::response::read_holding_registers>(registers, register_groups, req, error);
   }
 
-  modbus::response::read_input_registers handle(uint8_t,
-                                                const modbus::request::read_input_registers& req,
-                                                modbus::errc_t&) const {
-    modbus::response::read_input_registers resp;
-    resp.values.insert(resp.values.end(), input_registers.cbegin() + req.address,
-                       input_registers.cbegin() + req.address + req.count);
-    return resp;
+  auto handle(uint8_t, const modbus::request::read_input_registers& req, modbus::errc_t& error) const {
+    return read_registers<modbus::response::read_input_registers>(input_registers, input_register_groups, req, error);
   }
 
-  modbus::response::write_single_coil handle(uint8_t, const modbus::request::write_single_coil& req, modbus::errc_t&) {
+  /// Encode register reads of a wire_table straight into the frame of the server, see encoding_handler_for.
+  auto handle(uint8_t,
+              const modbus::request::read_holding_registers& req,
+              std::span<std::uint8_t> pdu,
+              modbus::errc_t& error) const -> std::size_t
+    requires std::is_same_v<register_table_t, wire_table>
+  {
+    return read_wire<modbus::response::read_holding_registers>(registers, register_groups, req, pdu, error);
+  }
+
+  auto handle(uint8_t,
+              const modbus::request::read_input_registers& req,
+              std::span<std::uint8_t> pdu,
+              modbus::errc_t& error) const -> std::size_t
+    requires std::is_same_v<register_table_t, wire_table>
+  {
+    return read_wire<modbus::response::read_input_registers>(input_registers, input_register_groups, req, pdu, error);
+  }
+
+  modbus::response::write_single_coil handle(uint8_t unit,
+                                             const modbus::request::write_single_coil& req,
+                                             modbus::errc_t& error) {
     modbus::response::write_single_coil resp{};
-    coils[req.address] = req.value;
+    error = write_coils(unit, req.address, std::array{ req.value });
     resp.address = req.address;
     resp.value = req.value;
     return resp;
   }
 
-  modbus::response::write_single_register handle(uint8_t,
+  modbus::response::write_single_register handle(uint8_t unit,
                                                  const modbus::request::write_single_register& req,
-                                                 modbus::errc_t&) {
+                                                 modbus::errc_t& error) {
     modbus::response::write_single_register resp{};
-    registers[req.address] = req.value;
+    error = write_registers(unit, req.address, std::array{ req.value }, register_groups.lock());
     resp.address = req.address;
     resp.value = req.value;
     return resp;
   }
 
-  modbus::response::write_multiple_coils handle(uint8_t, const modbus::request::write_multiple_coils& req, modbus::errc_t&) {
+  modbus::response::write_multiple_coils handle(uint8_t unit,
+                                                const modbus::request::write_multiple_coils& req,
+                                                modbus::errc_t& error) {
     modbus::response::write_multiple_coils resp{};
+    error = write_coils(unit, req.address, req.values);
     resp.address = req.address;
-    resp.count = 0;
-    auto iit = req.values.begin();
-    auto oit = coils.begin() + req.address;
-    while (iit < req.values.end() && oit < coils.end()) {
-      *oit++ = *iit++;
-      ++resp.count;
-    }
+    resp.count = static_cast<std::uint16_t>(req.values.size());
     return resp;
   }
 
-  modbus::response::write_multiple_registers handle(uint8_t,
+  modbus::response::write_multiple_registers handle(uint8_t unit,
                                                     const modbus::request::write_multiple_registers& req,
-                                                    modbus::errc_t&) {
+                                                    modbus::errc_t& error) {
     modbus::response::write_multiple_registers resp{};
+    error = write_registers(unit, req.address, req.values, register_groups.lock());
     resp.address = req.address;
-    resp.count = 0;
-    auto iit = req.values.begin();
-    auto oit = registers.begin() + req.address;
-    while (iit < req.values.end() && oit < registers.end()) {
-      *oit++ = *iit++;
-      ++resp.count;
-    }
+    resp.count = static_cast<std::uint16_t>(req.values.size());
     return resp;
   }
 
-  modbus::response::read_write_multiple_registers handle(uint8_t,
+  modbus::response::read_write_multiple_registers handle(uint8_t unit,
                                                          const modbus::request::read_write_multiple_registers& req,
-                                                         modbus::errc_t&) {
+                                                         modbus::errc_t& error) {
     modbus::response::read_write_multiple_registers resp{};
-    auto iit = req.values.begin();
-    auto oit = registers.begin() + req.write_address;
-    while (iit < req.values.end() && oit < registers.end()) {
-      *oit++ = *iit++;
+    // The write is performed before the read, check both before changing anything.
+    auto held = register_groups.lock();
+    error = registers.check_read(req.read_address, req.read_count);
+    if (!error) {
+      error = write_registers(unit, req.write_address, req.values, held);
+    }
+    if (!error) {
+      resp.values.reserve(req.read_count);
+      error = registers.read(req.read_address, req.read_count, std::back_inserter(resp.values));
+      register_groups.read(req.read_address, req.read_count, [&](std::uint16_t address, std::uint16_t value) {
+        resp.values[address - req.read_address] = value;
+      });
     }
-    resp.values.insert(resp.values.end(), registers.cbegin() + req.read_address,
-                       registers.cbegin() + req.read_address + req.read_count);
     return resp;
   }
 
-  // TODO: Verify this method
-  modbus::response::mask_write_register handle(uint8_t, const modbus::request::mask_write_register& req, modbus::errc_t&) {
+  modbus::response::mask_write_register handle(uint8_t unit,
+                                               const modbus::request::mask_write_register& req,
+                                               modbus::errc_t& error) {
     modbus::response::mask_write_register resp{};
     resp.address = req.address;
     resp.and_mask = req.and_mask;
     resp.or_mask = req.or_mask;
-    registers[req.address] = (registers[req.address] & req.and_mask) | req.or_mask;
+    auto held = register_groups.lock();
+    error = registers.check_write(req.address, 1);
+    if (!error) {
+      auto current = std::as_const(registers)[req.address];
+      register_groups.read(req.address, 1, [&](std::uint16_t, std::uint16_t value) { current = value; });
+      auto masked = static_cast<std::uint16_t>((current & req.and_mask) | (req.or_mask & ~req.and_mask));
+      error = write_registers(unit, req.address, std::array{ masked }, held);
+    }
     return resp;
   }
 
-  std::vector<std::uint16_t> registers;
-  std::vector<bool> coils;
-  std::vector<std::uint16_t> input_registers;
-  std::vector<bool> desc_input;
+  register_table_t registers;
+  paged_table<bool> coils;
+  register_table_t input_registers;
+  paged_table<bool> desc_input;
+
+  /// Groups of registers updated and read as one unit, see atomic_groups.
+  /**
+   * The values of grouped registers live in the groups, the application accesses them through
+   * the load and store of the groups instead of the tables.
+   */
+  atomic_groups register_groups;
+  atomic_groups input_register_groups;
+
+  /// Receives every accepted coil and holding register write when set.
+  std::shared_ptr<change_feed> changes;
+
+  /// Number of times the application reported changing the tables directly or stored into the groups.
+  [[nodiscard]] auto version() const -> std::uint64_t {
+    return version_.load(std::memory_order_acquire) + register_groups.version() + input_register_groups.version();
+  }
+
+  /// Report a direct change to the tables, so cached responses of them are not used any more.
+  /**
+   * Stores into register_groups and input_register_groups are counted without it.
+   */
+  void bump_version() { version_.fetch_add(1, std::memory_order_release); }
+
+private:
+  std::atomic<std::uint64_t> version_{};
+
+  template <typename range_t>
+  auto write_coils(std::uint8_t unit, std::uint16_t address, range_t const& values) -> modbus::errc_t {
+    auto error = coils.write(address, values);
+    if (!error && changes) {
+      changes->publish_coils(unit, address, values);
+    }
+    return error;
+  }
+
+  template <typename range_t>
+  auto write_registers(std::uint8_t unit,
+                       std::uint16_t address,
+                       range_t const& values,
+                       std::unique_lock<std::mutex> const& held) -> modbus::errc_t {
+    auto error = registers.write(address, values);
+    if (!error) {
+      std::span<std::uint16_t const> written{ values.data(), values.size() };
+      register_groups.write(address, written, held);
+      if (changes) {
+        changes->publish(unit, address, written);
+      }
+    }
+    return error;
+  }
+
+  template <typename response_t, typename request_t>
+  static auto read_registers(register_table_t const& table,
+                             atomic_groups const& groups,
+                             request_t const& req,
+                             modbus::errc_t& error) {
+    if constexpr (std::is_same_v<register_table_t, wire_table>) {
+      modbus::response::encoded<response_t> resp{};
+      resp.pdu.resize(pdu_buffer::capacity);
+      resp.pdu.resize(read_wire<response_t>(table, groups, req, resp.pdu, error));
+      return resp;
+    } else {
+      response_t resp{};
+      resp.values.reserve(req.count);
+      error = table.read(req.address, req.count, std::back_inserter(resp.values));
+      if (!error) {
+        groups.read(req.address, req.count, [&](std::uint16_t address, std::uint16_t value) {
+          resp.values[address - req.address] = value;
+        });
+      }
+      return resp;
+    }
+  }
+
+  /// Encode the response to a register read from a wire_table into pdu.
+  /**
+   * \return The size of the response PDU, zero on errors.
+   */
+  template <typename response_t, typename request_t>
+  static auto read_wire(wire_table const& table,
+                        atomic_groups const& groups,
+                        request_t const& req,
+                        std::span<std::uint8_t> pdu,
+                        modbus::errc_t& error) -> std::size_t {
+    // Function code, byte count and the stored bytes as they are.
+    auto size = 2 + 2 * std::size_t{ req.count };
+    if (size > pdu.size()) {
+      error = errc::illegal_data_value;
+      return 0;
+    }
+    error = table.read_wire(req.address, req.count, pdu.data() + 2);
+    if (error) {
+      return 0;
+    }
+    pdu[0] = static_cast<std::uint8_t>(response_t::function);
+    pdu[1] = static_cast<std::uint8_t>(2 * req.count);
+    groups.read(req.address, req.count, [&](std::uint16_t address, std::uint16_t value) {
+      auto offset = 2 + 2 * static_cast<std::size_t>(address - req.address);
+      pdu[offset] = static_cast<std::uint8_t>(value >> 8U);
+      pdu[offset + 1] = static_cast<std::uint8_t>(value & 0xffU);
+    });
+    return size;
+  }
 };
+
+/// Handler keeping its registers in host order.
+using default_handler = basic_default_handler<>;
+
+/// Handler keeping its registers in wire order, for data that is read far more often than written.
+using wire_default_handler = basic_default_handler<wire_table>;
 }  // namespace modbus
\ No newline at end of file
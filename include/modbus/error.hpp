@@ -44,6 +44,7 @@ enum errc_t {
   message_too_large = 0x1002,
   unexpected_function_code = 0x1003,
   invalid_value = 0x1004,
+  unexpected_transaction_id = 0x1005,
 };
 }
 
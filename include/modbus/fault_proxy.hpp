@@ -0,0 +1,356 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <asio/as_tuple.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/read.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include <modbus/constants.hpp>
+#include <modbus/logger.hpp>
+#include <modbus/tcp.hpp>
+
+namespace modbus {
+
+/// Random time a frame is held before it is passed on.
+/**
+ * Every frame waits base plus a uniformly distributed part of jitter, and with spike_probability
+ * spike on top for a long tail. Frames of a direction are passed on in order, a held frame holds up
+ * the frames behind it like a retransmission would.
+ */
+struct delay_distribution {
+  std::chrono::nanoseconds base{};
+  std::chrono::nanoseconds jitter{};
+  double spike_probability{};
+  std::chrono::nanoseconds spike{};
+};
+
+/// Faults injected into the frames of one direction.
+/**
+ * Probabilities are per frame. At most one of reset, drop, truncate, slow and split applies to a
+ * frame, checked in that order, and any frame that is passed on is delayed.
+ */
+struct fault_options {
+  delay_distribution delay{};
+
+  /// Close both connections with a TCP reset instead of passing the frame on.
+  double reset_probability{};
+
+  /// Discard the frame, the peer waits for it in vain.
+  double drop_probability{};
+
+  /// Pass on the MBAP header and part of the rest of the frame, then close both connections.
+  double truncate_probability{};
+
+  /// Pass the frame on one byte at a time, slow_interval apart, like a slow-loris peer.
+  double slow_probability{};
+  std::chrono::nanoseconds slow_interval{ std::chrono::milliseconds{ 1 } };
+
+  /// Pass the frame on in two to four segments, split_interval apart.
+  double split_probability{};
+  std::chrono::nanoseconds split_interval{ std::chrono::microseconds{ 100 } };
+};
+
+/// Frames seen and faults injected in one direction.
+struct fault_stats {
+  std::uint64_t frames{};
+  std::uint64_t resets{};
+  std::uint64_t drops{};
+  std::uint64_t truncations{};
+  std::uint64_t slowed{};
+  std::uint64_t splits{};
+};
+
+struct fault_proxy_options {
+  /// Faults in the requests.
+  fault_options to_server{};
+  /// Faults in the responses.
+  fault_options to_client{};
+  /// Seed of the random faults, a run with the same seed and traffic injects the same faults.
+  std::uint64_t seed{ 1 };
+};
+
+/// Loopback Modbus TCP proxy injecting delays and faults, for tests and benchmarks of timeouts and reconnects.
+/**
+ * Every accepted connection is connected to upstream. Traffic is read frame by frame using the
+ * MBAP header and each frame is passed on, delayed or faulted according to the fault_options of
+ * its direction. A connection that sends a frame longer than a Modbus TCP ADU is closed.
+ *
+ * Runs on the executor of io_context and is not thread safe, read stats() on that executor or
+ * once it has stopped.
+ */
+class fault_proxy {
+public:
+  fault_proxy(asio::io_context& io_context,
+              asio::ip::tcp::endpoint upstream,
+              fault_proxy_options options = {},
+              asio::ip::tcp::endpoint const& endpoint = { asio::ip::address_v4::loopback(), 0 })
+      : acceptor_{ io_context, endpoint }, upstream_{ upstream }, options_{ options }, random_{ options.seed } {}
+
+  void start() { asio::co_spawn(acceptor_.get_executor(), listen(), asio::detached); }
+
+  /// Stop accepting and close every proxied connection.
+  void stop() {
+    asio::error_code ignored;
+    acceptor_.close(ignored);
+    for (auto& weak : links_) {
+      if (auto open = weak.lock()) {
+        open->close();
+      }
+    }
+    links_.clear();
+  }
+
+  /// Where clients connect to reach upstream.
+  [[nodiscard]] auto local_endpoint() const -> asio::ip::tcp::endpoint { return acceptor_.local_endpoint(); }
+
+  [[nodiscard]] auto to_server_stats() const -> fault_stats const& { return to_server_stats_; }
+  [[nodiscard]] auto to_client_stats() const -> fault_stats const& { return to_client_stats_; }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  /// A frame waiting to be passed on.
+  struct pending_frame {
+    std::vector<std::uint8_t> bytes;
+    clock::time_point release;
+  };
+
+  /// The frames of one direction, between the coroutine reading them and the one passing them on.
+  struct direction {
+    explicit direction(asio::any_io_executor const& executor) : ready{ executor, clock::time_point::max() } {}
+
+    std::deque<pending_frame> queue;
+    /// Cancelled when a frame is queued or reading has finished.
+    asio::steady_timer ready;
+    bool finished{ false };
+  };
+
+  /// A proxied connection.
+  struct link {
+    explicit link(asio::ip::tcp::socket&& accepted)
+        : client{ std::move(accepted) }, server{ client.get_executor() }, requests{ client.get_executor() },
+          responses{ client.get_executor() } {}
+
+    void close() {
+      asio::error_code ignored;
+      client.close(ignored);
+      server.close(ignored);
+      requests.ready.cancel();
+      responses.ready.cancel();
+    }
+
+    /// Close both connections so their peers see a reset instead of an orderly shutdown.
+    void reset() {
+      asio::error_code ignored;
+      client.set_option(asio::socket_base::linger{ true, 0 }, ignored);
+      server.set_option(asio::socket_base::linger{ true, 0 }, ignored);
+      close();
+    }
+
+    asio::ip::tcp::socket client;
+    asio::ip::tcp::socket server;
+    direction requests;
+    direction responses;
+  };
+
+  auto listen() -> asio::awaitable<void> {
+    for (;;) {
+      auto [error, socket] = co_await acceptor_.async_accept(asio::as_tuple(asio::use_awaitable));
+      if (!acceptor_.is_open()) {
+        co_return;
+      }
+      if (error) {
+        log<log_level::error>(log_category::accept, "proxy accept failed", {}, 0, error);
+        continue;
+      }
+      std::erase_if(links_, [](auto const& weak) { return weak.expired(); });
+      auto proxied = std::make_shared<link>(std::move(socket));
+      links_.push_back(proxied);
+      asio::co_spawn(acceptor_.get_executor(), serve(std::move(proxied)), asio::detached);
+    }
+  }
+
+  auto serve(std::shared_ptr<link> proxied) -> asio::awaitable<void> {
+    auto [error] = co_await proxied->server.async_connect(upstream_, asio::as_tuple(asio::use_awaitable));
+    if (error) {
+      log<log_level::warning>(log_category::connection, "proxy connect failed", upstream_, 0, error);
+      proxied->close();
+      co_return;
+    }
+    // Segments are only split where the proxy writes them.
+    asio::error_code ignored;
+    proxied->client.set_option(asio::ip::tcp::no_delay{ true }, ignored);
+    proxied->server.set_option(asio::ip::tcp::no_delay{ true }, ignored);
+
+    auto executor = acceptor_.get_executor();
+    asio::co_spawn(executor, read_frames(proxied, proxied->client, proxied->requests, options_.to_server), asio::detached);
+    asio::co_spawn(executor, pass_frames(proxied, proxied->server, proxied->requests, options_.to_server, to_server_stats_),
+                   asio::detached);
+    asio::co_spawn(executor, read_frames(proxied, proxied->server, proxied->responses, options_.to_client),
+                   asio::detached);
+    asio::co_spawn(executor,
+                   pass_frames(proxied, proxied->client, proxied->responses, options_.to_client, to_client_stats_),
+                   asio::detached);
+  }
+
+  /// Read frames from source and queue them with the time they are to be passed on.
+  auto read_frames(std::shared_ptr<link> proxied,
+                   asio::ip::tcp::socket& source,
+                   direction& frames,
+                   fault_options const& faults) -> asio::awaitable<void> {
+    clock::time_point last_release{};
+    for (;;) {
+      std::vector<std::uint8_t> bytes(tcp_mbap::size);
+      auto [header_error, header_size] =
+          co_await asio::async_read(source, asio::buffer(bytes), asio::as_tuple(asio::use_awaitable));
+      if (header_error) {
+        break;
+      }
+      auto header = tcp_mbap::from_bytes(std::span(bytes).first<tcp_mbap::size>());
+      if (header.length < 1 || header.length - 1U > modbus_max_pdu) {
+        proxied->close();
+        break;
+      }
+      bytes.resize(tcp_mbap::size + header.length - 1U);
+      auto [body_error, body_size] = co_await asio::async_read(
+          source, asio::buffer(bytes.data() + tcp_mbap::size, bytes.size() - tcp_mbap::size),
+          asio::as_tuple(asio::use_awaitable));
+      if (body_error) {
+        break;
+      }
+      last_release = std::max(last_release, clock::now() + delay(faults.delay));
+      frames.queue.push_back({ std::move(bytes), last_release });
+      frames.ready.cancel();
+    }
+    frames.finished = true;
+    frames.ready.cancel();
+  }
+
+  /// Pass the queued frames on to destination, injecting the faults of the direction.
+  auto pass_frames(std::shared_ptr<link> proxied,
+                   asio::ip::tcp::socket& destination,
+                   direction& frames,
+                   fault_options const& faults,
+                   fault_stats& stats) -> asio::awaitable<void> {
+    asio::steady_timer timer{ destination.get_executor() };
+    for (;;) {
+      if (frames.queue.empty()) {
+        if (frames.finished || !destination.is_open()) {
+          break;
+        }
+        frames.ready.expires_at(clock::time_point::max());
+        co_await frames.ready.async_wait(asio::as_tuple(asio::use_awaitable));
+        continue;
+      }
+      auto frame = std::move(frames.queue.front());
+      frames.queue.pop_front();
+      ++stats.frames;
+      timer.expires_at(frame.release);
+      co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+
+      std::vector<std::size_t> cuts;
+      auto interval = std::chrono::nanoseconds{};
+      auto size = frame.bytes.size();
+      if (chance(faults.reset_probability)) {
+        ++stats.resets;
+        proxied->reset();
+        co_return;
+      }
+      if (chance(faults.drop_probability)) {
+        ++stats.drops;
+        continue;
+      }
+      // A frame holding only the header and unit has no body to cut.
+      bool truncate = chance(faults.truncate_probability) && size > tcp_mbap::size + 1;
+      if (truncate) {
+        ++stats.truncations;
+        size = tcp_mbap::size + between(0, size - tcp_mbap::size - 1);
+      } else if (chance(faults.slow_probability)) {
+        ++stats.slowed;
+        for (std::size_t cut = 1; cut < size; ++cut) {
+          cuts.push_back(cut);
+        }
+        interval = faults.slow_interval;
+      } else if (chance(faults.split_probability) && size > 1) {
+        ++stats.splits;
+        for (auto count = between(1, 3); count > 0; --count) {
+          cuts.push_back(between(1, size - 1));
+        }
+        std::ranges::sort(cuts);
+        cuts.erase(std::ranges::unique(cuts).begin(), cuts.end());
+        interval = faults.split_interval;
+      }
+      cuts.push_back(size);
+
+      std::size_t written{};
+      for (auto cut : cuts) {
+        if (written != 0) {
+          timer.expires_after(interval);
+          co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+        }
+        auto [error, count] = co_await asio::async_write(
+            destination, asio::buffer(frame.bytes.data() + written, cut - written), asio::as_tuple(asio::use_awaitable));
+        if (error) {
+          proxied->close();
+          co_return;
+        }
+        written = cut;
+      }
+      if (truncate) {
+        proxied->close();
+        co_return;
+      }
+    }
+    // Pass the orderly shutdown of the source on.
+    asio::error_code ignored;
+    destination.shutdown(asio::ip::tcp::socket::shutdown_send, ignored);
+  }
+
+  auto chance(double probability) -> bool {
+    return probability > 0 && std::uniform_real_distribution<double>{ 0.0, 1.0 }(random_) < probability;
+  }
+
+  auto between(std::size_t low, std::size_t high) -> std::size_t {
+    return std::uniform_int_distribution<std::size_t>{ low, high }(random_);
+  }
+
+  auto delay(delay_distribution const& distribution) -> std::chrono::nanoseconds {
+    auto result = distribution.base;
+    if (distribution.jitter.count() > 0) {
+      result += std::chrono::nanoseconds{
+        std::uniform_int_distribution<std::int64_t>{ 0, distribution.jitter.count() }(random_)
+      };
+    }
+    if (chance(distribution.spike_probability)) {
+      result += distribution.spike;
+    }
+    return result;
+  }
+
+  asio::ip::tcp::acceptor acceptor_;
+  asio::ip::tcp::endpoint upstream_;
+  fault_proxy_options options_;
+  std::mt19937_64 random_;
+  std::vector<std::weak_ptr<link>> links_;
+  fault_stats to_server_stats_{};
+  fault_stats to_client_stats_{};
+};
+
+}  // namespace modbus
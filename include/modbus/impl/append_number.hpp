@@ -0,0 +1,19 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <string>
+
+namespace modbus::impl {
+
+/// Append value to out in its shortest decimal form, without going through a locale or a stream.
+template <typename value_t>
+void append_number(std::string& out, value_t value) {
+  std::array<char, 32> digits{};
+  auto [end, error] = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+  out.append(digits.data(), end);
+}
+
+}  // namespace modbus::impl
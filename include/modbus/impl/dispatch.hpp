@@ -0,0 +1,41 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <variant>
+
+#include <modbus/request.hpp>
+
+namespace modbus::impl {
+
+/// Table of dispatcher_t::call<request_t> indexed by the function code of request_t.
+/**
+ * dispatcher_t provides
+ *  - `using function_type = ...;` a function pointer type,
+ *  - `template <typename request_t> static constexpr bool supports;`
+ *  - `template <typename request_t> static auto call(...)` convertible to function_type.
+ * Entries of function codes that are not supported are nullptr.
+ */
+template <typename dispatcher_t>
+constexpr auto make_dispatch_table() -> std::array<typename dispatcher_t::function_type, 256> {
+  std::array<typename dispatcher_t::function_type, 256> table{};
+  [&table]<std::size_t... index>(std::index_sequence<index...>) {
+    (
+        [&table]<typename request_t>() {
+          if constexpr (dispatcher_t::template supports<request_t>) {
+            table[static_cast<std::uint8_t>(request_t::function)] = &dispatcher_t::template call<request_t>;
+          }
+        }.template operator()<std::variant_alternative_t<index, request::requests>>(),
+        ...);
+  }(std::make_index_sequence<std::variant_size_v<request::requests>>{});
+  return table;
+}
+
+/// Dispatch table of dispatcher_t, generated at compile time.
+template <typename dispatcher_t>
+inline constexpr auto dispatch_table = make_dispatch_table<dispatcher_t>();
+
+}  // namespace modbus::impl
@@ -24,7 +24,9 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
+#include <algorithm>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 #include <modbus/error.hpp>
@@ -56,6 +58,36 @@ inline auto bool_to_uint16(bool value) -> std::uint16_t {
   return { static_cast<uint8_t>(value & 0xff), static_cast<uint8_t>(value >> 8) };
 }
 
+/// Write an uint16_t in big endian to the start of buffer.
+inline void write_be16(std::span<std::uint8_t> buffer, std::uint16_t value) {
+  buffer[0] = static_cast<std::uint8_t>(value >> 8);
+  buffer[1] = static_cast<std::uint8_t>(value & 0xff);
+}
+
+/// Write a packed list of booleans to the start of buffer.
+/**
+ * \return The number of bytes written.
+ */
+inline auto write_bit_list(std::span<std::uint8_t> buffer, std::vector<bool> const& values) -> std::size_t {
+  size_t byte_count = (values.size() + 7) / 8;
+  std::fill_n(buffer.begin(), byte_count, 0);
+  for (std::size_t bit = 0; bit < values.size(); ++bit) {
+    buffer[bit / 8] |= static_cast<std::uint8_t>(static_cast<int>(values[bit]) << (bit % 8));
+  }
+  return byte_count;
+}
+
+/// Write a list of 16 bit words in big endian to the start of buffer.
+/**
+ * \return The number of bytes written.
+ */
+inline auto write_word_list(std::span<std::uint8_t> buffer, std::span<std::uint16_t const> values) -> std::size_t {
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    write_be16(buffer.subspan(i * 2), values[i]);
+  }
+  return values.size() * 2;
+}
+
 /// Serialize a packed list of booleans for Modbus.
 [[nodiscard]] auto serialize_bit_list(std::vector<bool> const& values) -> std::vector<uint8_t> {
   size_t byte_count = (values.size() + 7) / 8;
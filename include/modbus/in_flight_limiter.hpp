@@ -0,0 +1,77 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include <asio/steady_timer.hpp>
+
+#include <modbus/connection_registry.hpp>
+
+namespace modbus {
+
+/// Bounds the number of requests being processed, per connection and for the whole server.
+/**
+ * A request holds a slot from the moment its header is read until its response is written.
+ * Connections that can not get a slot wait for one to be released, which stops them from reading
+ * further requests and so pushes back on the client through TCP flow control.
+ *
+ * Not thread safe, all calls must be made from the executor of the server.
+ */
+class in_flight_limiter {
+public:
+  /// \param max_total Maximum number of requests in flight on all connections, zero for no limit.
+  /// \param max_per_connection Maximum number of requests in flight on a single connection, zero for no limit.
+  in_flight_limiter(asio::any_io_executor const& executor, std::size_t max_total, std::size_t max_per_connection)
+      : released_{ executor, std::chrono::steady_clock::time_point::max() }, max_total_{ max_total },
+        max_per_connection_{ max_per_connection } {}
+
+  /// Take a slot for a request on connection.
+  /**
+   * \return false if either bound is reached.
+   */
+  [[nodiscard]] auto try_acquire(connection_state& connection) -> bool {
+    if ((max_total_ != 0 && in_flight_ >= max_total_) ||
+        (max_per_connection_ != 0 && connection.in_flight_ >= max_per_connection_)) {
+      return false;
+    }
+    ++in_flight_;
+    ++connection.in_flight_;
+    if (connection.metrics_ != nullptr) {
+      connection.metrics_->add(metric::in_flight);
+    }
+    return true;
+  }
+
+  /// Give back a slot taken by try_acquire and wake up waiting connections.
+  void release(connection_state& connection) {
+    --in_flight_;
+    --connection.in_flight_;
+    if (connection.metrics_ != nullptr) {
+      connection.metrics_->add(metric::in_flight, -1);
+    }
+    released_.cancel();
+  }
+
+  /// Wait until a slot has been released, try_acquire may still fail afterwards.
+  /**
+   * Completion signature void(std::error_code)
+   */
+  template <typename completion_token>
+  auto wait(completion_token&& token) {
+    // The timer never expires, release cancels it to wake up every waiter.
+    return released_.async_wait(std::forward<completion_token>(token));
+  }
+
+  /// Number of requests in flight on all connections.
+  [[nodiscard]] auto in_flight() const -> std::size_t { return in_flight_; }
+
+private:
+  asio::steady_timer released_;
+  std::size_t max_total_;
+  std::size_t max_per_connection_;
+  std::size_t in_flight_{};
+};
+
+}  // namespace modbus
@@ -0,0 +1,319 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <asio/ip/tcp.hpp>
+
+/// Least severe log level compiled in, 0 debug, 1 info, 2 warning, 3 error and 4 for no logging.
+#ifndef MODBUS_LOG_LEVEL
+#define MODBUS_LOG_LEVEL 1
+#endif
+
+namespace modbus {
+
+enum struct log_level : std::uint8_t {
+  debug,
+  info,
+  warning,
+  error,
+  off,
+};
+
+/// Records below this level are removed at compile time.
+inline constexpr log_level compiled_log_level = static_cast<log_level>(MODBUS_LOG_LEVEL);
+
+/// What a record is about, each category is rate limited on its own.
+enum struct log_category : std::uint8_t {
+  /// Connections being closed.
+  connection,
+  /// Requests that could not be read or were answered with an exception.
+  request,
+  /// Accepting and refusing connections.
+  accept,
+};
+
+inline constexpr std::size_t log_category_count = 3;
+
+/// A log record, formatted by the background thread of the logger.
+/**
+ * Records only hold values that are cheap to copy, message must outlive the logger, e.g. a string literal.
+ */
+struct log_record {
+  std::chrono::system_clock::time_point time{};
+  log_level level{};
+  log_category category{};
+  std::string_view message{};
+  asio::ip::tcp::endpoint endpoint{};
+  std::int64_t value{};
+  std::error_code error{};
+};
+
+/// Format a record as a single line without the line break.
+inline auto format(log_record const& record) -> std::string {
+  static constexpr std::array<std::string_view, 4> levels{ "debug", "info", "warning", "error" };
+  std::ostringstream line;
+  line << '[' << levels[static_cast<std::size_t>(record.level)] << "] " << record.message;
+  if (record.endpoint.port() != 0) {
+    line << " client: " << record.endpoint;
+  }
+  if (record.value != 0) {
+    line << ' ' << record.value;
+  }
+  if (record.error) {
+    line << " error: " << record.error.message();
+  }
+  return std::move(line).str();
+}
+
+/// Logging off the threads serving clients.
+/**
+ * Logging a record copies it into a ring buffer owned by the calling thread, without locks,
+ * allocations or formatting. A background thread drains the rings, formats the records and hands
+ * them to the sink. A client misbehaving in a loop therefore costs the io_context a few stores
+ * per record instead of a locked write to stderr.
+ *
+ * Each category is limited to a number of records per second, the rest are counted and reported
+ * as a single line. Records arriving while the ring of a thread is full are counted in dropped().
+ */
+class logger {
+public:
+  using sink_type = std::function<void(log_record const&, std::string_view line)>;
+
+  struct options {
+    /// Records buffered per thread, rounded up to a power of two.
+    std::size_t ring_size{ 1024 };
+    /// How often the background thread drains the rings.
+    std::chrono::milliseconds flush_interval{ 50 };
+    /// Records per category and second, zero for no limit.
+    std::uint32_t rate_limit{ 100 };
+  };
+
+  /// Write each line to stderr.
+  static void stderr_sink(log_record const&, std::string_view line) { std::cerr << line << '\n'; }
+
+  explicit logger(sink_type sink = stderr_sink) : logger{ std::move(sink), options{} } {}
+
+  logger(sink_type sink, options opts) : sink_{ std::move(sink) }, options_{ opts } {
+    options_.ring_size = std::bit_ceil(std::max<std::size_t>(options_.ring_size, 2));
+  }
+
+  logger(logger const&) = delete;
+  auto operator=(logger const&) -> logger& = delete;
+
+  ~logger() {
+    {
+      std::lock_guard lock{ mutex_ };
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    if (drain_thread_.joinable()) {
+      drain_thread_.join();
+    }
+    flush();
+  }
+
+  /// Replace the sink, it is called from the background thread.
+  void set_sink(sink_type sink) {
+    std::lock_guard lock{ drain_mutex_ };
+    sink_ = std::move(sink);
+  }
+
+  /// Records below level are discarded, in addition to the ones removed at compile time.
+  void set_level(log_level level) { level_.store(level, std::memory_order_relaxed); }
+
+  /// Queue a record for the sink.
+  template <log_level level>
+  void log(log_category category,
+           std::string_view message,
+           asio::ip::tcp::endpoint const& endpoint = {},
+           std::int64_t value = 0,
+           std::error_code error = {}) {
+    if constexpr (level >= compiled_log_level) {
+      if (level < level_.load(std::memory_order_relaxed)) {
+        return;
+      }
+      auto now = std::chrono::system_clock::now();
+      if (!admit(category, now)) {
+        return;
+      }
+      if (!local_ring().try_push(log_record{ now, level, category, message, endpoint, value, error })) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// Format and write every queued record now.
+  void flush() {
+    std::lock_guard lock{ drain_mutex_ };
+    std::vector<log_record> batch;
+    {
+      std::lock_guard rings_lock{ mutex_ };
+      for (auto const& ring : rings_) {
+        ring->drain(batch);
+      }
+    }
+    std::ranges::stable_sort(batch, {}, &log_record::time);
+    for (auto const& record : batch) {
+      sink_(record, format(record));
+    }
+    for (std::size_t category = 0; category < log_category_count; ++category) {
+      if (auto count = limits_[category].suppressed.exchange(0, std::memory_order_relaxed); count != 0) {
+        log_record summary{ std::chrono::system_clock::now(), log_level::warning, static_cast<log_category>(category),
+                            "rate limit suppressed records", {}, count, {} };
+        sink_(summary, format(summary));
+      }
+    }
+  }
+
+  /// Records lost because the ring of their thread was full.
+  [[nodiscard]] auto dropped() const -> std::size_t { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  /// Ring buffer written by a single thread and read by the draining thread.
+  class ring {
+  public:
+    ring(std::thread::id owner, std::size_t size) : owner_{ owner }, records_(size), mask_{ size - 1 } {}
+
+    auto try_push(log_record const& record) -> bool {
+      auto head = head_.load(std::memory_order_relaxed);
+      if (head - tail_.load(std::memory_order_acquire) > mask_) {
+        return false;
+      }
+      records_[head & mask_] = record;
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    void drain(std::vector<log_record>& out) {
+      auto tail = tail_.load(std::memory_order_relaxed);
+      auto head = head_.load(std::memory_order_acquire);
+      for (; tail != head; ++tail) {
+        out.push_back(records_[tail & mask_]);
+      }
+      tail_.store(tail, std::memory_order_release);
+    }
+
+    [[nodiscard]] auto owner() const -> std::thread::id { return owner_; }
+
+  private:
+    std::thread::id owner_;
+    std::vector<log_record> records_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> head_{};
+    alignas(64) std::atomic<std::size_t> tail_{};
+  };
+
+  struct limit {
+    std::atomic<std::int64_t> window{};
+    std::atomic<std::uint32_t> count{};
+    std::atomic<std::int64_t> suppressed{};
+  };
+
+  auto admit(log_category category, std::chrono::system_clock::time_point now) -> bool {
+    if (options_.rate_limit == 0) {
+      return true;
+    }
+    auto& entry = limits_[static_cast<std::size_t>(category)];
+    auto second = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    if (entry.window.exchange(second, std::memory_order_relaxed) != second) {
+      entry.count.store(0, std::memory_order_relaxed);
+    }
+    if (entry.count.fetch_add(1, std::memory_order_relaxed) >= options_.rate_limit) {
+      entry.suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  /// The ring of the calling thread, created on its first record.
+  auto local_ring() -> ring& {
+    struct cached {
+      std::uint64_t logger_id{};
+      ring* entry{};
+    };
+    thread_local cached last{};
+    if (last.logger_id == id_ && last.entry != nullptr) {
+      return *last.entry;
+    }
+    std::lock_guard lock{ mutex_ };
+    auto self = std::this_thread::get_id();
+    auto found = std::ranges::find(rings_, self, &ring::owner);
+    if (found == rings_.end()) {
+      rings_.push_back(std::make_unique<ring>(self, options_.ring_size));
+      found = std::prev(rings_.end());
+      if (!drain_thread_.joinable()) {
+        drain_thread_ = std::thread{ [this]() { run(); } };
+      }
+    }
+    last = cached{ id_, found->get() };
+    return **found;
+  }
+
+  void run() {
+    std::unique_lock lock{ mutex_ };
+    while (!stopping_) {
+      wake_.wait_for(lock, options_.flush_interval);
+      lock.unlock();
+      flush();
+      lock.lock();
+    }
+  }
+
+  static auto next_id() -> std::uint64_t {
+    static std::atomic<std::uint64_t> ids{ 1 };
+    return ids.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  sink_type sink_;
+  options options_;
+  std::uint64_t id_{ next_id() };
+  std::atomic<log_level> level_{ log_level::debug };
+  std::array<limit, log_category_count> limits_{};
+  std::atomic<std::size_t> dropped_{};
+  std::mutex mutex_;
+  std::mutex drain_mutex_;
+  std::condition_variable wake_;
+  std::vector<std::unique_ptr<ring>> rings_;
+  std::thread drain_thread_;
+  bool stopping_{ false };
+};
+
+/// The logger used by the server, writing to stderr.
+inline auto default_logger() -> logger& {
+  static logger instance;
+  return instance;
+}
+
+/// Queue a record on the default logger, removed at compile time below MODBUS_LOG_LEVEL.
+template <log_level level>
+void log(log_category category,
+         std::string_view message,
+         asio::ip::tcp::endpoint const& endpoint = {},
+         std::int64_t value = 0,
+         std::error_code error = {}) {
+  if constexpr (level >= compiled_log_level) {
+    default_logger().log<level>(category, message, endpoint, value, error);
+  }
+}
+
+}  // namespace modbus
@@ -0,0 +1,179 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace modbus {
+
+/// Counts of a latency histogram with logarithmic buckets, 8 per power of two.
+/**
+ * Values up to 8 ns have their own bucket, larger values are recorded with a relative error of
+ * at most 12.5%, the way HDR histograms trade precision for a fixed small size.
+ */
+struct histogram_snapshot {
+  static constexpr std::size_t sub_bucket_bits = 3;
+  static constexpr std::size_t sub_buckets = 1U << sub_bucket_bits;
+  static constexpr std::size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+  std::array<std::uint64_t, bucket_count> counts{};
+
+  /// The bucket of value.
+  static constexpr auto bucket(std::uint64_t value) -> std::size_t {
+    if (value < sub_buckets) {
+      return static_cast<std::size_t>(value);
+    }
+    auto msb = static_cast<std::size_t>(std::bit_width(value)) - 1;
+    auto sub = static_cast<std::size_t>(value >> (msb - sub_bucket_bits)) & (sub_buckets - 1);
+    return (msb - sub_bucket_bits + 1) * sub_buckets + sub;
+  }
+
+  /// The largest value recorded in bucket index.
+  static constexpr auto upper_bound(std::size_t index) -> std::uint64_t {
+    if (index < sub_buckets) {
+      return index;
+    }
+    auto msb = index / sub_buckets + sub_bucket_bits - 1;
+    auto sub = index % sub_buckets;
+    auto width = std::uint64_t{ 1 } << (msb - sub_bucket_bits);
+    return ((sub_buckets + sub) << (msb - sub_bucket_bits)) + width - 1;
+  }
+
+  /// Number of recorded values.
+  [[nodiscard]] auto count() const -> std::uint64_t {
+    std::uint64_t total{};
+    for (auto value : counts) {
+      total += value;
+    }
+    return total;
+  }
+
+  /// The value below which fraction of the recorded values lie, the upper bound of its bucket.
+  [[nodiscard]] auto percentile(double fraction) const -> std::chrono::nanoseconds {
+    auto total = count();
+    if (total == 0) {
+      return {};
+    }
+    auto rank = static_cast<std::uint64_t>(fraction * static_cast<double>(total - 1)) + 1;
+    std::uint64_t seen{};
+    for (std::size_t index = 0; index < bucket_count; ++index) {
+      seen += counts[index];
+      if (seen >= rank) {
+        return std::chrono::nanoseconds{ upper_bound(index) };
+      }
+    }
+    return std::chrono::nanoseconds{ upper_bound(bucket_count - 1) };
+  }
+};
+
+/// Counters that are not indexed.
+enum struct metric : std::uint8_t {
+  /// Bytes received, headers included.
+  bytes_in,
+  /// Bytes sent, headers included.
+  bytes_out,
+  /// Requests read and not yet answered, a gauge.
+  in_flight,
+  /// Connections closed for being idle.
+  timeouts,
+  /// Connections accepted by a server.
+  connections,
+  /// Connects of a client that had been connected before.
+  reconnects,
+};
+
+inline constexpr std::size_t metric_count = 6;
+
+/// Aggregated values of a metrics registry.
+struct metrics_snapshot {
+  /// Requests by function code.
+  std::array<std::uint64_t, 256> requests{};
+  /// Exception responses by exception code, errc_t.
+  std::array<std::uint64_t, 256> exceptions{};
+  /// Counters indexed by metric.
+  std::array<std::int64_t, metric_count> values{};
+  /// Time from sending a request to receiving its response, recorded by clients.
+  histogram_snapshot round_trip{};
+
+  [[nodiscard]] auto operator[](metric which) const -> std::int64_t { return values[static_cast<std::size_t>(which)]; }
+};
+
+/// Counters and latency histogram of a client or server.
+/**
+ * Every thread records into one of a fixed number of shards, each on its own cache lines, so
+ * threads serving different connections do not contend. Nothing is aggregated until snapshot()
+ * which adds up the shards and may run on any thread.
+ *
+ * Round trip times are recorded by clients, give each client its own registry for per device
+ * latencies, or share one between clients for the totals.
+ */
+class metrics {
+public:
+  /// \param shards Number of shards, threads beyond that share shards, zero for one per hardware thread.
+  explicit metrics(std::size_t shards = 0)
+      : shard_count_{ std::max<std::size_t>(shards != 0 ? shards : std::thread::hardware_concurrency(), 1) },
+        shards_{ std::make_unique<shard[]>(shard_count_) } {}
+
+  void add(metric which, std::int64_t value = 1) {
+    local().values[static_cast<std::size_t>(which)].fetch_add(value, std::memory_order_relaxed);
+  }
+
+  /// Record a request with function code function.
+  void request(std::uint8_t function) { local().requests[function].fetch_add(1, std::memory_order_relaxed); }
+
+  /// Record an exception response with exception code.
+  void exception(std::uint8_t code) { local().exceptions[code].fetch_add(1, std::memory_order_relaxed); }
+
+  /// Record the round trip time of a transaction.
+  void round_trip(std::chrono::nanoseconds elapsed) {
+    auto value = static_cast<std::uint64_t>(std::max<std::int64_t>(elapsed.count(), 0));
+    local().round_trip[histogram_snapshot::bucket(value)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// Add up the shards.
+  [[nodiscard]] auto snapshot() const -> metrics_snapshot {
+    metrics_snapshot result{};
+    for (std::size_t index = 0; index < shard_count_; ++index) {
+      auto const& counters = shards_[index];
+      for (std::size_t i = 0; i < 256; ++i) {
+        result.requests[i] += counters.requests[i].load(std::memory_order_relaxed);
+        result.exceptions[i] += counters.exceptions[i].load(std::memory_order_relaxed);
+      }
+      for (std::size_t i = 0; i < metric_count; ++i) {
+        result.values[i] += counters.values[i].load(std::memory_order_relaxed);
+      }
+      for (std::size_t i = 0; i < histogram_snapshot::bucket_count; ++i) {
+        result.round_trip.counts[i] += counters.round_trip[i].load(std::memory_order_relaxed);
+      }
+    }
+    return result;
+  }
+
+private:
+  struct alignas(64) shard {
+    std::array<std::atomic<std::int64_t>, metric_count> values{};
+    alignas(64) std::array<std::atomic<std::uint64_t>, 256> requests{};
+    std::array<std::atomic<std::uint64_t>, 256> exceptions{};
+    std::array<std::atomic<std::uint64_t>, histogram_snapshot::bucket_count> round_trip{};
+  };
+
+  /// The shard of the calling thread, threads are spread over the shards in the order they first record.
+  auto local() -> shard& {
+    static std::atomic<std::size_t> threads{};
+    thread_local std::size_t const index = threads.fetch_add(1, std::memory_order_relaxed);
+    return shards_[index % shard_count_];
+  }
+
+  std::size_t shard_count_;
+  std::unique_ptr<shard[]> shards_;
+};
+
+}  // namespace modbus
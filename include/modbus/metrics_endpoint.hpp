@@ -0,0 +1,215 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <asio/as_tuple.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/read_until.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include <modbus/impl/append_number.hpp>
+#include <modbus/logger.hpp>
+#include <modbus/metrics.hpp>
+
+namespace modbus {
+
+namespace impl {
+
+/// Series names and labels, formatted once.
+struct openmetrics_layout {
+  /// Round trip buckets at every power of two nanoseconds from about 1 us to 17 s, exact bounds of histogram_snapshot.
+  static constexpr std::size_t first_bucket_bits = 10;
+  static constexpr std::size_t last_bucket_bits = 34;
+
+  std::array<std::string, 256> requests{};
+  std::array<std::string, 256> exceptions{};
+  std::array<std::string, last_bucket_bits - first_bucket_bits + 1> round_trip{};
+
+  openmetrics_layout() {
+    for (std::size_t code = 0; code < 256; ++code) {
+      requests[code] = "modbus_requests_total{function=\"" + std::to_string(code) + "\"} ";
+      exceptions[code] = "modbus_exceptions_total{code=\"" + std::to_string(code) + "\"} ";
+    }
+    for (std::size_t bits = first_bucket_bits; bits <= last_bucket_bits; ++bits) {
+      auto& label = round_trip[bits - first_bucket_bits];
+      label = "modbus_round_trip_seconds_bucket{le=\"";
+      append_number(label, static_cast<double>(std::uint64_t{ 1 } << bits) * 1e-9);
+      label += "\"} ";
+    }
+  }
+};
+
+inline auto openmetrics_labels() -> openmetrics_layout const& {
+  static openmetrics_layout const layout;
+  return layout;
+}
+
+}  // namespace impl
+
+/// Append snapshot to out in the OpenMetrics text format, terminated by `# EOF`.
+/**
+ * Requests and exceptions are only written for the codes that have been counted.
+ */
+inline void write_openmetrics(metrics_snapshot const& snapshot, std::string& out) {
+  auto const& labels = impl::openmetrics_labels();
+  auto counter = [&out, &snapshot](std::string_view name, std::string_view help, metric which) {
+    out.append("# TYPE ").append(name).append(" counter\n# HELP ").append(name).append(" ").append(help);
+    out.append("\n").append(name).append("_total ");
+    impl::append_number(out, snapshot[which]);
+    out += '\n';
+  };
+
+  out += "# TYPE modbus_requests counter\n# HELP modbus_requests Requests by function code.\n";
+  for (std::size_t code = 0; code < 256; ++code) {
+    if (snapshot.requests[code] != 0) {
+      out += labels.requests[code];
+      impl::append_number(out, snapshot.requests[code]);
+      out += '\n';
+    }
+  }
+  out += "# TYPE modbus_exceptions counter\n# HELP modbus_exceptions Exception responses by exception code.\n";
+  for (std::size_t code = 0; code < 256; ++code) {
+    if (snapshot.exceptions[code] != 0) {
+      out += labels.exceptions[code];
+      impl::append_number(out, snapshot.exceptions[code]);
+      out += '\n';
+    }
+  }
+  counter("modbus_received_bytes", "Bytes received, headers included.", metric::bytes_in);
+  counter("modbus_sent_bytes", "Bytes sent, headers included.", metric::bytes_out);
+  out += "# TYPE modbus_in_flight gauge\n# HELP modbus_in_flight Requests read and not yet answered.\nmodbus_in_flight ";
+  impl::append_number(out, snapshot[metric::in_flight]);
+  out += '\n';
+  counter("modbus_timeouts", "Connections closed for being idle.", metric::timeouts);
+  counter("modbus_connections", "Connections accepted.", metric::connections);
+  counter("modbus_reconnects", "Client connects after the first.", metric::reconnects);
+
+  out += "# TYPE modbus_round_trip_seconds histogram\n# HELP modbus_round_trip_seconds Client transaction latency.\n";
+  std::uint64_t cumulative{};
+  std::size_t index{};
+  for (std::size_t bits = impl::openmetrics_layout::first_bucket_bits;
+       bits <= impl::openmetrics_layout::last_bucket_bits; ++bits) {
+    for (auto end = histogram_snapshot::bucket(std::uint64_t{ 1 } << bits); index < end; ++index) {
+      cumulative += snapshot.round_trip.counts[index];
+    }
+    out += labels.round_trip[bits - impl::openmetrics_layout::first_bucket_bits];
+    impl::append_number(out, cumulative);
+    out += '\n';
+  }
+  auto total = snapshot.round_trip.count();
+  out += "modbus_round_trip_seconds_bucket{le=\"+Inf\"} ";
+  impl::append_number(out, total);
+  out += "\nmodbus_round_trip_seconds_count ";
+  impl::append_number(out, total);
+  out += "\n# EOF\n";
+}
+
+/// HTTP listener serving a metrics registry in the OpenMetrics text format, for Prometheus to scrape.
+/**
+ * Answers `GET /metrics` with a snapshot taken when the request arrives, other paths with 404. Each
+ * connection serves one request and is closed, requests not complete within the request timeout are dropped.
+ *
+ * Runs on the executor of io_context next to the server. A scrape sums the shards of the registry and
+ * formats a few kilobytes, it does not wait on anything the modbus connections use.
+ */
+class metrics_endpoint {
+public:
+  static constexpr std::size_t max_request_size = 4096;
+
+  metrics_endpoint(asio::io_context& io_context,
+                   std::shared_ptr<metrics> registry,
+                   asio::ip::tcp::endpoint const& endpoint,
+                   std::chrono::steady_clock::duration request_timeout = std::chrono::seconds{ 5 })
+      : acceptor_{ io_context, endpoint }, registry_{ std::move(registry) }, request_timeout_{ request_timeout } {}
+
+  /// Listen on port of every IPv4 interface, like server.
+  metrics_endpoint(asio::io_context& io_context, std::shared_ptr<metrics> registry, int port)
+      : metrics_endpoint{ io_context, std::move(registry),
+                          asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port) } {}
+
+  void start() { asio::co_spawn(acceptor_.get_executor(), listen(), asio::detached); }
+
+  /// Stop accepting scrapes, scrapes being answered are finished.
+  void stop() {
+    asio::error_code ignored;
+    acceptor_.close(ignored);
+  }
+
+  [[nodiscard]] auto local_endpoint() const -> asio::ip::tcp::endpoint { return acceptor_.local_endpoint(); }
+
+private:
+  auto listen() -> asio::awaitable<void> {
+    for (;;) {
+      auto [error, socket] = co_await acceptor_.async_accept(asio::as_tuple(asio::use_awaitable));
+      if (!acceptor_.is_open()) {
+        co_return;
+      }
+      if (error) {
+        log<log_level::error>(log_category::accept, "metrics accept failed", {}, 0, error);
+        continue;
+      }
+      asio::co_spawn(acceptor_.get_executor(), serve(std::make_shared<asio::ip::tcp::socket>(std::move(socket))),
+                     asio::detached);
+    }
+  }
+
+  auto serve(std::shared_ptr<asio::ip::tcp::socket> client) -> asio::awaitable<void> {
+    asio::steady_timer deadline{ client->get_executor(), request_timeout_ };
+    deadline.async_wait([client](asio::error_code error) {
+      if (!error) {
+        asio::error_code ignored;
+        client->close(ignored);
+      }
+    });
+    auto& socket = *client;
+
+    std::string request;
+    auto [read_error, size] = co_await asio::async_read_until(socket, asio::dynamic_buffer(request, max_request_size),
+                                                              "\r\n\r\n", asio::as_tuple(asio::use_awaitable));
+    if (read_error) {
+      deadline.cancel();
+      co_return;
+    }
+
+    std::string_view request_line{ request.data(), request.find("\r\n") };
+    std::string response;
+    if (request_line.starts_with("GET /metrics ") || request_line.starts_with("GET /metrics?")) {
+      std::string body;
+      body.reserve(8192);
+      write_openmetrics(registry_->snapshot(), body);
+      response = "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                 "Connection: close\r\n"
+                 "Content-Length: ";
+      impl::append_number(response, body.size());
+      response += "\r\n\r\n";
+      response += body;
+    } else if (request_line.starts_with("GET ")) {
+      response = "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    } else {
+      response = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    }
+    co_await asio::async_write(socket, asio::buffer(response), asio::as_tuple(asio::use_awaitable));
+    deadline.cancel();
+    asio::error_code ignored;
+    socket.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+  }
+
+  asio::ip::tcp::acceptor acceptor_;
+  std::shared_ptr<metrics> registry_;
+  std::chrono::steady_clock::duration request_timeout_;
+};
+
+}  // namespace modbus
@@ -0,0 +1,177 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ranges>
+
+#include <modbus/error.hpp>
+
+namespace modbus {
+
+/// Access flags of a page in a paged_table.
+enum struct page_flags : std::uint8_t {
+  /// Readable and writable.
+  none = 0,
+  /// Reads are allowed, writes are answered with illegal_data_address.
+  read_only = 1U << 0U,
+  /// Neither reads nor writes are allowed, they are answered with illegal_data_address.
+  absent = 1U << 1U,
+};
+
+constexpr auto operator|(page_flags lhs, page_flags rhs) -> page_flags {
+  return static_cast<page_flags>(static_cast<std::uint8_t>(lhs) | static_cast<std::uint8_t>(rhs));
+}
+
+constexpr auto operator&(page_flags lhs, page_flags rhs) -> bool {
+  return (static_cast<std::uint8_t>(lhs) & static_cast<std::uint8_t>(rhs)) != 0;
+}
+
+/// Sparse table covering the 16 bit Modbus address space.
+/**
+ * The address space is split into pages of page_size entries which are allocated on the first
+ * write, pages that were never written read as value_t{}. A table with a few hundred scattered
+ * registers therefore costs a few pages instead of the whole address space.
+ *
+ * Each page carries page_flags, reads and writes touching an absent page or writes touching a
+ * read only page fail with illegal_data_address. Direct element access with operator[] ignores
+ * the flags and is meant for the application owning the data.
+ */
+template <typename value_t>
+class paged_table {
+public:
+  static constexpr std::size_t page_bits = 8;
+  static constexpr std::size_t page_size = 1U << page_bits;
+  static constexpr std::size_t address_space = 0x10000;
+  static constexpr std::size_t page_count = address_space / page_size;
+
+  paged_table() = default;
+  paged_table(paged_table&&) noexcept = default;
+  auto operator=(paged_table&&) noexcept -> paged_table& = default;
+
+  /// Access the entry at address, allocating its page.
+  auto operator[](std::uint16_t address) -> value_t& {
+    return page_for_write(address >> page_bits)[address % page_size];
+  }
+
+  /// Get the entry at address, value_t{} if its page has not been allocated.
+  auto operator[](std::uint16_t address) const -> value_t {
+    auto const& page = pages_[address >> page_bits];
+    return page ? (*page)[address % page_size] : value_t{};
+  }
+
+  /// Set the flags of every page overlapping [address, address + count).
+  void set_flags(std::uint16_t address, std::size_t count, page_flags flags) {
+    for_each_page(address, count, [&](std::size_t page, std::size_t, std::size_t) { flags_[page] = flags; });
+  }
+
+  /// Get the flags of the page containing address.
+  [[nodiscard]] auto flags(std::uint16_t address) const -> page_flags { return flags_[address >> page_bits]; }
+
+  /// Check that count entries starting at address can be read.
+  [[nodiscard]] auto check_read(std::uint16_t address, std::size_t count) const -> errc_t {
+    return check(address, count, page_flags::absent);
+  }
+
+  /// Check that count entries starting at address can be written.
+  [[nodiscard]] auto check_write(std::uint16_t address, std::size_t count) const -> errc_t {
+    return check(address, count, page_flags::absent | page_flags::read_only);
+  }
+
+  /// Copy count entries starting at address to out.
+  /**
+   * \return illegal_data_address if the range is out of bounds or touches an absent page, nothing is copied then.
+   */
+  template <typename output_iterator_t>
+  auto read(std::uint16_t address, std::size_t count, output_iterator_t out) const -> errc_t {
+    if (auto error = check_read(address, count)) {
+      return error;
+    }
+    for_each_page(address, count, [&](std::size_t page, std::size_t offset, std::size_t length) {
+      if (pages_[page]) {
+        out = std::copy_n(pages_[page]->begin() + offset, length, out);
+      } else {
+        out = std::fill_n(out, length, value_t{});
+      }
+    });
+    return errc::no_error;
+  }
+
+  /// Copy the entries of values to the table starting at address.
+  /**
+   * \return illegal_data_address if the range is out of bounds or touches an absent or read only page,
+   *         nothing is written then.
+   */
+  template <typename range_t>
+  auto write(std::uint16_t address, range_t const& values) -> errc_t {
+    auto count = static_cast<std::size_t>(std::ranges::distance(values));
+    if (auto error = check_write(address, count)) {
+      return error;
+    }
+    auto in = std::ranges::begin(values);
+    for_each_page(address, count, [&](std::size_t page, std::size_t offset, std::size_t length) {
+      auto& storage = page_for_write(page);
+      for (std::size_t i = 0; i < length; ++i, ++in) {
+        storage[offset + i] = *in;
+      }
+    });
+    return errc::no_error;
+  }
+
+  /// Number of allocated pages.
+  [[nodiscard]] auto allocated_pages() const -> std::size_t {
+    return static_cast<std::size_t>(std::ranges::count_if(pages_, [](auto const& page) { return page != nullptr; }));
+  }
+
+  /// The entries of page, nullptr if it has not been allocated.
+  [[nodiscard]] auto page_data(std::size_t page) const -> value_t const* {
+    return pages_[page] ? pages_[page]->data() : nullptr;
+  }
+
+  /// The entries of page, allocating it.
+  auto page_data(std::size_t page) -> value_t* { return page_for_write(page).data(); }
+
+  /// Call function(page, offset in page, length) for each page overlapping the range.
+  template <typename function_t>
+  static void for_each_page(std::uint16_t address, std::size_t count, function_t&& function) {
+    std::size_t done = 0;
+    std::size_t position = address;
+    while (done < count && position < address_space) {
+      auto offset = position % page_size;
+      auto length = std::min(count - done, page_size - offset);
+      function(position >> page_bits, offset, length);
+      done += length;
+      position += length;
+    }
+  }
+
+private:
+  using page_type = std::array<value_t, page_size>;
+
+  auto page_for_write(std::size_t page) -> page_type& {
+    if (!pages_[page]) {
+      pages_[page] = std::make_unique<page_type>();
+    }
+    return *pages_[page];
+  }
+
+  [[nodiscard]] auto check(std::uint16_t address, std::size_t count, page_flags denied) const -> errc_t {
+    if (address + count > address_space) {
+      return errc::illegal_data_address;
+    }
+    bool allowed = true;
+    for_each_page(address, count, [&](std::size_t page, std::size_t, std::size_t) {
+      allowed = allowed && !(flags_[page] & denied);
+    });
+    return allowed ? errc::no_error : errc::illegal_data_address;
+  }
+
+  std::array<std::unique_ptr<page_type>, page_count> pages_{};
+  std::array<page_flags, page_count> flags_{};
+};
+
+}  // namespace modbus
@@ -0,0 +1,161 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include <asio/bind_allocator.hpp>
+
+namespace modbus {
+
+/// Counters of a recycling_pool.
+struct recycling_stats {
+  /// Allocations served from a free list.
+  std::size_t hits{};
+
+  /// Allocations that had to go to the global allocator.
+  std::size_t misses{};
+
+  /// Blocks currently kept in the free lists.
+  std::size_t cached{};
+};
+
+/// Per thread free lists of small memory blocks.
+/**
+ * Blocks are grouped in power of two size classes from 64 up to 4096 bytes, each class keeps at most
+ * max_cached blocks. Larger or over-aligned allocations are passed straight to the global allocator.
+ * A block may be released on another thread than it was allocated on, it is then cached by that thread.
+ */
+class recycling_pool {
+public:
+  static constexpr std::size_t min_block_size = 64;
+  static constexpr std::size_t size_classes = 7;
+  static constexpr std::size_t max_block_size = min_block_size << (size_classes - 1);
+  static constexpr std::size_t max_cached = 32;
+
+  recycling_pool() = default;
+  recycling_pool(recycling_pool const&) = delete;
+  auto operator=(recycling_pool const&) -> recycling_pool& = delete;
+
+  ~recycling_pool() {
+    for (auto* head : free_) {
+      while (head != nullptr) {
+        auto* next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+    }
+  }
+
+  /// The pool of the calling thread.
+  static auto this_thread() -> recycling_pool& {
+    thread_local recycling_pool pool;
+    return pool;
+  }
+
+  [[nodiscard]] auto allocate(std::size_t size, std::size_t alignment) -> void* {
+    auto index = size_class(size, alignment);
+    if (index == size_classes) {
+      ++stats_.misses;
+      return ::operator new(size, std::align_val_t{ alignment });
+    }
+    if (auto* block = free_[index]; block != nullptr) {
+      free_[index] = block->next;
+      --count_[index];
+      --stats_.cached;
+      ++stats_.hits;
+      return block;
+    }
+    ++stats_.misses;
+    return ::operator new(min_block_size << index);
+  }
+
+  void deallocate(void* ptr, std::size_t size, std::size_t alignment) noexcept {
+    auto index = size_class(size, alignment);
+    if (index == size_classes) {
+      ::operator delete(ptr, std::align_val_t{ alignment });
+      return;
+    }
+    if (count_[index] >= max_cached) {
+      ::operator delete(ptr);
+      return;
+    }
+    auto* block = static_cast<node*>(ptr);
+    block->next = free_[index];
+    free_[index] = block;
+    ++count_[index];
+    ++stats_.cached;
+  }
+
+  /// Hit and miss counters of this pool.
+  [[nodiscard]] auto stats() const -> recycling_stats { return stats_; }
+
+private:
+  struct node {
+    node* next;
+  };
+
+  /// Get the size class of an allocation, size_classes if it can not be pooled.
+  static constexpr auto size_class(std::size_t size, std::size_t alignment) -> std::size_t {
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__ || size > max_block_size) {
+      return size_classes;
+    }
+    std::size_t index = 0;
+    while ((min_block_size << index) < size) {
+      ++index;
+    }
+    return index;
+  }
+
+  std::array<node*, size_classes> free_{};
+  std::array<std::size_t, size_classes> count_{};
+  recycling_stats stats_{};
+};
+
+/// Allocator taking memory from the recycling_pool of the calling thread.
+/**
+ * Meant to be associated with asio handlers through asio::bind_allocator so the memory of
+ * operations on the hot path is reused instead of going to the global allocator.
+ */
+template <typename value_t>
+class recycling_allocator {
+public:
+  using value_type = value_t;
+
+  recycling_allocator() = default;
+
+  template <typename other_t>
+  explicit(false) recycling_allocator(recycling_allocator<other_t> const&) noexcept {}
+
+  template <typename other_t>
+  struct rebind {
+    using other = recycling_allocator<other_t>;
+  };
+
+  [[nodiscard]] auto allocate(std::size_t count) -> value_t* {
+    return static_cast<value_t*>(recycling_pool::this_thread().allocate(count * sizeof(value_t), alignof(value_t)));
+  }
+
+  void deallocate(value_t* ptr, std::size_t count) noexcept {
+    recycling_pool::this_thread().deallocate(ptr, count * sizeof(value_t), alignof(value_t));
+  }
+
+  template <typename other_t>
+  auto operator==(recycling_allocator<other_t> const&) const noexcept -> bool {
+    return true;
+  }
+};
+
+namespace impl {
+/// Associate the recycling_allocator with a completion token or handler.
+template <typename token_t>
+auto recycled(token_t&& token) {
+  return asio::bind_allocator(recycling_allocator<void>{}, std::forward<token_t>(token));
+}
+}  // namespace impl
+
+}  // namespace modbus
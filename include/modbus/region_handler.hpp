@@ -0,0 +1,123 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <cstdint>
+
+#include <modbus/error.hpp>
+#include <modbus/region_map.hpp>
+#include <modbus/request.hpp>
+#include <modbus/response.hpp>
+
+namespace modbus {
+/// Handler answering requests from callbacks registered for address ranges.
+/**
+ * The counterpart of default_handler for data that lives elsewhere, each table is a region_map.
+ * Requests touching addresses without a region are answered with illegal_data_address.
+ */
+struct region_handler {
+  modbus::response::read_coils handle(uint8_t, const modbus::request::read_coils& req, modbus::errc_t& error) const {
+    modbus::response::read_coils resp{};
+    error = coils.read(req.address, req.count, resp.values);
+    return resp;
+  }
+
+  modbus::response::read_discrete_inputs handle(uint8_t,
+                                                const modbus::request::read_discrete_inputs& req,
+                                                modbus::errc_t& error) const {
+    modbus::response::read_discrete_inputs resp{};
+    error = desc_input.read(req.address, req.count, resp.values);
+    return resp;
+  }
+
+  modbus::response::read_holding_registers handle(uint8_t,
+                                                  const modbus::request::read_holding_registers& req,
+                                                  modbus::errc_t& error) const {
+    modbus::response::read_holding_registers resp{};
+    error = registers.read(req.address, req.count, resp.values);
+    return resp;
+  }
+
+  modbus::response::read_input_registers handle(uint8_t,
+                                                const modbus::request::read_input_registers& req,
+                                                modbus::errc_t& error) const {
+    modbus::response::read_input_registers resp{};
+    error = input_registers.read(req.address, req.count, resp.values);
+    return resp;
+  }
+
+  modbus::response::write_single_coil handle(uint8_t, const modbus::request::write_single_coil& req, modbus::errc_t& error) {
+    modbus::response::write_single_coil resp{};
+    error = coils.write(req.address, { req.value });
+    resp.address = req.address;
+    resp.value = req.value;
+    return resp;
+  }
+
+  modbus::response::write_single_register handle(uint8_t,
+                                                 const modbus::request::write_single_register& req,
+                                                 modbus::errc_t& error) {
+    modbus::response::write_single_register resp{};
+    error = registers.write(req.address, { req.value });
+    resp.address = req.address;
+    resp.value = req.value;
+    return resp;
+  }
+
+  modbus::response::write_multiple_coils handle(uint8_t,
+                                                const modbus::request::write_multiple_coils& req,
+                                                modbus::errc_t& error) {
+    modbus::response::write_multiple_coils resp{};
+    error = coils.write(req.address, req.values);
+    resp.address = req.address;
+    resp.count = static_cast<std::uint16_t>(req.values.size());
+    return resp;
+  }
+
+  modbus::response::write_multiple_registers handle(uint8_t,
+                                                    const modbus::request::write_multiple_registers& req,
+                                                    modbus::errc_t& error) {
+    modbus::response::write_multiple_registers resp{};
+    error = registers.write(req.address, req.values);
+    resp.address = req.address;
+    resp.count = static_cast<std::uint16_t>(req.values.size());
+    return resp;
+  }
+
+  modbus::response::read_write_multiple_registers handle(uint8_t,
+                                                         const modbus::request::read_write_multiple_registers& req,
+                                                         modbus::errc_t& error) {
+    modbus::response::read_write_multiple_registers resp{};
+    // The write is performed before the read, check both before changing anything.
+    error = registers.check_read(req.read_address, req.read_count);
+    if (!error) {
+      error = registers.write(req.write_address, req.values);
+    }
+    if (!error) {
+      error = registers.read(req.read_address, req.read_count, resp.values);
+    }
+    return resp;
+  }
+
+  modbus::response::mask_write_register handle(uint8_t,
+                                               const modbus::request::mask_write_register& req,
+                                               modbus::errc_t& error) {
+    modbus::response::mask_write_register resp{};
+    resp.address = req.address;
+    resp.and_mask = req.and_mask;
+    resp.or_mask = req.or_mask;
+    region_map<std::uint16_t>::values current;
+    error = registers.read(req.address, 1, current);
+    if (!error) {
+      error = registers.write(req.address, { static_cast<std::uint16_t>((current[0] & req.and_mask) |
+                                                                        (req.or_mask & ~req.and_mask)) });
+    }
+    return resp;
+  }
+
+  region_map<bool> coils;
+  region_map<bool> desc_input;
+  region_map<std::uint16_t> registers;
+  region_map<std::uint16_t> input_registers;
+};
+}  // namespace modbus
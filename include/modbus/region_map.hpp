@@ -0,0 +1,158 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <modbus/error.hpp>
+
+namespace modbus {
+
+/// Address ranges of a Modbus data table served by callbacks.
+/**
+ * Each region covers [start, end) and is backed by a read callback and optionally a write
+ * callback, e.g. live values of a PLC, computed diagnostics or configuration stored elsewhere.
+ * Regions are kept in a flat vector sorted by start address, an access finds its first region
+ * with a binary search and walks the following regions for the rest of the range.
+ *
+ * Accesses touching an address no region covers, or writing a region without a write callback,
+ * fail with illegal_data_address before any callback is called.
+ */
+template <typename value_t>
+class region_map {
+public:
+  using values = std::vector<value_t>;
+
+  /// Store count values starting at address to out, return an error to answer with an exception.
+  using read_function = std::function<errc_t(std::uint16_t address, std::size_t count, typename values::iterator out)>;
+
+  /// Apply count values starting at address from in, return an error to answer with an exception.
+  using write_function =
+      std::function<errc_t(std::uint16_t address, typename values::const_iterator in, std::size_t count)>;
+
+  /// Serve [start, end) with read and write.
+  /**
+   * \return false if the range is empty, beyond the address space or overlaps a region that was added before.
+   */
+  auto add(std::uint32_t start, std::uint32_t end, read_function read, write_function write = {}) -> bool {
+    if (start >= end || end > address_space || !read) {
+      return false;
+    }
+    auto next = std::ranges::upper_bound(regions_, start, {}, &region::start);
+    if ((next != regions_.end() && next->start < end) || (next != regions_.begin() && std::prev(next)->end > start)) {
+      return false;
+    }
+    regions_.insert(next, region{ start, end, std::move(read), std::move(write) });
+    return true;
+  }
+
+  /// Remove the region starting at start.
+  auto remove(std::uint32_t start) -> bool {
+    auto found = std::ranges::lower_bound(regions_, start, {}, &region::start);
+    if (found == regions_.end() || found->start != start) {
+      return false;
+    }
+    regions_.erase(found);
+    return true;
+  }
+
+  /// Check that count values starting at address are covered by regions.
+  [[nodiscard]] auto check_read(std::uint16_t address, std::size_t count) const -> errc_t {
+    auto [first, last] = find(address, count, false);
+    return first == last ? errc::illegal_data_address : errc::no_error;
+  }
+
+  /// Check that count values starting at address are covered by writable regions.
+  [[nodiscard]] auto check_write(std::uint16_t address, std::size_t count) const -> errc_t {
+    auto [first, last] = find(address, count, true);
+    return first == last ? errc::illegal_data_address : errc::no_error;
+  }
+
+  /// Read count values starting at address into out, replacing its contents.
+  auto read(std::uint16_t address, std::size_t count, values& out) const -> errc_t {
+    auto [first, last] = find(address, count, false);
+    if (first == last) {
+      return errc::illegal_data_address;
+    }
+    out.resize(count);
+    std::size_t done = 0;
+    for (auto current = first; current != last; ++current) {
+      auto from = std::max<std::uint32_t>(current->start, address);
+      auto length = std::min<std::size_t>(current->end - from, count - done);
+      if (auto error = current->read(static_cast<std::uint16_t>(from), length, out.begin() + done)) {
+        return error;
+      }
+      done += length;
+    }
+    return errc::no_error;
+  }
+
+  /// Write the values of in starting at address.
+  /**
+   * Regions are written in address order, a failing write callback stops the writes to the following regions.
+   */
+  auto write(std::uint16_t address, values const& in) -> errc_t {
+    auto [first, last] = find(address, in.size(), true);
+    if (first == last) {
+      return errc::illegal_data_address;
+    }
+    std::size_t done = 0;
+    for (auto current = first; current != last; ++current) {
+      auto from = std::max<std::uint32_t>(current->start, address);
+      auto length = std::min<std::size_t>(current->end - from, in.size() - done);
+      if (auto error = current->write(static_cast<std::uint16_t>(from), in.begin() + done, length)) {
+        return error;
+      }
+      done += length;
+    }
+    return errc::no_error;
+  }
+
+  /// Number of regions.
+  [[nodiscard]] auto size() const -> std::size_t { return regions_.size(); }
+
+private:
+  static constexpr std::uint32_t address_space = 0x10000;
+
+  struct region {
+    std::uint32_t start;
+    std::uint32_t end;
+    read_function read;
+    write_function write;
+  };
+
+  using iterator = typename std::vector<region>::const_iterator;
+
+  /// The regions covering [address, address + count) without gaps, an empty range if there is none.
+  auto find(std::uint16_t address, std::size_t count, bool writing) const -> std::pair<iterator, iterator> {
+    std::uint32_t const end = address + static_cast<std::uint32_t>(count);
+    auto first = std::ranges::upper_bound(regions_, address, {}, &region::start);
+    if (count == 0 || end > address_space || first == regions_.begin()) {
+      return { regions_.end(), regions_.end() };
+    }
+    --first;
+    std::uint32_t covered = address;
+    auto last = first;
+    for (; last != regions_.end() && covered < end; ++last) {
+      bool const gap = last == first ? last->end <= covered : last->start != covered;
+      if (gap || (writing && !last->write)) {
+        return { regions_.end(), regions_.end() };
+      }
+      covered = last->end;
+    }
+    if (covered < end) {
+      return { regions_.end(), regions_.end() };
+    }
+    return { first, last };
+  }
+
+  std::vector<region> regions_;
+};
+
+}  // namespace modbus
@@ -26,6 +26,8 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -68,18 +70,22 @@ struct read_coils {
   [[nodiscard]] static auto length() -> std::size_t { return 5; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_count = impl::serialize_16_array(impl::serialize_be16(count));
-    ret_value.insert(ret_value.end(), arr_count.begin(), arr_count.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), count);
+    return length();
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -109,18 +115,22 @@ struct read_discrete_inputs {
   [[nodiscard]] static auto length() -> std::size_t { return 5; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_count = impl::serialize_16_array(impl::serialize_be16(count));
-    ret_value.insert(ret_value.end(), arr_count.begin(), arr_count.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), count);
+    return length();
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -150,18 +160,22 @@ struct read_holding_registers {
   [[nodiscard]] static auto length() -> std::size_t { return 5; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_count = impl::serialize_16_array(impl::serialize_be16(count));
-    ret_value.insert(ret_value.end(), arr_count.begin(), arr_count.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), count);
+    return length();
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -191,18 +205,22 @@ struct read_input_registers {
   [[nodiscard]] static auto length() -> std::size_t { return 5; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_count = impl::serialize_16_array(impl::serialize_be16(count));
-    ret_value.insert(ret_value.end(), arr_count.begin(), arr_count.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), count);
+    return length();
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -232,18 +250,22 @@ struct write_single_coil {
   [[nodiscard]] static auto length() -> std::size_t { return 5; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_value = impl::serialize_16_array(impl::serialize_be16(impl::bool_to_uint16(value)));
-    ret_value.insert(ret_value.end(), arr_value.begin(), arr_value.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), impl::bool_to_uint16(value));
+    return length();
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -277,18 +299,22 @@ struct write_single_register {
   [[nodiscard]] static auto length() -> std::size_t { return 5; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_value = impl::serialize_16_array(impl::serialize_be16(value));
-    ret_value.insert(ret_value.end(), arr_value.begin(), arr_value.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), value);
+    return length();
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -318,18 +344,23 @@ struct write_multiple_coils {
   [[nodiscard]] auto length() const -> std::size_t { return 6 + (values.size() + 7) / 8; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_values = impl::serialize_bits_request(values);
-    ret_value.insert(ret_value.end(), arr_values.begin(), arr_values.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), static_cast<std::uint16_t>(values.size()));
+    buffer[5] = impl::serialize_be8(static_cast<std::uint8_t>((values.size() + 7) / 8));
+    return 6 + impl::write_bit_list(buffer.subspan(6), values);
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), 3)) {
@@ -340,7 +371,7 @@ struct write_multiple_coils {
     if (!expected) {
       return expected.error();
     }
-    values = expected.value();
+    values = std::move(expected.value());
     return {};
   }
 };
@@ -363,18 +394,23 @@ struct write_multiple_registers {
   [[nodiscard]] auto length() const -> std::size_t { return 6 + values.size() * 2; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_values = impl::serialize_words_request(values);
-    ret_value.insert(ret_value.end(), arr_values.begin(), arr_values.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), static_cast<std::uint16_t>(values.size()));
+    buffer[5] = impl::serialize_be8(static_cast<std::uint8_t>(values.size() * 2));
+    return 6 + impl::write_word_list(buffer.subspan(6), values);
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), 3)) {
@@ -385,7 +421,7 @@ struct write_multiple_registers {
     if (!expected) {
       return expected.error();
     }
-    values = expected.value();
+    values = std::move(expected.value());
     return {};
   }
 };
@@ -411,21 +447,23 @@ struct mask_write_register {
   [[nodiscard]] static auto length() -> std::size_t { return 7; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-
-    auto arr_and_mask = impl::serialize_16_array(impl::serialize_be16(and_mask));
-    ret_value.insert(ret_value.end(), arr_and_mask.begin(), arr_and_mask.end());
-
-    auto arr_or_mask = impl::serialize_16_array(impl::serialize_be16(or_mask));
-    ret_value.insert(ret_value.end(), arr_or_mask.begin(), arr_or_mask.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), and_mask);
+    impl::write_be16(buffer.subspan(5), or_mask);
+    return length();
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -462,24 +500,25 @@ struct read_write_multiple_registers {
   [[nodiscard]] auto length() const -> std::size_t { return 10 + values.size() * 2; }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-
-    auto read_address_arr = impl::serialize_16_array(impl::serialize_be16(read_address));
-    ret_value.insert(ret_value.end(), read_address_arr.begin(), read_address_arr.end());
-
-    auto read_count_arr = impl::serialize_16_array(impl::serialize_be16(read_count));
-    ret_value.insert(ret_value.end(), read_count_arr.begin(), read_count_arr.end());
-
-    auto write_address_arr = impl::serialize_16_array(impl::serialize_be16(write_address));
-    ret_value.insert(ret_value.end(), write_address_arr.begin(), write_address_arr.end());
-
-    auto arr_values = impl::serialize_words_request(values);
-    ret_value.insert(ret_value.end(), arr_values.begin(), arr_values.end());
-
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
 
+  /// Serialize the request into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), read_address);
+    impl::write_be16(buffer.subspan(3), read_count);
+    impl::write_be16(buffer.subspan(5), write_address);
+    impl::write_be16(buffer.subspan(7), static_cast<std::uint16_t>(values.size()));
+    buffer[9] = impl::serialize_be8(static_cast<std::uint8_t>(values.size() * 2));
+    return 10 + impl::write_word_list(buffer.subspan(10), values);
+  }
+
   /// Deserialize request.
   [[nodiscard]] auto deserialize(std::ranges::range auto data) -> std::error_code {
     if (auto error = impl::check_length(data.size(), length())) {
@@ -492,7 +531,7 @@ struct read_write_multiple_registers {
     if (!expected) {
       return expected.error();
     }
-    values = expected.value();
+    values = std::move(expected.value());
     return {};
   }
 };
@@ -25,10 +25,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <span>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include <modbus/constants.hpp>
 #include <modbus/functions.hpp>
 #include <modbus/impl/serialize_base.hpp>
 
@@ -46,6 +53,47 @@ struct mask_write_register;
 struct read_write_multiple_registers;
 }  // namespace request
 
+/// A serialized PDU of at most modbus_max_pdu bytes, held inline so filling or copying one does not allocate.
+class pdu_buffer {
+public:
+  static constexpr std::size_t capacity = modbus_max_pdu;
+
+  pdu_buffer() = default;
+
+  /// Copy bytes, which must not be longer than capacity.
+  explicit pdu_buffer(std::span<uint8_t const> bytes) { assign(bytes); }
+
+  /// Replace the contents with bytes, which must not be longer than capacity.
+  void assign(std::span<uint8_t const> bytes) {
+    assert(bytes.size() <= capacity && "PDU too large");
+    size_ = std::min(bytes.size(), capacity);
+    std::copy_n(bytes.begin(), size_, bytes_.begin());
+  }
+
+  /// Change the size, bytes past the previous size are left as they were.
+  void resize(std::size_t size) {
+    assert(size <= capacity && "PDU too large");
+    size_ = std::min(size, capacity);
+  }
+
+  [[nodiscard]] auto data() -> uint8_t* { return bytes_.data(); }
+  [[nodiscard]] auto data() const -> uint8_t const* { return bytes_.data(); }
+  [[nodiscard]] auto size() const -> std::size_t { return size_; }
+  [[nodiscard]] auto empty() const -> bool { return size_ == 0; }
+  [[nodiscard]] auto begin() -> uint8_t* { return bytes_.data(); }
+  [[nodiscard]] auto begin() const -> uint8_t const* { return bytes_.data(); }
+  [[nodiscard]] auto end() -> uint8_t* { return bytes_.data() + size_; }
+  [[nodiscard]] auto end() const -> uint8_t const* { return bytes_.data() + size_; }
+  auto operator[](std::size_t index) -> uint8_t& { return bytes_[index]; }
+  auto operator[](std::size_t index) const -> uint8_t { return bytes_[index]; }
+
+  friend auto operator==(pdu_buffer const& lhs, pdu_buffer const& rhs) -> bool { return std::ranges::equal(lhs, rhs); }
+
+private:
+  std::array<uint8_t, capacity> bytes_{};
+  std::size_t size_{};
+};
+
 namespace response {
 
 /// Message representing a read_coils response.
@@ -67,17 +115,25 @@ struct read_coils {
     if (!ex_values) {
       return ex_values.error();
     }
-    values = ex_values.value();
+    values = std::move(ex_values.value());
     return {};
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto bit_response = impl::serialize_bits_response(values);
-    ret_value.insert(ret_value.end(), bit_response.begin(), bit_response.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    buffer[1] = impl::serialize_be8(static_cast<std::uint8_t>((values.size() + 7) / 8));
+    return 2 + impl::write_bit_list(buffer.subspan(2), values);
+  }
 };
 
 /// Message representing a read_discrete_inputs response.
@@ -99,17 +155,25 @@ struct read_discrete_inputs {
     if (!ex_values) {
       return ex_values.error();
     }
-    values = ex_values.value();
+    values = std::move(ex_values.value());
     return {};
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto bit_response = impl::serialize_bits_response(values);
-    ret_value.insert(ret_value.end(), bit_response.begin(), bit_response.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    buffer[1] = impl::serialize_be8(static_cast<std::uint8_t>((values.size() + 7) / 8));
+    return 2 + impl::write_bit_list(buffer.subspan(2), values);
+  }
 };
 
 /// Message representing a read_holding_registers response.
@@ -131,17 +195,25 @@ struct read_holding_registers {
     if (!ex_values) {
       return ex_values.error();
     }
-    values = ex_values.value();
+    values = std::move(ex_values.value());
     return {};
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto word_response = impl::serialize_words_response(values);
-    ret_value.insert(ret_value.end(), word_response.begin(), word_response.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    buffer[1] = impl::serialize_be8(static_cast<std::uint8_t>(values.size() * 2));
+    return 2 + impl::write_word_list(buffer.subspan(2), values);
+  }
 };
 
 /// Message representing a read_input_registers response.
@@ -163,17 +235,25 @@ struct read_input_registers {
     if (!ex_values) {
       return ex_values.error();
     }
-    values = ex_values.value();
+    values = std::move(ex_values.value());
     return {};
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto word_response = impl::serialize_words_response(values);
-    ret_value.insert(ret_value.end(), word_response.begin(), word_response.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    buffer[1] = impl::serialize_be8(static_cast<std::uint8_t>(values.size() * 2));
+    return 2 + impl::write_word_list(buffer.subspan(2), values);
+  }
 };
 
 /// Message representing a write_single_coil response.
@@ -205,14 +285,21 @@ struct write_single_coil {
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-    auto arr_value = impl::serialize_16_array(impl::serialize_be16(impl::bool_to_uint16(value)));
-    ret_value.insert(ret_value.end(), arr_value.begin(), arr_value.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), impl::bool_to_uint16(value));
+    return length();
+  }
 };
 
 /// Message representing a write_single_register response.
@@ -239,14 +326,21 @@ struct write_single_register {
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-    auto arr_value = impl::serialize_16_array(impl::serialize_be16(value));
-    ret_value.insert(ret_value.end(), arr_value.begin(), arr_value.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), value);
+    return length();
+  }
 };
 
 /// Message representing a write_multiple_coil response.
@@ -273,14 +367,21 @@ struct write_multiple_coils {
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-    auto arr_count = impl::serialize_16_array(impl::serialize_be16(count));
-    ret_value.insert(ret_value.end(), arr_count.begin(), arr_count.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), count);
+    return length();
+  }
 };
 
 /// Message representing a write_multiple_registers response.
@@ -307,14 +408,21 @@ struct write_multiple_registers {
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-    auto arr_count = impl::serialize_16_array(impl::serialize_be16(count));
-    ret_value.insert(ret_value.end(), arr_count.begin(), arr_count.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), count);
+    return length();
+  }
 };
 
 /// Message representing a mask_write_register response.
@@ -345,16 +453,22 @@ struct mask_write_register {
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto arr_address = impl::serialize_16_array(impl::serialize_be16(address));
-    ret_value.insert(ret_value.end(), arr_address.begin(), arr_address.end());
-    auto arr_and_mask = impl::serialize_16_array(impl::serialize_be16(and_mask));
-    ret_value.insert(ret_value.end(), arr_and_mask.begin(), arr_and_mask.end());
-    auto arr_or_mask = impl::serialize_16_array(impl::serialize_be16(or_mask));
-    ret_value.insert(ret_value.end(), arr_or_mask.begin(), arr_or_mask.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    impl::write_be16(buffer.subspan(1), address);
+    impl::write_be16(buffer.subspan(3), and_mask);
+    impl::write_be16(buffer.subspan(5), or_mask);
+    return length();
+  }
 };
 
 /// Message representing a read_write_multiple_registers response.
@@ -376,17 +490,25 @@ struct read_write_multiple_registers {
     if (!ex_values) {
       return ex_values.error();
     }
-    values = ex_values.value();
+    values = std::move(ex_values.value());
     return {};
   }
 
   [[nodiscard]] auto serialize() const -> std::vector<uint8_t> {
-    std::vector<uint8_t> ret_value;
-    ret_value.emplace_back(impl::serialize_function(function));
-    auto word_response = impl::serialize_words_response(values);
-    ret_value.insert(ret_value.end(), word_response.begin(), word_response.end());
+    std::vector<uint8_t> ret_value(length());
+    serialize(ret_value);
     return ret_value;
   }
+
+  /// Serialize the response into buffer, which must hold at least length() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    buffer[0] = impl::serialize_function(function);
+    buffer[1] = impl::serialize_be8(static_cast<std::uint8_t>(values.size() * 2));
+    return 2 + impl::write_word_list(buffer.subspan(2), values);
+  }
 };
 
 using responses = std::variant<mask_write_register,
@@ -399,5 +521,34 @@ using responses = std::variant<mask_write_register,
                                write_single_coil,
                                write_single_register,
                                read_write_multiple_registers>;
+
+/// A response of type response_t that has already been serialized.
+/**
+ * Handlers keeping their data in wire order return this to skip decoding into response_t and
+ * encoding it again, the server sends pdu as it is. The PDU is held inline, so returning an
+ * encoded response does not allocate.
+ */
+template <typename response_t>
+struct encoded {
+  /// Request type.
+  using request = typename response_t::request;
+
+  /// The function code.
+  static constexpr function_e function = response_t::function;
+
+  /// The serialized PDU, starting with the function code.
+  pdu_buffer pdu;
+
+  [[nodiscard]] auto serialize() const -> std::vector<uint8_t> { return { pdu.begin(), pdu.end() }; }
+
+  /// Copy the PDU into buffer, which must hold at least pdu.size() bytes.
+  /**
+   * \return The number of bytes written.
+   */
+  auto serialize(std::span<uint8_t> buffer) const -> std::size_t {
+    std::ranges::copy(pdu, buffer.begin());
+    return pdu.size();
+  }
+};
 }  // namespace response
 }  // namespace modbus
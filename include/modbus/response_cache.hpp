@@ -0,0 +1,171 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <modbus/error.hpp>
+#include <modbus/functions.hpp>
+#include <modbus/request.hpp>
+#include <modbus/server.hpp>
+
+namespace modbus {
+
+/// Server handler answering repeated reads of the same range from a cache of encoded responses.
+/**
+ * Clients polling identical ranges get the response encoded for the first of them until the range
+ * changes. Entries are keyed by unit, function code, address and count. Writes passing through the
+ * cache drop the entries of the overlapping ranges of every unit. Handlers keeping separate data per
+ * unit declare `static constexpr bool separate_units = true`, their writes only drop the entries of
+ * the unit written to, writes to unit 0 still drop those of every unit.
+ *
+ * Data the application changes directly is not seen by the cache. If handler_t has
+ * `std::uint64_t version() const` entries encoded under another version are misses, otherwise
+ * call invalidate after such changes.
+ *
+ * Not thread safe, the cache is used from the executor of the server.
+ */
+template <typename handler_t>
+class response_cache {
+public:
+  /// \param max_entries Number of responses kept, the cache is emptied when it is full.
+  explicit response_cache(std::shared_ptr<handler_t> handler, std::size_t max_entries = 1024)
+      : handler_{ std::move(handler) }, max_entries_{ max_entries } {
+    entries_.reserve(max_entries_);
+  }
+
+  template <typename request_t>
+    requires impl::sync_handler_for<handler_t, request_t>
+  auto handle(std::uint8_t unit, request_t const& request, errc_t& error) {
+    if constexpr (is_cached<request_t>) {
+      auto key = make_key(unit, request_t::function, request.address, request.count);
+      auto current = version();
+      if (auto found = entries_.find(key); found != entries_.end() && found->second.version == current) {
+        ++hits_;
+        // Copied into the inline buffer of the response, a hit does not allocate.
+        return response::encoded<typename request_t::response>{ pdu_buffer{ found->second.pdu } };
+      }
+      ++misses_;
+      response::encoded<typename request_t::response> resp{};
+      auto decoded = handler_->handle(unit, request, error);
+      if (error) {
+        return resp;
+      }
+      auto pdu = impl::serialize_any_response(std::move(decoded));
+      if (pdu.size() > pdu_buffer::capacity) {
+        error = errc::illegal_data_value;
+        return resp;
+      }
+      resp.pdu.assign(pdu);
+      if (entries_.size() >= max_entries_) {
+        entries_.clear();
+      }
+      entries_.insert_or_assign(key, entry{ std::move(pdu), current });
+      return resp;
+    } else {
+      auto resp = handler_->handle(unit, request, error);
+      if (!error) {
+        invalidate_written(unit, request);
+      }
+      return resp;
+    }
+  }
+
+  /// Whether requests to unit are answered, as decided by handler_t.
+  [[nodiscard]] auto responds(std::uint8_t unit) const -> bool { return impl::responds(*handler_, unit); }
+
+  /// Drop the cached reads of function overlapping [address, address + count) on unit, every unit for unit 0.
+  void invalidate(std::uint8_t unit, function_e function, std::uint16_t address, std::size_t count) {
+    std::erase_if(entries_, [&](auto const& cached) {
+      auto [entry_unit, entry_function, entry_address, entry_count] = split_key(cached.first);
+      return (unit == 0 || entry_unit == unit) && entry_function == function && entry_address < address + count &&
+             address < entry_address + entry_count;
+    });
+  }
+
+  /// Drop every cached response.
+  void invalidate() { entries_.clear(); }
+
+  /// The wrapped handler.
+  [[nodiscard]] auto handler() const -> std::shared_ptr<handler_t> const& { return handler_; }
+
+  /// Requests answered from the cache.
+  [[nodiscard]] auto hits() const -> std::size_t { return hits_; }
+
+  /// Cacheable requests the handler had to answer.
+  [[nodiscard]] auto misses() const -> std::size_t { return misses_; }
+
+  /// Number of cached responses.
+  [[nodiscard]] auto size() const -> std::size_t { return entries_.size(); }
+
+private:
+  /// Whether a write to one unit leaves what the other units read unchanged.
+  static constexpr bool separate_units = requires {
+    requires handler_t::separate_units;
+  };
+
+  /// Plain reads, their response only depends on the range.
+  template <typename request_t>
+  static constexpr bool is_cached = request_t::function == function_e::read_coils ||
+                                    request_t::function == function_e::read_discrete_inputs ||
+                                    request_t::function == function_e::read_holding_registers ||
+                                    request_t::function == function_e::read_input_registers;
+
+  struct entry {
+    std::vector<std::uint8_t> pdu;
+    std::uint64_t version;
+  };
+
+  static auto make_key(std::uint8_t unit, function_e function, std::uint16_t address, std::uint16_t count)
+      -> std::uint64_t {
+    return (std::uint64_t{ unit } << 40U) | (std::uint64_t{ static_cast<std::uint8_t>(function) } << 32U) |
+           (std::uint64_t{ address } << 16U) | count;
+  }
+
+  static auto split_key(std::uint64_t key) -> std::tuple<std::uint8_t, function_e, std::size_t, std::size_t> {
+    return { static_cast<std::uint8_t>(key >> 40U), static_cast<function_e>((key >> 32U) & 0xffU),
+             (key >> 16U) & 0xffffU, key & 0xffffU };
+  }
+
+  [[nodiscard]] auto version() const -> std::uint64_t {
+    if constexpr (requires { handler_->version(); }) {
+      return handler_->version();
+    } else {
+      return 0;
+    }
+  }
+
+  template <typename request_t>
+  void invalidate_written(std::uint8_t written_unit, request_t const& request) {
+    std::uint8_t const unit = separate_units ? written_unit : 0;
+    if constexpr (request_t::function == function_e::write_single_coil) {
+      invalidate(unit, function_e::read_coils, request.address, 1);
+    } else if constexpr (request_t::function == function_e::write_multiple_coils) {
+      invalidate(unit, function_e::read_coils, request.address, request.values.size());
+    } else if constexpr (request_t::function == function_e::write_single_register ||
+                         request_t::function == function_e::mask_write_register) {
+      invalidate(unit, function_e::read_holding_registers, request.address, 1);
+    } else if constexpr (request_t::function == function_e::write_multiple_registers) {
+      invalidate(unit, function_e::read_holding_registers, request.address, request.values.size());
+    } else if constexpr (request_t::function == function_e::read_write_multiple_registers) {
+      invalidate(unit, function_e::read_holding_registers, request.write_address, request.values.size());
+    } else {
+      // Requests the cache does not know about may change anything.
+      invalidate();
+    }
+  }
+
+  std::shared_ptr<handler_t> handler_;
+  std::size_t max_entries_;
+  std::unordered_map<std::uint64_t, entry> entries_;
+  std::size_t hits_{};
+  std::size_t misses_{};
+};
+
+}  // namespace modbus
@@ -0,0 +1,109 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <span>
+
+#include <modbus/impl/deserialize_base.hpp>
+
+namespace modbus {
+
+/// Borrowed view of a list of 16 bit words inside a received Modbus frame.
+/**
+ * The words are kept in wire (big endian) order and are converted on access.
+ * A view never owns its memory, it is only valid as long as the buffer it was created from.
+ */
+class words_view {
+public:
+  words_view() = default;
+
+  /// Construct a view over big endian encoded words.
+  explicit words_view(std::span<std::uint8_t const> data) : data_{ data } {}
+
+  /// Number of words in the view.
+  [[nodiscard]] auto size() const -> std::size_t { return data_.size() / 2; }
+
+  /// Check if the view contains no words.
+  [[nodiscard]] auto empty() const -> bool { return size() == 0; }
+
+  /// Get the word at index in host byte order.
+  [[nodiscard]] auto operator[](std::size_t index) const -> std::uint16_t {
+    return impl::deserialize_be16(data_.subspan(index * 2, 2));
+  }
+
+  /// The raw big endian bytes of the view.
+  [[nodiscard]] auto bytes() const -> std::span<std::uint8_t const> { return data_; }
+
+  /// Copy the words in host byte order to out.
+  /**
+   * \return The number of words copied.
+   */
+  auto copy_to(std::span<std::uint16_t> out) const -> std::size_t {
+    auto count = std::min(out.size(), size());
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = (*this)[i];
+    }
+    return count;
+  }
+
+private:
+  std::span<std::uint8_t const> data_;
+};
+
+/// Borrowed view of a packed list of bits inside a received Modbus frame.
+/**
+ * A view never owns its memory, it is only valid as long as the buffer it was created from.
+ */
+class bits_view {
+public:
+  bits_view() = default;
+
+  /// Construct a view over count bits packed least significant bit first.
+  bits_view(std::span<std::uint8_t const> data, std::size_t count) : data_{ data }, count_{ count } {}
+
+  /// Number of bits in the view.
+  [[nodiscard]] auto size() const -> std::size_t { return count_; }
+
+  /// Check if the view contains no bits.
+  [[nodiscard]] auto empty() const -> bool { return count_ == 0; }
+
+  /// Get the bit at index.
+  [[nodiscard]] auto operator[](std::size_t index) const -> bool { return ((data_[index / 8] >> (index % 8)) & 1U) != 0; }
+
+  /// The raw packed bytes of the view.
+  [[nodiscard]] auto bytes() const -> std::span<std::uint8_t const> { return data_; }
+
+  /// Copy the bits to out.
+  /**
+   * \return The number of bits copied.
+   */
+  template <std::size_t bit_count>
+  auto copy_to(std::bitset<bit_count>& out) const -> std::size_t {
+    auto count = std::min(bit_count, size());
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = (*this)[i];
+    }
+    return count;
+  }
+
+  /// Copy the bits to out.
+  /**
+   * \return The number of bits copied.
+   */
+  auto copy_to(std::span<bool> out) const -> std::size_t {
+    auto count = std::min(out.size(), size());
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = (*this)[i];
+    }
+    return count;
+  }
+
+private:
+  std::span<std::uint8_t const> data_;
+  std::size_t count_{};
+};
+
+}  // namespace modbus
@@ -1,21 +1,40 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <concepts>
 #include <expected>
-#include <iostream>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include <asio/as_tuple.hpp>
-#include <asio/experimental/awaitable_operators.hpp>
+#include <asio/read.hpp>
+#include <asio/write.hpp>
 
+#include <modbus/buffer_pool.hpp>
+#include <modbus/capture.hpp>
+#include <modbus/connection_registry.hpp>
 #include <modbus/error.hpp>
 #include <modbus/functions.hpp>
 #include <modbus/impl/deserialize.hpp>
+#include <modbus/impl/dispatch.hpp>
 #include <modbus/impl/serialize.hpp>
+#include <modbus/in_flight_limiter.hpp>
+#include <modbus/logger.hpp>
+#include <modbus/metrics.hpp>
+#include <modbus/recycling_allocator.hpp>
 #include <modbus/request.hpp>
 #include <modbus/response.hpp>
 #include <modbus/tcp.hpp>
+#include <modbus/timer_wheel.hpp>
+#include <modbus/tracing.hpp>
 
 namespace modbus {
 
@@ -28,45 +47,245 @@ using ip::tcp;
 using std::chrono::steady_clock;
 using std::chrono_literals::operator""s;
 using std::chrono_literals::operator""min;
-using asio::experimental::awaitable_operators::operator||;
 
-auto handle_request(tcp_mbap const& header, std::ranges::range auto data, auto&& handler)
-    -> std::expected<std::vector<uint8_t>, modbus::errc_t> {
-  auto req_variant = impl::deserialize_request(std::span(data), static_cast<function_e>(data[0]));
-  if (!req_variant) {
-    return std::unexpected(modbus::errc_t::illegal_data_value);
-  }
-  auto req = req_variant.value();
-
-  auto resp = std::visit(
-      [&](auto& request) -> std::expected<std::vector<uint8_t>, modbus::errc_t> {
-        modbus::errc_t error = modbus::errc_t::no_error;
-        response::responses resp = handler->handle(header.unit, request, error);
-        if (error) {
-          return std::unexpected(error);
-        }
-        return impl::serialize_response(resp);
-      },
-      req);
+namespace impl {
+template <typename>
+inline constexpr bool is_awaitable = false;
 
-  if (!resp) {
-    return std::unexpected(resp.error());
+template <typename value_t>
+inline constexpr bool is_awaitable<awaitable<value_t>> = true;
+
+template <typename>
+inline constexpr bool is_encoded = false;
+
+template <typename response_t>
+inline constexpr bool is_encoded<response::encoded<response_t>> = true;
+
+/// A response the server can send, a response type, a variant of them or an already encoded response.
+template <typename response_t>
+concept server_response = std::convertible_to<response_t, response::responses> || is_encoded<response_t>;
+
+/// Handler answering request_t with a response, reporting errors through the error argument.
+template <typename handler_t, typename request_t>
+concept sync_handler_for = requires(handler_t& handler, std::uint8_t unit, request_t const& request, errc_t& error) {
+  { handler.handle(unit, request, error) } -> server_response;
+};
+
+/// Synchronous handler that can also encode the response PDU straight into the frame of the server.
+/**
+ * `std::size_t handle(std::uint8_t unit, request const&, std::span<uint8_t> pdu, errc_t& error)` writes the
+ * response PDU into pdu and returns its size, or reports illegal_data_value if it does not fit.
+ */
+template <typename handler_t, typename request_t>
+concept encoding_handler_for =
+    sync_handler_for<handler_t, request_t> &&
+    requires(handler_t& handler, std::uint8_t unit, request_t const& request, std::span<uint8_t> pdu, errc_t& error) {
+      { handler.handle(unit, request, pdu, error) } -> std::same_as<std::size_t>;
+    };
+
+/// Handler returning an awaitable response, reporting errors through the error argument.
+template <typename handler_t, typename request_t>
+concept awaitable_handler_for = requires(handler_t& handler, std::uint8_t unit, request_t const& request, errc_t& error) {
+  requires is_awaitable<decltype(handler.handle(unit, request, error))>;
+};
+
+/// Handler taking a completion token, completing with void(std::expected<response, errc_t>).
+template <typename handler_t, typename request_t>
+concept token_handler_for = requires(handler_t& handler, std::uint8_t unit, request_t const& request) {
+  handler.handle(unit, request, use_awaitable);
+};
+
+/// Serialize a response, or a response variant returned from a handler.
+template <typename response_t>
+auto serialize_any_response(response_t&& resp) -> std::vector<uint8_t> {
+  if constexpr (requires { std::forward<response_t>(resp).serialize(); }) {
+    return std::forward<response_t>(resp).serialize();
+  } else {
+    return serialize_response(resp);
+  }
+}
+
+/// Answer a request with a synchronous handler.
+template <typename handler_t, typename request_t>
+  requires sync_handler_for<handler_t, request_t>
+auto handle_sync(handler_t& handler, std::uint8_t unit, request_t const& request)
+    -> std::expected<std::vector<uint8_t>, errc_t> {
+  errc_t error = errc_t::no_error;
+  auto resp = handler.handle(unit, request, error);
+  if (error) {
+    return std::unexpected(error);
   }
-  return resp.value();
+  return serialize_any_response(std::move(resp));
 }
 
-struct connection_state {
-  explicit connection_state(tcp::socket&& client) : client_(std::move(client)) {}
+/// Serialize a response, or a response variant returned from a handler, into buffer.
+/**
+ * \return The number of bytes written, or illegal_data_value if the response does not fit into buffer.
+ */
+template <typename response_t>
+auto encode_any_response(response_t const& resp, std::span<uint8_t> buffer) -> std::expected<std::size_t, errc_t> {
+  if constexpr (is_encoded<response_t>) {
+    if (resp.pdu.size() > buffer.size()) {
+      return std::unexpected(errc_t::illegal_data_value);
+    }
+    return resp.serialize(buffer);
+  } else if constexpr (requires { resp.serialize(buffer); }) {
+    if (resp.length() > buffer.size()) {
+      return std::unexpected(errc_t::illegal_data_value);
+    }
+    return resp.serialize(buffer);
+  } else {
+    response::responses const& variant = resp;
+    return std::visit([buffer](auto const& alternative) { return encode_any_response(alternative, buffer); }, variant);
+  }
+}
+
+/// Answer a request with a synchronous handler, encoding the response PDU into buffer.
+/**
+ * buffer may hold the request, it is only written once the request has been decoded.
+ * Handlers satisfying encoding_handler_for write their response into buffer themselves.
+ *
+ * \return The size of the response PDU.
+ */
+template <typename handler_t, typename request_t>
+  requires sync_handler_for<handler_t, request_t>
+auto handle_sync(handler_t& handler, std::uint8_t unit, request_t const& request, std::span<uint8_t> buffer)
+    -> std::expected<std::size_t, errc_t> {
+  errc_t error = errc_t::no_error;
+  if constexpr (encoding_handler_for<handler_t, request_t>) {
+    auto size = handler.handle(unit, request, buffer, error);
+    if (error) {
+      return std::unexpected(error);
+    }
+    return size;
+  } else {
+    auto resp = handler.handle(unit, request, error);
+    if (error) {
+      return std::unexpected(error);
+    }
+    return encode_any_response(resp, buffer);
+  }
+}
 
-  tcp::socket client_;
+/// Answer a request with an asynchronous handler.
+template <typename handler_t, typename request_t>
+auto handle_async(handler_t& handler, std::uint8_t unit, request_t const& request)
+    -> awaitable<std::expected<std::vector<uint8_t>, errc_t>> {
+  if constexpr (awaitable_handler_for<handler_t, request_t>) {
+    errc_t error = errc_t::no_error;
+    auto resp = co_await handler.handle(unit, request, error);
+    if (error) {
+      co_return std::unexpected(error);
+    }
+    co_return serialize_any_response(std::move(resp));
+  } else {
+    auto resp = co_await handler.handle(unit, request, use_awaitable);
+    if (!resp) {
+      co_return std::unexpected(resp.error());
+    }
+    co_return serialize_any_response(std::move(resp.value()));
+  }
+}
+
+/// Decodes, handles and encodes a single request type with a synchronous handler.
+template <typename handler_t>
+struct sync_dispatcher {
+  using function_type = auto (*)(handler_t&, std::uint8_t, std::span<uint8_t const>)
+      -> std::expected<std::vector<uint8_t>, errc_t>;
+
+  template <typename request_t>
+  static constexpr bool supports = sync_handler_for<handler_t, request_t>;
+
+  template <typename request_t>
+  static auto call(handler_t& handler, std::uint8_t unit, std::span<uint8_t const> pdu)
+      -> std::expected<std::vector<uint8_t>, errc_t> {
+    request_t request{};
+    if (request.deserialize(pdu)) {
+      return std::unexpected(errc_t::illegal_data_value);
+    }
+    return handle_sync(handler, unit, request);
+  }
 };
 
-auto timeout(steady_clock::duration dur) -> awaitable<void> {
-  steady_timer timer(co_await asio::this_coro::executor);
-  timer.expires_after(dur);
-  co_await timer.async_wait(use_awaitable);
+/// Build the PDU of an exception response.
+inline auto error_pdu(std::uint8_t function, errc_t error) -> std::array<uint8_t, 2> {
+  return { static_cast<uint8_t>(function | 0x80), static_cast<uint8_t>(error) };
 }
 
+/// Whether requests to unit are answered, handlers opt out with `bool responds(std::uint8_t unit) const`.
+template <typename handler_t>
+auto responds(handler_t const& handler, std::uint8_t unit) -> bool {
+  if constexpr (requires { { handler.responds(unit) } -> std::convertible_to<bool>; }) {
+    return handler.responds(unit);
+  } else {
+    return true;
+  }
+}
+}  // namespace impl
+
+/// Answer a request with a synchronous handler.
+/**
+ * Function codes the handler has no handle overload for are answered with illegal_function.
+ *
+ * \param data PDU of the request, starting with the function code.
+ */
+auto handle_request(tcp_mbap const& header, std::ranges::range auto data, auto&& handler)
+    -> std::expected<std::vector<uint8_t>, modbus::errc_t> {
+  using handler_t = std::remove_cvref_t<decltype(*handler)>;
+  std::span<uint8_t const> pdu{ std::ranges::data(data), std::ranges::size(data) };
+  if (pdu.empty()) {
+    return std::unexpected(modbus::errc_t::illegal_function);
+  }
+  auto entry = impl::dispatch_table<impl::sync_dispatcher<handler_t>>[pdu[0]];
+  if (entry == nullptr) {
+    return std::unexpected(modbus::errc_t::illegal_function);
+  }
+  return entry(*handler, header.unit, pdu);
+}
+
+/// Server configuration.
+struct server_options {
+  /// Close connections that have not sent a request for this long, zero disables the idle timeout.
+  steady_clock::duration idle_timeout{ 60s };
+
+  /// Granularity of the idle timeout.
+  /**
+   * Idle connections are closed between idle_timeout and idle_timeout + timer_resolution.
+   */
+  steady_clock::duration timer_resolution{ 1s };
+
+  /// Maximum number of open connections, zero for no limit.
+  /**
+   * When the limit is reached the least recently active connection that is not handling a request
+   * is closed to make room, if every connection is busy the new connection is refused.
+   */
+  std::size_t max_connections{ 0 };
+
+  /// Keep neither a coroutine nor a frame buffer for connections waiting for their next request.
+  /**
+   * A parked connection only holds its state and a readiness wait on the socket, the coroutine
+   * and a buffer from the shared pool are taken when a request arrives. This keeps the memory of
+   * many mostly idle clients low at the cost of an extra readiness wait per request.
+   */
+  bool park_idle_connections{ true };
+
+  /// Maximum number of requests read and not yet answered on a single connection, zero for no limit.
+  /**
+   * Requests of asynchronous handlers are processed concurrently up to this bound, their responses
+   * are written in the order they complete.
+   */
+  std::size_t max_in_flight_per_connection{ 16 };
+
+  /// Maximum number of requests read and not yet answered on all connections, zero for no limit.
+  std::size_t max_in_flight{ 1024 };
+
+  /// Where requests, exceptions, bytes, in flight requests, timeouts and connections are counted, if set.
+  std::shared_ptr<modbus::metrics> metrics{};
+
+  /// Where every request read and response written is recorded, if set.
+  std::shared_ptr<capture_log> capture{};
+};
+
 auto build_error_buffer(tcp_mbap req_header, uint8_t function, errc::errc_t error) -> std::array<uint8_t, 9> {
   std::array<uint8_t, 9> error_buffer{};
   tcp_mbap* header = std::launder(reinterpret_cast<tcp_mbap*>(error_buffer.data()));
@@ -78,95 +297,511 @@ auto build_error_buffer(tcp_mbap req_header, uint8_t function, errc::errc_t erro
   return error_buffer;
 }
 
-auto handle_connection(tcp::socket client, auto&& handler) -> awaitable<void> {
-  auto state = std::make_shared<connection_state>(std::move(client));
-  std::array<uint8_t, 7> header_buffer{};
-  std::array<uint8_t, 1024> request_buffer{};
-  for (;;) {
-    auto result = co_await (
-        state->client_.async_read_some(asio::buffer(header_buffer, tcp_mbap::size), asio::as_tuple(asio::use_awaitable)) ||
-        timeout(60s));
-    if (result.index() == 1) {
-      // Timeout
-      std::cerr << "timeout client: " << state->client_.remote_endpoint() << " Disconnecting!" << '\n';
-      break;
-    }
-    auto [ec, count] = std::get<0>(result);
-    if (ec) {
-      std::cerr << "error client: " << state->client_.remote_endpoint() << " Disconnecting!" << '\n';
-      break;
-    }
-    if (count < tcp_mbap::size) {
-      std::cerr << "packet size to small for header " << count << " " << state->client_.remote_endpoint()
-                << " Disconnecting!" << std::endl;
-      break;
-    }
-    // Deserialize the request
-    auto header = tcp_mbap::from_bytes(header_buffer);
-
-    if (header.length < 2) {
-      co_await async_write(state->client_, asio::buffer(build_error_buffer(header, 0, errc::illegal_function), count),
-                           use_awaitable);
-      continue;
-    }
-
-    // Read the request body
-    auto [request_ec, request_count] = co_await state->client_.async_read_some(
-        asio::buffer(request_buffer, header.length - 1), asio::as_tuple(asio::use_awaitable));
-    if (request_ec) {
-      std::cerr << "error client: " << state->client_.remote_endpoint() << " Disconnecting!" << '\n';
-      break;
-    }
-
-    if (request_count + 1 < static_cast<size_t>(header.length)) {
-      std::cerr << "packet size to small for body " << request_count << " " << state->client_.remote_endpoint()
-                << " Disconnecting!" << std::endl;
-      co_await async_write(state->client_, asio::buffer(build_error_buffer(header, 0, errc::illegal_data_value), count),
-                           use_awaitable);
-      continue;
-    }
-
-    // Handle the request
-    auto resp = handle_request(header, request_buffer, handler);
-    if (resp) {
-      header.length = resp.value().size() + 1;
-      auto header_bytes = header.to_bytes();
-      std::array<asio::const_buffer, 2> buffs{ asio::buffer(header_bytes), asio::buffer(resp.value()) };
-      co_await async_write(state->client_, buffs, use_awaitable);
+namespace impl {
+/// Record a step of a request on connection state.
+template <typename tracing_t>
+void trace(tracing_t const& tracing,
+           trace_point point,
+           connection_state const& state,
+           tcp_mbap const& header,
+           std::uint8_t function) {
+  if constexpr (tracing_t::enabled) {
+    tracing.record(trace_side::server, point, { state.endpoint_.port(), header.transaction, header.unit, function });
+  }
+}
+
+/// Record a step of the encoded response frame on connection state.
+template <typename tracing_t>
+void trace(tracing_t const& tracing, trace_point point, connection_state const& state, std::span<uint8_t const> frame) {
+  if constexpr (tracing_t::enabled) {
+    auto transaction = static_cast<std::uint16_t>((frame[0] << 8U) | frame[1]);
+    tracing.record(trace_side::server, point, { state.endpoint_.port(), transaction, frame[6], frame[7] });
+  }
+}
+}  // namespace impl
+
+/// Give back the in flight slot of a request whose response has been written.
+inline void finish_request(connection_state& state, in_flight_limiter& limiter) {
+  limiter.release(state);
+  if (state.in_flight_ == 0 && state.draining()) {
+    state.close("drained");
+  }
+}
+
+namespace impl {
+/// Count and capture a response about to be written, returning the header to send in front of pdu.
+inline auto response_header(connection_state& state, tcp_mbap header, std::span<uint8_t const> pdu)
+    -> std::array<uint8_t, tcp_mbap::size> {
+  header.length = static_cast<uint16_t>(pdu.size() + 1);
+  if (auto* counters = state.metrics_) {
+    counters->add(metric::bytes_out, static_cast<std::int64_t>(tcp_mbap::size + pdu.size()));
+    if (pdu.size() >= 2 && (pdu[0] & 0x80U) != 0) {
+      counters->exception(pdu[1]);
+    }
+  }
+  auto header_bytes = header.to_bytes();
+  if (auto* capture = state.capture_) {
+    capture->record(capture_direction::to_client, state.capture_ports_, header_bytes, pdu);
+  }
+  return header_bytes;
+}
+
+/// Queue a response behind the response currently being written.
+inline void queue_response(connection_state& state,
+                           std::array<uint8_t, tcp_mbap::size> const& header_bytes,
+                           std::span<uint8_t const> pdu) {
+  auto& frame = state.write_queue_.emplace_back(header_bytes.begin(), header_bytes.end());
+  frame.insert(frame.end(), pdu.begin(), pdu.end());
+}
+
+/// Write the responses queued while the previous one was written.
+/**
+ * \param ec Error of the previous write, queued responses are dropped once a write failed.
+ * \return The error of the last write.
+ */
+template <typename tracing_t>
+auto write_queued_responses(std::shared_ptr<connection_state> state,
+                            in_flight_limiter& limiter,
+                            asio::error_code ec,
+                            tracing_t const& tracing) -> awaitable<asio::error_code> {
+  while (!state->write_queue_.empty()) {
+    auto batch = std::move(state->write_queue_);
+    state->write_queue_.clear();
+    for (auto& frame : batch) {
+      if (!ec) {
+        trace(tracing, trace_point::write_start, *state, frame);
+        std::tie(ec, std::ignore) =
+            co_await async_write(state->client_, asio::buffer(frame), recycled(asio::as_tuple(use_awaitable)));
+        trace(tracing, trace_point::write_finish, *state, frame);
+      }
+      finish_request(*state, limiter);
+    }
+  }
+  co_return ec;
+}
+
+/// Let the next response be written right away, closing the connection if a write failed.
+inline void finish_writing(connection_state& state, asio::error_code ec) {
+  state.writing_ = false;
+  if (ec && state.close_reason_.empty()) {
+    state.close("error");
+  }
+}
+}  // namespace impl
+
+/// Write the response of a request, or queue it behind the response currently being written.
+/**
+ * Responses are written in the order they complete, the client matches them by transaction id.
+ */
+template <typename tracing_t>
+auto write_response(std::shared_ptr<connection_state> state,
+                    in_flight_limiter& limiter,
+                    tcp_mbap header,
+                    std::span<uint8_t const> pdu,
+                    tracing_t const& tracing) -> awaitable<void> {
+  auto header_bytes = impl::response_header(*state, header, pdu);
+  if (state->writing_) {
+    impl::queue_response(*state, header_bytes, pdu);
+    co_return;
+  }
+  state->writing_ = true;
+  impl::trace(tracing, trace_point::write_start, *state, header, pdu[0]);
+  std::array<asio::const_buffer, 2> buffs{ asio::buffer(header_bytes), asio::buffer(pdu.data(), pdu.size()) };
+  auto [ec, count] = co_await async_write(state->client_, buffs, impl::recycled(asio::as_tuple(use_awaitable)));
+  impl::trace(tracing, trace_point::write_finish, *state, header, pdu[0]);
+  finish_request(*state, limiter);
+  if (!state->write_queue_.empty()) {
+    ec = co_await impl::write_queued_responses(state, limiter, ec, tracing);
+  }
+  impl::finish_writing(*state, ec);
+}
+
+/// Run an asynchronous handler and write its response once it completes.
+template <typename request_t, typename tracing_t>
+auto handle_async_request(std::shared_ptr<connection_state> state,
+                          auto handler,
+                          in_flight_limiter& limiter,
+                          tcp_mbap header,
+                          request_t request,
+                          tracing_t const& tracing) -> awaitable<void> {
+  auto resp = co_await impl::handle_async(*handler, header.unit, request);
+  impl::trace(tracing, trace_point::handler_complete, *state, header, std::to_underlying(request_t::function));
+  if (!impl::responds(*handler, header.unit)) {
+    finish_request(*state, limiter);
+    co_return;
+  }
+  if (!resp) {
+    log<log_level::warning>(log_category::request, "exception response", state->endpoint_, 0, modbus_error(resp.error()));
+    co_await write_response(std::move(state), limiter, header,
+                            impl::error_pdu(std::to_underlying(request_t::function), resp.error()), tracing);
+    co_return;
+  }
+  co_await write_response(std::move(state), limiter, header, resp.value(), tracing);
+}
+
+namespace impl {
+/// Decodes a single request type and answers it, or hands it to an asynchronous handler.
+template <typename handler_ptr_t, typename tracing_t>
+struct connection_dispatcher {
+  using handler_t = std::remove_cvref_t<decltype(*std::declval<handler_ptr_t const&>())>;
+
+  /// The connection and request header a request was received with, and where its response is encoded.
+  struct context {
+    std::shared_ptr<connection_state> const& state;
+    handler_ptr_t const& handler;
+    in_flight_limiter& limiter;
+    tcp_mbap header;
+    tracing_t const& tracing;
+    std::span<uint8_t> response;
+  };
+
+  /// The size of the response encoded into context::response, or std::nullopt if the request is answered asynchronously.
+  using result_type = std::optional<std::expected<std::size_t, errc_t>>;
+  using function_type = auto (*)(context const&, std::span<uint8_t const>) -> result_type;
+
+  template <typename request_t>
+  static constexpr bool supports = sync_handler_for<handler_t, request_t> ||
+                                   awaitable_handler_for<handler_t, request_t> ||
+                                   token_handler_for<handler_t, request_t>;
+
+  template <typename request_t>
+  static auto call(context const& ctx, std::span<uint8_t const> pdu) -> result_type {
+    request_t request{};
+    if (request.deserialize(pdu)) {
+      return std::unexpected(errc_t::illegal_data_value);
+    }
+    trace(ctx.tracing, trace_point::decode_complete, *ctx.state, ctx.header, pdu[0]);
+    if constexpr (sync_handler_for<handler_t, request_t>) {
+      auto resp = handle_sync(*ctx.handler, ctx.header.unit, request, ctx.response);
+      trace(ctx.tracing, trace_point::handler_complete, *ctx.state, ctx.header, std::to_underlying(request_t::function));
+      return resp;
     } else {
-      std::cerr << "error client: " << state->client_.remote_endpoint() << " error " << modbus_error(resp.error()).message()
-                << '\n';
-      co_await async_write(state->client_, asio::buffer(build_error_buffer(header, 0, resp.error()), count), use_awaitable);
+      co_spawn(ctx.state->client_.get_executor(),
+               handle_async_request(ctx.state, ctx.handler, ctx.limiter, ctx.header, std::move(request), ctx.tracing),
+               detached);
+      return std::nullopt;
+    }
+  }
+};
+}  // namespace impl
+
+/// Read a single request into frame and answer it.
+/**
+ * Requests of synchronous handlers are answered before returning, their response is encoded into
+ * frame over the request and written from there. Requests of asynchronous
+ * handlers are run in their own coroutine and answered when they complete, so the next request
+ * can be read in the mean time.
+ *
+ * \return false if the connection can not be used any more.
+ */
+template <typename tracing_t = no_tracing>
+auto handle_frame(std::shared_ptr<connection_state> const& state,
+                  auto& handler,
+                  in_flight_limiter& limiter,
+                  std::span<uint8_t> frame,
+                  tracing_t const& tracing = no_trace) -> awaitable<bool> {
+  auto const& endpoint = state->endpoint_;
+  auto header_buffer = frame.first<tcp_mbap::size>();
+  auto [ec, count] = co_await asio::async_read(state->client_, asio::buffer(header_buffer.data(), header_buffer.size()),
+                                               impl::recycled(asio::as_tuple(asio::use_awaitable)));
+  if (!state->close_reason_.empty()) {
+    co_return false;
+  }
+  state->touch();
+  if (ec) {
+    log<log_level::info>(log_category::connection, "read failed", endpoint, 0, ec);
+    co_return false;
+  }
+  auto header = tcp_mbap::from_bytes(header_buffer);
+  impl::trace(tracing, trace_point::first_byte, *state, header, 0);
+  // Lengths below 2 are answered with illegal_function below.
+  if (header.length > modbus_max_pdu + 1U) {
+    // The rest of the stream can not be framed, give up on the connection.
+    log<log_level::warning>(log_category::request, "request length too large", endpoint, header.length);
+    co_return false;
+  }
+
+  while (!limiter.try_acquire(*state)) {
+    co_await limiter.wait(asio::as_tuple(use_awaitable));
+    if (!state->close_reason_.empty()) {
+      co_return false;
+    }
+  }
+
+  if (header.length < 2) {
+    if (auto* capture = state->capture_) {
+      capture->record(capture_direction::to_server, state->capture_ports_, header_buffer);
+    }
+    co_await write_response(state, limiter, header, impl::error_pdu(0, errc::illegal_function), tracing);
+    co_return true;
+  }
+
+  // Read the request body
+  auto request_buffer = frame.subspan(tcp_mbap::size, header.length - 1U);
+  auto [request_ec, request_count] =
+      co_await asio::async_read(state->client_, asio::buffer(request_buffer.data(), request_buffer.size()),
+                                impl::recycled(asio::as_tuple(asio::use_awaitable)));
+  if (request_ec) {
+    limiter.release(*state);
+    log<log_level::info>(log_category::connection, "read failed", endpoint, 0, request_ec);
+    co_return false;
+  }
+  impl::trace(tracing, trace_point::frame_complete, *state, header, request_buffer[0]);
+  if (auto* counters = state->metrics_) {
+    counters->request(request_buffer[0]);
+    counters->add(metric::bytes_in, static_cast<std::int64_t>(tcp_mbap::size + request_buffer.size()));
+  }
+  if (auto* capture = state->capture_) {
+    capture->record(capture_direction::to_server, state->capture_ports_,
+                    frame.first(tcp_mbap::size + request_buffer.size()));
+  }
+
+  // Handle the request, unsupported function codes are answered before anything is decoded
+  using dispatcher_t = impl::connection_dispatcher<std::remove_cvref_t<decltype(handler)>, tracing_t>;
+  std::uint8_t const function = request_buffer[0];
+  auto response_buffer = frame.subspan(tcp_mbap::size);
+  auto entry = impl::dispatch_table<dispatcher_t>[function];
+  typename dispatcher_t::result_type resp{ std::unexpected(errc::illegal_function) };
+  if (entry != nullptr) {
+    resp = entry({ state, handler, limiter, header, tracing, response_buffer }, request_buffer);
+  }
+  if (!resp) {
+    // Answered by the coroutine of the asynchronous handler
+    co_return true;
+  }
+  if (!impl::responds(*handler, header.unit)) {
+    finish_request(*state, limiter);
+    co_return true;
+  }
+  if (!*resp) {
+    log<log_level::warning>(log_category::request, "exception response", endpoint, 0, modbus_error(resp->error()));
+    auto exception = impl::error_pdu(function, resp->error());
+    std::ranges::copy(exception, response_buffer.begin());
+    resp->emplace(exception.size());
+  }
+  auto pdu = response_buffer.first(resp->value());
+  auto header_bytes = impl::response_header(*state, header, pdu);
+  if (state->writing_) {
+    impl::queue_response(*state, header_bytes, pdu);
+    co_return true;
+  }
+
+  // Nothing is being written, send the header and response from frame without another coroutine
+  std::ranges::copy(header_bytes, frame.begin());
+  auto response_frame = frame.first(tcp_mbap::size + pdu.size());
+  state->writing_ = true;
+  impl::trace(tracing, trace_point::write_start, *state, response_frame);
+  auto [write_ec, written] =
+      co_await async_write(state->client_, asio::buffer(response_frame.data(), response_frame.size()),
+                           impl::recycled(asio::as_tuple(use_awaitable)));
+  impl::trace(tracing, trace_point::write_finish, *state, response_frame);
+  finish_request(*state, limiter);
+  if (!state->write_queue_.empty()) {
+    write_ec = co_await impl::write_queued_responses(state, limiter, write_ec, tracing);
+  }
+  impl::finish_writing(*state, write_ec);
+  co_return true;
+}
+
+/// Serve requests on a connection until it is closed.
+/**
+ * The connection is closed when the coroutine returns, or when the registry it belongs to is
+ * draining and the requests in flight have been answered.
+ *
+ * \param buffers Pool the frame buffer is borrowed from, the buffer is held until the connection closes.
+ * \param limiter Bound on the requests in flight.
+ */
+template <typename tracing_t = no_tracing>
+auto handle_connection(std::shared_ptr<connection_state> state,
+                       auto&& handler,
+                       buffer_pool& buffers,
+                       in_flight_limiter& limiter,
+                       tracing_t const& tracing = no_trace) -> awaitable<void> {
+  auto frame = buffers.acquire();
+  while (!state->draining()) {
+    if (!co_await handle_frame(state, handler, limiter, frame.data(), tracing)) {
+      co_return;
     }
   }
-  // state->client_.close();
-  steady_timer wait_a_minute(co_await asio::this_coro::executor);
-  wait_a_minute.expires_after(5min);
-  co_await wait_a_minute.async_wait(asio::use_awaitable);
+  if (state->in_flight_ == 0) {
+    state->close("drained");
+  }
 }
 
-template <typename server_handler_t>
+/// Serve requests on a single connection outside of a server, with the limits and idle timeout of server_options.
+/**
+ * The frame buffer, the in flight limiter and the idle timer live in this coroutine, it only returns
+ * once the requests of asynchronous handlers still in flight have been answered.
+ */
+auto handle_connection(tcp::socket client, auto&& handler) -> awaitable<void> {
+  server_options const options{};
+  auto executor = client.get_executor();
+  buffer_pool buffers{ 1 };
+  in_flight_limiter limiter{ executor, 0, options.max_in_flight_per_connection };
+  timer_wheel idle_timers{ executor, options.idle_timeout, options.timer_resolution };
+  auto state = std::make_shared<connection_state>(std::move(client));
+  idle_timers.add(*state);
+  idle_timers.start();
+  co_await handle_connection(state, handler, buffers, limiter);
+  while (state->in_flight_ != 0) {
+    co_await limiter.wait(asio::as_tuple(use_awaitable));
+  }
+  idle_timers.remove(*state);
+  idle_timers.stop();
+}
+
+/// Modbus TCP server.
+/**
+ * For every request type server_handler_t provides one of
+ *  - `response handle(uint8_t unit, request const&, errc_t& error)`, answered right away. Such handlers may
+ *    also encode the response into the outgoing frame themselves, see encoding_handler_for.
+ *  - `awaitable<response> handle(uint8_t unit, request const&, errc_t& error)`.
+ *  - `handle(uint8_t unit, request const&, completion_token&&)` completing with
+ *    `void(std::expected<response, errc_t>)`, constrain the token with asio::completion_token_for.
+ * Requests of the asynchronous forms run concurrently, bounded by server_options::max_in_flight and
+ * server_options::max_in_flight_per_connection.
+ *
+ * tracing_t timestamps the steps of every request, see tracing_policy. The default no_tracing compiles to nothing.
+ *
+ * Not thread safe, the server and its handler run on the executor of io_context.
+ */
+template <typename server_handler_t, tracing_policy tracing_t = no_tracing>
 struct server {
-  explicit server(asio::io_context& io_context, std::shared_ptr<server_handler_t>& handler, int port)
-      : acceptor_(io_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)), handler_(handler) {}
+  explicit server(asio::io_context& io_context,
+                  std::shared_ptr<server_handler_t>& handler,
+                  int port,
+                  server_options options = {},
+                  tracing_t tracing = {})
+      : acceptor_(io_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)), handler_(handler), options_(options),
+        tracing_(std::move(tracing)),
+        idle_timers_(acceptor_.get_executor(), options.idle_timeout, options.timer_resolution),
+        connections_(acceptor_.get_executor(), options.max_connections),
+        limiter_(acceptor_.get_executor(), options.max_in_flight, options.max_in_flight_per_connection) {}
 
-  void start() { co_spawn(acceptor_.get_executor(), listen(), detached); }
+  void start() {
+    if (options_.idle_timeout != steady_clock::duration::zero()) {
+      idle_timers_.start();
+    }
+    co_spawn(acceptor_.get_executor(), listen(), detached);
+  }
+
+  /// Gracefully shut the server down.
+  /**
+   * Stops accepting new connections, closes idle connections and lets busy connections answer
+   * the requests they have in flight before they are closed. Completes once every connection is closed.
+   *
+   * Completion signature void()
+   */
+  template <typename completion_token>
+  auto drain(completion_token&& token) {
+    return asio::async_compose<completion_token, void()>(
+        [this, started = false](auto& self) mutable {
+          if (!started) {
+            started = true;
+            asio::error_code ignored;
+            acceptor_.close(ignored);
+            connections_.drain();
+            connections_.wait_empty(std::move(self));
+            return;
+          }
+          idle_timers_.stop();
+          self.complete();
+        },
+        token, acceptor_);
+  }
+
+  /// Number of open connections.
+  [[nodiscard]] auto connections() const -> std::size_t { return connections_.size(); }
+
+  /// Number of requests read and not yet answered on all connections.
+  [[nodiscard]] auto in_flight() const -> std::size_t { return limiter_.in_flight(); }
 
 private:
   auto listen() -> awaitable<void> {
     for (;;) {
-      auto client = co_await acceptor_.async_accept(use_awaitable);
-      client.set_option(asio::ip::tcp::no_delay(true));
-      client.set_option(asio::socket_base::keep_alive(true));
+      auto [accept_error, client] = co_await acceptor_.async_accept(asio::as_tuple(use_awaitable));
+      // The acceptor was closed by drain or destroyed with the server, which must not be touched anymore.
+      if (accept_error == asio::error::operation_aborted || !acceptor_.is_open()) {
+        co_return;
+      }
+      if (accept_error) {
+        log<log_level::error>(log_category::accept, "accept failed", {}, 0, accept_error);
+        continue;
+      }
+      asio::error_code option_error;
+      client.set_option(asio::ip::tcp::no_delay(true), option_error);
+      client.set_option(asio::socket_base::keep_alive(true), option_error);
 
-      co_spawn(acceptor_.get_executor(), handle_connection(std::move(client), handler_), detached);
+      auto state = std::make_shared<connection_state>(std::move(client));
+      state->metrics_ = options_.metrics.get();
+      if (options_.capture) {
+        asio::error_code ignored;
+        state->capture_ = options_.capture.get();
+        state->capture_ports_ = { state->endpoint_.port(), state->client_.local_endpoint(ignored).port() };
+      }
+      if (!connections_.admit(*state)) {
+        log<log_level::warning>(log_category::accept, "refusing client, busy connections", state->endpoint_,
+                                static_cast<std::int64_t>(connections_.size()));
+        continue;
+      }
+      if (state->metrics_ != nullptr) {
+        state->metrics_->add(metric::connections);
+      }
+      if (options_.idle_timeout != steady_clock::duration::zero()) {
+        idle_timers_.add(*state);
+      }
+      if (options_.park_idle_connections) {
+        park(std::move(state));
+      } else {
+        co_spawn(acceptor_.get_executor(), handle_connection(std::move(state), handler_, buffers_, limiter_, tracing_),
+                 detached);
+      }
+    }
+  }
 
-      co_await listen();
+  /// Wait for the next request without a coroutine or a buffer.
+  void park(std::shared_ptr<connection_state> state) {
+    if (state->draining()) {
+      // Connections with requests in flight are closed when the last response is written.
+      if (state->in_flight_ == 0) {
+        state->close("drained");
+      }
+      return;
     }
+    auto& socket = state->client_;
+    socket.async_wait(tcp::socket::wait_read, impl::recycled([this, state = std::move(state)](asio::error_code ec) mutable {
+      if (!state->close_reason_.empty()) {
+        return;
+      }
+      if (ec) {
+        log<log_level::info>(log_category::connection, "read failed", state->endpoint_, 0, ec);
+        return;
+      }
+      co_spawn(acceptor_.get_executor(), serve(std::move(state)), detached);
+    }));
+  }
+
+  /// Handle requests while the client has more to send, then park the connection again.
+  auto serve(std::shared_ptr<connection_state> state) -> awaitable<void> {
+    auto frame = buffers_.acquire();
+    asio::error_code ec;
+    do {
+      if (!co_await handle_frame(state, handler_, limiter_, frame.data(), tracing_)) {
+        co_return;
+      }
+    } while (!state->draining() && state->client_.available(ec) > 0);
+    frame.release();
+    park(std::move(state));
   }
 
   asio::ip::tcp::acceptor acceptor_;
   std::shared_ptr<server_handler_t> handler_;
+  server_options options_;
+  [[no_unique_address]] tracing_t tracing_;
+  timer_wheel idle_timers_;
+  connection_registry connections_;
+  buffer_pool buffers_;
+  in_flight_limiter limiter_;
 };
 
 }  // namespace modbus
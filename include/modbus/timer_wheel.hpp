@@ -0,0 +1,242 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+#include <asio/steady_timer.hpp>
+
+namespace modbus {
+
+/// Hierarchical timing wheel for idle timeouts.
+/**
+ * Entries are intrusive, adding, refreshing and removing an entry never allocates.
+ * Refreshing an entry with touch() only stores the current tick, the entry is moved to its new
+ * slot lazily when its old slot comes up. All entries share the same timeout and a single
+ * steady_timer drives the wheel, expired entries are collected and expired in one batch per tick.
+ *
+ * Not thread safe, all calls must be made from the executor of the wheel.
+ */
+class timer_wheel {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /// Number of slots on each level.
+  static constexpr std::size_t slot_bits = 6;
+  static constexpr std::size_t slots = 1U << slot_bits;
+  static constexpr std::size_t levels = 3;
+
+  /// Node in the timing wheel, derive from it and implement expire().
+  class entry {
+  public:
+    entry() = default;
+    entry(entry const&) = delete;
+    auto operator=(entry const&) -> entry& = delete;
+
+    /// Mark the entry as active at the current tick of its wheel.
+    void touch() {
+      if (wheel_ != nullptr) {
+        active_tick_ = wheel_->tick_;
+      }
+    }
+
+    /// Check if the entry is scheduled in a wheel.
+    [[nodiscard]] auto scheduled() const -> bool { return wheel_ != nullptr; }
+
+  protected:
+    ~entry() {
+      if (wheel_ != nullptr) {
+        wheel_->remove(*this);
+      }
+    }
+
+    /// Called from the wheel when the entry has not been touched for the timeout of the wheel.
+    /**
+     * The entry has been removed from the wheel before expire is called.
+     */
+    virtual void expire() = 0;
+
+  private:
+    friend class timer_wheel;
+
+    entry* prev_{ nullptr };
+    entry* next_{ nullptr };
+    entry** slot_{ nullptr };
+    timer_wheel* wheel_{ nullptr };
+    std::uint64_t active_tick_{};
+  };
+
+  /// Construct a wheel expiring entries that have not been touched for timeout.
+  /**
+   * \param timeout Must not be negative, entries of a zero timeout expire on the next tick.
+   * \param resolution Length of a tick, timeouts fire between timeout and timeout + resolution. Must be positive.
+   * \throws std::invalid_argument if timeout or resolution is out of range.
+   */
+  timer_wheel(asio::any_io_executor const& executor, clock::duration timeout, clock::duration resolution)
+      : timer_{ executor }, resolution_{ resolution } {
+    if (resolution <= clock::duration::zero()) {
+      throw std::invalid_argument("timer_wheel resolution must be positive");
+    }
+    if (timeout < clock::duration::zero()) {
+      throw std::invalid_argument("timer_wheel timeout must not be negative");
+    }
+    // Round up without adding to timeout, which may be as long as the duration allows.
+    auto partial_tick = timeout % resolution != clock::duration::zero() ? 1 : 0;
+    timeout_ticks_ = static_cast<std::uint64_t>(timeout / resolution + partial_tick);
+  }
+
+  timer_wheel(timer_wheel const&) = delete;
+  auto operator=(timer_wheel const&) -> timer_wheel& = delete;
+
+  ~timer_wheel() {
+    for (auto& level : wheel_) {
+      for (auto& head : level) {
+        while (head != nullptr) {
+          auto* node = head;
+          unlink(*node);
+          node->wheel_ = nullptr;
+        }
+      }
+    }
+  }
+
+  /// Start ticking.
+  void start() {
+    next_tick_ = clock::now() + resolution_;
+    schedule();
+  }
+
+  /// Stop ticking, scheduled entries are kept but will not expire until start is called again.
+  void stop() { timer_.cancel(); }
+
+  /// Schedule entry to expire after the timeout unless it is touched.
+  void add(entry& node) {
+    if (node.wheel_ != nullptr) {
+      node.wheel_->remove(node);
+    }
+    node.wheel_ = this;
+    node.active_tick_ = tick_;
+    insert(node);
+    ++size_;
+  }
+
+  /// Remove entry from the wheel without expiring it.
+  void remove(entry& node) {
+    if (node.wheel_ != this) {
+      return;
+    }
+    unlink(node);
+    node.wheel_ = nullptr;
+    --size_;
+  }
+
+  /// Number of scheduled entries.
+  [[nodiscard]] auto size() const -> std::size_t { return size_; }
+
+  /// Advance the wheel by a single tick, expiring all entries that are due.
+  void advance() {
+    ++tick_;
+    // Cascade entries from higher levels once the lower level has wrapped around.
+    for (std::size_t level = 1; level < levels; ++level) {
+      if ((tick_ & ((std::uint64_t{ 1 } << (slot_bits * level)) - 1)) != 0) {
+        break;
+      }
+      reschedule(wheel_[level][(tick_ >> (slot_bits * level)) & (slots - 1)]);
+    }
+    reschedule(wheel_[0][tick_ & (slots - 1)]);
+
+    // Expire the batch collected above, an expired entry may remove others from the batch.
+    while (expired_ != nullptr) {
+      auto* node = expired_;
+      unlink(*node);
+      node->wheel_ = nullptr;
+      --size_;
+      node->expire();
+    }
+  }
+
+private:
+  /// Move all entries in the slot to their current slot or to the expired batch.
+  void reschedule(entry*& head) {
+    entry* list = head;
+    head = nullptr;
+    while (list != nullptr) {
+      auto* node = list;
+      list = node->next_;
+      if (node->active_tick_ + timeout_ticks_ <= tick_) {
+        push(expired_, *node);
+      } else {
+        insert(*node);
+      }
+    }
+  }
+
+  void insert(entry& node) {
+    auto deadline = std::max(node.active_tick_ + timeout_ticks_, tick_ + 1);
+    auto delta = deadline - tick_;
+    std::size_t level = 0;
+    while (level + 1 < levels && delta >= (std::uint64_t{ 1 } << (slot_bits * (level + 1)))) {
+      ++level;
+    }
+    if (level + 1 == levels && delta >= (std::uint64_t{ 1 } << (slot_bits * levels))) {
+      // Beyond the range of the wheel, park in the furthest slot and reschedule from there.
+      deadline = tick_ + (std::uint64_t{ 1 } << (slot_bits * levels)) - 1;
+    }
+    push(wheel_[level][(deadline >> (slot_bits * level)) & (slots - 1)], node);
+  }
+
+  static void push(entry*& head, entry& node) {
+    node.prev_ = nullptr;
+    node.next_ = head;
+    if (head != nullptr) {
+      head->prev_ = &node;
+    }
+    head = &node;
+    node.slot_ = &head;
+  }
+
+  static void unlink(entry& node) {
+    if (node.prev_ != nullptr) {
+      node.prev_->next_ = node.next_;
+    } else if (node.slot_ != nullptr && *node.slot_ == &node) {
+      *node.slot_ = node.next_;
+    }
+    if (node.next_ != nullptr) {
+      node.next_->prev_ = node.prev_;
+    }
+    node.prev_ = nullptr;
+    node.next_ = nullptr;
+    node.slot_ = nullptr;
+  }
+
+  void schedule() {
+    timer_.expires_at(next_tick_);
+    timer_.async_wait([this](std::error_code const& error) {
+      if (error) {
+        return;
+      }
+      // Catch up if the executor was busy for longer than a tick.
+      auto now = clock::now();
+      while (next_tick_ <= now) {
+        advance();
+        next_tick_ += resolution_;
+      }
+      schedule();
+    });
+  }
+
+  asio::steady_timer timer_;
+  clock::duration resolution_;
+  clock::time_point next_tick_{};
+  std::uint64_t timeout_ticks_{};
+  std::uint64_t tick_{};
+  std::size_t size_{};
+  std::array<std::array<entry*, slots>, levels> wheel_{};
+  entry* expired_{ nullptr };
+};
+
+}  // namespace modbus
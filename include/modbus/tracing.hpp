@@ -0,0 +1,208 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <modbus/impl/append_number.hpp>
+
+namespace modbus {
+
+/// The steps of a transaction that are timestamped.
+/**
+ * Clients record write_start, write_finish, first_byte, frame_complete and decode_complete. A client
+ * writes its request as soon as the transaction starts, the time spent before that is not traced.
+ * Servers record first_byte, frame_complete, decode_complete, handler_complete, write_start and write_finish.
+ */
+enum struct trace_point : std::uint8_t {
+  /// Writing the request or the response starts.
+  write_start,
+  /// The request or the response is written.
+  write_finish,
+  /// The MBAP header of the response or the request is read.
+  first_byte,
+  /// The whole frame is read.
+  frame_complete,
+  /// The frame is decoded.
+  decode_complete,
+  /// The handler of the server has answered.
+  handler_complete,
+};
+
+inline constexpr std::array<std::string_view, 6> trace_point_names{
+  "write_start", "write_finish", "first_byte", "frame_complete", "decode_complete", "handler_complete"
+};
+
+/// Which end of the connection recorded an event.
+enum struct trace_side : std::uint8_t {
+  client,
+  server,
+};
+
+/// The transaction an event belongs to.
+struct trace_id {
+  /// The local port of the client, the same on both ends of a connection.
+  std::uint16_t source{};
+  std::uint16_t transaction{};
+  std::uint8_t unit{};
+  /// Zero in the first_byte step of the server, the function code has not been read yet.
+  std::uint8_t function{};
+};
+
+/// A timestamped step of a transaction.
+struct trace_event {
+  /// Nanoseconds of std::chrono::steady_clock.
+  std::int64_t timestamp{};
+  trace_id id{};
+  trace_side side{};
+  trace_point point{};
+};
+
+/// Fixed size buffer events are appended to from any thread without locks.
+/**
+ * Recording claims a slot with a single fetch_add, events arriving when the buffer is full are
+ * counted in dropped(). Export the events once the traced run is over, e.g. with write_chrome_trace.
+ */
+class trace_buffer {
+public:
+  explicit trace_buffer(std::size_t capacity = 1U << 16U)
+      : capacity_{ capacity }, slots_{ std::make_unique<slot[]>(capacity) } {}
+
+  void record(trace_event const& event) {
+    auto index = head_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= capacity_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    slots_[index].event = event;
+    slots_[index].ready.store(true, std::memory_order_release);
+  }
+
+  /// Copy of the recorded events, in the order their slots were claimed.
+  [[nodiscard]] auto events() const -> std::vector<trace_event> {
+    std::vector<trace_event> result;
+    auto size = std::min(head_.load(std::memory_order_acquire), capacity_);
+    result.reserve(size);
+    for (std::size_t index = 0; index < size; ++index) {
+      if (slots_[index].ready.load(std::memory_order_acquire)) {
+        result.push_back(slots_[index].event);
+      }
+    }
+    return result;
+  }
+
+  /// Events lost because the buffer was full.
+  [[nodiscard]] auto dropped() const -> std::size_t { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  struct slot {
+    trace_event event{};
+    std::atomic<bool> ready{};
+  };
+
+  std::size_t capacity_;
+  std::unique_ptr<slot[]> slots_;
+  alignas(64) std::atomic<std::size_t> head_{};
+  std::atomic<std::size_t> dropped_{};
+};
+
+/// Append events as Chrome trace JSON, which Perfetto and chrome://tracing open.
+/**
+ * Every step becomes a span from the previous step of the same transaction on the same side, named
+ * after the step it ends with. Connections are processes, identified by the port of the client, and
+ * transactions are threads, so a client and a server traced into the same buffer line up.
+ */
+inline void write_chrome_trace(std::vector<trace_event> events, std::string& out) {
+  std::ranges::stable_sort(events, {}, &trace_event::timestamp);
+  std::unordered_map<std::uint64_t, std::int64_t> previous;
+  auto microseconds = [&out](std::int64_t nanoseconds) {
+    impl::append_number(out, nanoseconds / 1000);
+    out += '.';
+    auto fraction = nanoseconds % 1000;
+    out.append(fraction < 10 ? "00" : fraction < 100 ? "0" : "");
+    impl::append_number(out, fraction);
+  };
+  out += "{\"traceEvents\":[";
+  bool first = true;
+  for (auto const& event : events) {
+    auto key = (std::uint64_t{ event.id.source } << 24U) | (std::uint64_t{ event.id.transaction } << 8U) |
+               static_cast<std::uint64_t>(event.side);
+    auto [found, inserted] = previous.try_emplace(key, event.timestamp);
+    auto start = found->second;
+    found->second = event.timestamp;
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    out += "\n{\"name\":\"";
+    out += trace_point_names[static_cast<std::size_t>(event.point)];
+    out += event.side == trace_side::client ? "\",\"cat\":\"client\"" : "\",\"cat\":\"server\"";
+    out += inserted ? ",\"ph\":\"i\",\"s\":\"t\",\"ts\":" : ",\"ph\":\"X\",\"ts\":";
+    microseconds(start);
+    if (!inserted) {
+      out += ",\"dur\":";
+      microseconds(event.timestamp - start);
+    }
+    out += ",\"pid\":";
+    impl::append_number(out, event.id.source);
+    out += ",\"tid\":";
+    impl::append_number(out, event.id.transaction);
+    out += ",\"args\":{\"unit\":";
+    impl::append_number(out, event.id.unit);
+    out += ",\"function\":";
+    impl::append_number(out, event.id.function);
+    out += "}}";
+  }
+  out += "\n]}\n";
+}
+
+/// Tracing policy recording nothing, calls compile to nothing.
+struct no_tracing {
+  static constexpr bool enabled = false;
+
+  static void record(trace_side, trace_point, trace_id const&) noexcept {}
+};
+
+/// Default for tracing parameters, an object with static storage so references to it never dangle.
+inline constexpr no_tracing no_trace{};
+
+/// Tracing policy timestamping every step into a trace_buffer.
+class buffer_tracing {
+public:
+  static constexpr bool enabled = true;
+
+  buffer_tracing() = default;
+  explicit buffer_tracing(std::shared_ptr<trace_buffer> buffer) : buffer_{ std::move(buffer) } {}
+
+  void record(trace_side side, trace_point point, trace_id const& id) const {
+    if (buffer_) {
+      auto now = std::chrono::steady_clock::now().time_since_epoch();
+      buffer_->record({ std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(), id, side, point });
+    }
+  }
+
+  [[nodiscard]] auto buffer() const -> std::shared_ptr<trace_buffer> const& { return buffer_; }
+
+private:
+  std::shared_ptr<trace_buffer> buffer_;
+};
+
+/// Policies usable as the tracing_t of client and server.
+template <typename tracing_t>
+concept tracing_policy = requires(tracing_t const& tracing, trace_side side, trace_point point, trace_id const& id) {
+  { tracing_t::enabled } -> std::convertible_to<bool>;
+  tracing.record(side, point, id);
+};
+
+}  // namespace modbus
@@ -0,0 +1,117 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <modbus/error.hpp>
+#include <modbus/request.hpp>
+#include <modbus/server.hpp>
+
+namespace modbus {
+
+/// Request counters of a single unit of a unit_router.
+struct unit_stats {
+  /// Requests addressed to the unit.
+  std::uint64_t requests{};
+
+  /// Requests answered with an exception response.
+  std::uint64_t exceptions{};
+
+  /// Broadcast writes applied to the unit.
+  std::uint64_t broadcasts{};
+};
+
+/// Server handler forwarding requests to a handler per unit id.
+/**
+ * Units are looked up in a flat table indexed by unit id. Requests to a unit without a handler are
+ * answered with gateway_path_unavailable.
+ *
+ * Unit 0 is the broadcast address: write requests are applied to every unit and no response is
+ * sent, other requests to unit 0 are dropped. unit_handler_t must answer requests synchronously.
+ *
+ * Not thread safe, the router is used from the executor of the server.
+ */
+template <typename unit_handler_t>
+class unit_router {
+public:
+  static constexpr std::uint8_t broadcast_unit = 0;
+  static constexpr std::uint8_t max_unit = 247;
+
+  /// Every unit has its own handler, a write to one unit does not change what the others read.
+  static constexpr bool separate_units = true;
+
+  /// Route requests for unit to handler, replacing any previous handler. Returns false for reserved unit ids.
+  auto add(std::uint8_t unit, std::shared_ptr<unit_handler_t> handler) -> bool {
+    if (unit == broadcast_unit || unit > max_unit) {
+      return false;
+    }
+    units_[unit] = std::move(handler);
+    return true;
+  }
+
+  /// Stop routing requests to unit.
+  void remove(std::uint8_t unit) { units_[unit].reset(); }
+
+  /// The handler of unit, nullptr if none.
+  [[nodiscard]] auto get(std::uint8_t unit) const -> std::shared_ptr<unit_handler_t> const& { return units_[unit]; }
+
+  /// Counters of unit.
+  [[nodiscard]] auto stats(std::uint8_t unit) const -> unit_stats const& { return stats_[unit]; }
+
+  /// Broadcast requests are not answered.
+  [[nodiscard]] auto responds(std::uint8_t unit) const -> bool { return unit != broadcast_unit; }
+
+  template <typename request_t>
+    requires impl::sync_handler_for<unit_handler_t, request_t>
+  auto handle(std::uint8_t unit, request_t const& request, errc_t& error)
+      -> decltype(std::declval<unit_handler_t&>().handle(unit, request, error)) {
+    if (unit == broadcast_unit) {
+      if constexpr (is_write<request_t>) {
+        broadcast(request);
+      }
+      return {};
+    }
+    auto& stats = stats_[unit];
+    ++stats.requests;
+    auto const& handler = units_[unit];
+    if (!handler) {
+      ++stats.exceptions;
+      error = errc::gateway_path_unavailable;
+      return {};
+    }
+    auto response = handler->handle(unit, request, error);
+    if (error) {
+      ++stats.exceptions;
+    }
+    return response;
+  }
+
+private:
+  /// Requests that may be broadcast, the ones that only write.
+  template <typename request_t>
+  static constexpr bool is_write = request_t::function == function_e::write_single_coil ||
+                                   request_t::function == function_e::write_single_register ||
+                                   request_t::function == function_e::write_multiple_coils ||
+                                   request_t::function == function_e::write_multiple_registers ||
+                                   request_t::function == function_e::mask_write_register;
+
+  template <typename request_t>
+  void broadcast(request_t const& request) {
+    for (std::size_t unit = 1; unit <= max_unit; ++unit) {
+      if (auto const& handler = units_[unit]) {
+        errc_t ignored = errc::no_error;
+        handler->handle(static_cast<std::uint8_t>(unit), request, ignored);
+        ++stats_[unit].broadcasts;
+      }
+    }
+  }
+
+  std::array<std::shared_ptr<unit_handler_t>, 256> units_{};
+  std::array<unit_stats, 256> stats_{};
+};
+
+}  // namespace modbus
@@ -0,0 +1,146 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+
+#include <modbus/error.hpp>
+#include <modbus/paged_table.hpp>
+
+namespace modbus {
+
+/// Register table storing its values in wire order, big endian.
+/**
+ * Drop in replacement for paged_table<std::uint16_t> in default_handler for data that is read far
+ * more often than it is written. The stored bytes are what goes on the wire, so read_wire answers
+ * a read with a bounds check and a memcpy per page while writes pay for the byte swap instead.
+ *
+ * The application uses the host order accessors, load and store also handle values spanning
+ * several registers with the most significant register first.
+ */
+class wire_table {
+public:
+  /// A register as it is sent on the wire.
+  struct word {
+    std::array<std::uint8_t, 2> bytes{};
+  };
+  static_assert(sizeof(word) == 2 && std::is_trivially_copyable_v<word>);
+
+  static constexpr std::size_t page_size = paged_table<word>::page_size;
+
+  /// Get the register at address in host order.
+  auto operator[](std::uint16_t address) const -> std::uint16_t { return from_wire(table_[address]); }
+
+  /// Set the flags of every page overlapping [address, address + count).
+  void set_flags(std::uint16_t address, std::size_t count, page_flags flags) { table_.set_flags(address, count, flags); }
+
+  /// Get the flags of the page containing address.
+  [[nodiscard]] auto flags(std::uint16_t address) const -> page_flags { return table_.flags(address); }
+
+  /// Check that count registers starting at address can be read.
+  [[nodiscard]] auto check_read(std::uint16_t address, std::size_t count) const -> errc_t {
+    return table_.check_read(address, count);
+  }
+
+  /// Check that count registers starting at address can be written.
+  [[nodiscard]] auto check_write(std::uint16_t address, std::size_t count) const -> errc_t {
+    return table_.check_write(address, count);
+  }
+
+  /// Copy count registers starting at address to out in host order.
+  template <typename output_iterator_t>
+  auto read(std::uint16_t address, std::size_t count, output_iterator_t out) const -> errc_t {
+    if (auto error = check_read(address, count)) {
+      return error;
+    }
+    paged_table<word>::for_each_page(address, count, [&](std::size_t page, std::size_t offset, std::size_t length) {
+      if (auto const* data = table_.page_data(page)) {
+        out = std::ranges::transform(data + offset, data + offset + length, out, &from_wire).out;
+      } else {
+        out = std::fill_n(out, length, std::uint16_t{});
+      }
+    });
+    return errc::no_error;
+  }
+
+  /// Copy count registers starting at address to out as they are sent on the wire, 2 * count bytes.
+  auto read_wire(std::uint16_t address, std::size_t count, std::uint8_t* out) const -> errc_t {
+    if (auto error = check_read(address, count)) {
+      return error;
+    }
+    paged_table<word>::for_each_page(address, count, [&](std::size_t page, std::size_t offset, std::size_t length) {
+      if (auto const* data = table_.page_data(page)) {
+        std::memcpy(out, data + offset, length * sizeof(word));
+      } else {
+        std::memset(out, 0, length * sizeof(word));
+      }
+      out += length * sizeof(word);
+    });
+    return errc::no_error;
+  }
+
+  /// Copy the host order registers of values to the table starting at address.
+  template <typename range_t>
+  auto write(std::uint16_t address, range_t const& values) -> errc_t {
+    return table_.write(address, values | std::views::transform(&to_wire));
+  }
+
+  /// Get a value stored in consecutive registers starting at address, most significant register first.
+  /**
+   * address + sizeof(value_t) / 2 must not exceed the address space.
+   */
+  template <typename value_t>
+    requires std::is_trivially_copyable_v<value_t> && (sizeof(value_t) % 2 == 0)
+  [[nodiscard]] auto load(std::uint16_t address) const -> value_t {
+    std::array<std::uint8_t, sizeof(value_t)> bytes{};
+    for (std::size_t i = 0; i < sizeof(value_t) / 2; ++i) {
+      auto stored = table_[static_cast<std::uint16_t>(address + i)];
+      bytes[2 * i] = stored.bytes[0];
+      bytes[2 * i + 1] = stored.bytes[1];
+    }
+    if constexpr (std::endian::native == std::endian::little) {
+      std::ranges::reverse(bytes);
+    }
+    return std::bit_cast<value_t>(bytes);
+  }
+
+  /// Store value in consecutive registers starting at address, most significant register first.
+  /**
+   * address + sizeof(value_t) / 2 must not exceed the address space. Page flags are not checked.
+   */
+  template <typename value_t>
+    requires std::is_trivially_copyable_v<value_t> && (sizeof(value_t) % 2 == 0)
+  void store(std::uint16_t address, value_t value) {
+    auto bytes = std::bit_cast<std::array<std::uint8_t, sizeof(value_t)>>(value);
+    if constexpr (std::endian::native == std::endian::little) {
+      std::ranges::reverse(bytes);
+    }
+    for (std::size_t i = 0; i < sizeof(value_t) / 2; ++i) {
+      table_[static_cast<std::uint16_t>(address + i)] = word{ { bytes[2 * i], bytes[2 * i + 1] } };
+    }
+  }
+
+  /// Number of allocated pages.
+  [[nodiscard]] auto allocated_pages() const -> std::size_t { return table_.allocated_pages(); }
+
+private:
+  static auto to_wire(std::uint16_t value) -> word {
+    return word{ { static_cast<std::uint8_t>(value >> 8U), static_cast<std::uint8_t>(value & 0xffU) } };
+  }
+
+  static auto from_wire(word value) -> std::uint16_t {
+    return static_cast<std::uint16_t>((value.bytes[0] << 8U) | value.bytes[1]);
+  }
+
+  paged_table<word> table_;
+};
+
+}  // namespace modbus
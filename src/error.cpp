@@ -64,6 +64,8 @@ class modbus_category_t : public std::error_category {
         return "peer error: unexpected function code";
       case errc::invalid_value:
         return "peer error: invalid value received";
+      case errc::unexpected_transaction_id:
+        return "peer error: unexpected transaction id";
     }
 
     return "unknown error: " + std::to_string(error);
@@ -0,0 +1,217 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// This test replaces the global operator new and operator delete.
+#define MODBUS_DEFINE_ALLOCATION_COUNTER
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <modbus/allocation_counter.hpp>
+#include <modbus/client.hpp>
+#include <modbus/default_handler.hpp>
+#include <modbus/response_cache.hpp>
+#include <modbus/server.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+constexpr int warm_up = 200;
+constexpr int transactions = 1000;
+
+struct transaction_allocations {
+  modbus::allocation_counts client;
+  modbus::allocation_counts server;
+};
+
+std::size_t hooked{};
+
+void count_hook(std::size_t size) {
+  hooked += size;
+}
+
+/// Allocations of the thread running server_ctx.
+auto server_allocations(asio::io_context& server_ctx) -> modbus::allocation_counts {
+  std::promise<modbus::allocation_counts> counts;
+  asio::post(server_ctx, [&counts]() { counts.set_value(modbus::thread_allocation_count()); });
+  return counts.get_future().get();
+}
+
+/// Run send warm_up times and then transactions times, each from the completion of the previous one.
+/**
+ * Returns the allocations of the measured transactions on the client thread and on the server thread.
+ * The transactions run in a single call to run, the recycled memory of asio is cached by the thread
+ * info of that call.
+ */
+template <typename send_t>
+auto measure(asio::io_context& ctx, asio::io_context& server_ctx, send_t send) -> transaction_allocations {
+  transaction_allocations result{};
+  modbus::allocation_counts client_start{};
+  modbus::allocation_counts server_start{};
+  int sent = 0;
+  bool failed = false;
+  std::function<void()> next = [&]() {
+    if (sent == warm_up) {
+      server_start = server_allocations(server_ctx);
+      client_start = modbus::thread_allocation_count();
+    }
+    if (sent++ == warm_up + transactions) {
+      result.client = modbus::thread_allocation_count() - client_start;
+      return;
+    }
+    send([&](auto const& response) {
+      failed = failed || !response.has_value();
+      next();
+    });
+  };
+  next();
+  ctx.run();
+  ctx.restart();
+  result.server = server_allocations(server_ctx) - server_start;
+  boost::ut::expect(!failed);
+  return result;
+}
+
+/// Check the allocations per measured transaction of both sides.
+void check(std::string_view function,
+           transaction_allocations const& allocations,
+           std::uint64_t client_per_transaction,
+           std::uint64_t server_per_transaction) {
+  using boost::ut::expect;
+  expect(allocations.client.allocations == client_per_transaction * transactions)
+      << function << " allocated " << allocations.client.allocations << " times on the client";
+  expect(allocations.server.allocations == server_per_transaction * transactions)
+      << function << " allocated " << allocations.server.allocations << " times on the server";
+}
+
+/// Serve handler on port from a thread of its own and run body with a client connected to it.
+template <typename handler_t>
+void with_server(std::shared_ptr<handler_t> handler, int port, auto body) {
+  asio::io_context server_ctx;
+  // Connections keep their coroutine between requests, parked ones start a coroutine for each request.
+  modbus::server server{ server_ctx, handler, port, modbus::server_options{ .park_idle_connections = false } };
+  server.start();
+  auto work = asio::make_work_guard(server_ctx);
+  std::thread server_thread{ [&server_ctx]() { server_ctx.run(); } };
+
+  asio::io_context ctx;
+  modbus::client client{ ctx };
+  std::error_code connect_error = modbus::modbus_error(modbus::errc::server_device_failure);
+  client.connect("127.0.0.1", std::to_string(port), [&connect_error](std::error_code error) { connect_error = error; });
+  ctx.run();
+  ctx.restart();
+  boost::ut::expect(!connect_error);
+
+  body(ctx, server_ctx, client);
+
+  client.close();
+  work.reset();
+  server_ctx.stop();
+  server_thread.join();
+}
+}  // namespace
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "allocations are counted and reported to the hook"_test = []() {
+    auto before = modbus::thread_allocation_count();
+    modbus::set_allocation_hook(count_hook);
+    auto value = std::make_unique<std::uint64_t>(42);
+    modbus::set_allocation_hook(nullptr);
+    value.reset();
+    auto counted = modbus::thread_allocation_count() - before;
+    expect(counted.allocations == 1) << counted.allocations;
+    expect(counted.deallocations == 1) << counted.deallocations;
+    expect(counted.bytes == sizeof(std::uint64_t));
+    expect(hooked == sizeof(std::uint64_t));
+    expect(modbus::allocation_count().allocations >= counted.allocations);
+  };
+
+  "steady state transactions allocate only the values they return"_test = []() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    with_server(handler, 15512, [](asio::io_context& ctx, asio::io_context& server_ctx, modbus::client& client) {
+      // Client: the vector of values it completes with. Server: the vector of the response of default_handler.
+      check("read_coils", measure(ctx, server_ctx, [&](auto done) { client.read_coils(1, 0, 16, done); }), 1, 1);
+      check("read_discrete_inputs",
+            measure(ctx, server_ctx, [&](auto done) { client.read_discrete_inputs(1, 0, 16, done); }), 1, 1);
+      check("read_holding_registers",
+            measure(ctx, server_ctx, [&](auto done) { client.read_holding_registers(1, 0, 16, done); }), 1, 1);
+      check("read_input_registers",
+            measure(ctx, server_ctx, [&](auto done) { client.read_input_registers(1, 0, 16, done); }), 1, 1);
+
+      // Views borrow from the receive buffer of the client. Server: the vector of the response.
+      check("read_coils_view", measure(ctx, server_ctx, [&](auto done) { client.read_coils_view(1, 0, 16, done); }), 0,
+            1);
+      check("read_discrete_inputs_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_discrete_inputs_view(1, 0, 16, done); }), 0, 1);
+      check("read_holding_registers_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_holding_registers_view(1, 0, 16, done); }), 0, 1);
+      check("read_input_registers_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_input_registers_view(1, 0, 16, done); }), 0, 1);
+
+      check("write_single_coil",
+            measure(ctx, server_ctx, [&](auto done) { client.write_single_coil(1, 0, true, done); }), 0, 0);
+      check("write_single_register",
+            measure(ctx, server_ctx, [&](auto done) { client.write_single_register(1, 0, 42, done); }), 0, 0);
+      check("mask_write_register",
+            measure(ctx, server_ctx, [&](auto done) { client.mask_write_register(1, 0, 0xff00, 0x00ff, done); }), 0,
+            0);
+
+      // The client takes the vectors by value, they are made before the measurement. Server: the
+      // vector the values of the request are decoded into.
+      std::vector<std::vector<bool>> coils(warm_up + transactions, std::vector<bool>(16, true));
+      std::vector<std::vector<std::uint16_t>> registers(warm_up + transactions, std::vector<std::uint16_t>(16, 42));
+      std::size_t coil_index{};
+      check("write_multiple_coils", measure(ctx, server_ctx, [&](auto done) {
+              client.write_multiple_coils(1, 0, std::move(coils[coil_index++]), done);
+            }),
+            0, 1);
+      std::size_t register_index{};
+      check("write_multiple_registers", measure(ctx, server_ctx, [&](auto done) {
+              client.write_multiple_registers(1, 0, std::move(registers[register_index++]), done);
+            }),
+            0, 1);
+      // Client: the vector of values read. Server: the decoded request values and the response vector.
+      std::ranges::fill(registers, std::vector<std::uint16_t>(16, 42));
+      register_index = 0;
+      check("read_write_multiple_registers", measure(ctx, server_ctx, [&](auto done) {
+              client.read_write_multiple_registers(1, 0, 16, 0, std::move(registers[register_index++]), done);
+            }),
+            1, 2);
+    });
+  };
+
+  "register reads of a wire table do not allocate"_test = []() {
+    auto handler = std::make_shared<modbus::wire_default_handler>();
+    with_server(handler, 15514, [](asio::io_context& ctx, asio::io_context& server_ctx, modbus::client& client) {
+      check("read_holding_registers_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_holding_registers_view(1, 0, 16, done); }), 0, 0);
+      check("read_input_registers_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_input_registers_view(1, 0, 16, done); }), 0, 0);
+    });
+  };
+
+  "cache hits do not allocate"_test = []() {
+    auto handler = std::make_shared<modbus::response_cache<modbus::default_handler>>(
+        std::make_shared<modbus::default_handler>());
+    with_server(handler, 15515, [](asio::io_context& ctx, asio::io_context& server_ctx, modbus::client& client) {
+      check("read_coils_view", measure(ctx, server_ctx, [&](auto done) { client.read_coils_view(1, 0, 16, done); }), 0,
+            0);
+      check("read_discrete_inputs_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_discrete_inputs_view(1, 0, 16, done); }), 0, 0);
+      check("read_holding_registers_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_holding_registers_view(1, 0, 16, done); }), 0, 0);
+      check("read_input_registers_view",
+            measure(ctx, server_ctx, [&](auto done) { client.read_input_registers_view(1, 0, 16, done); }), 0, 0);
+    });
+  };
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <modbus/atomic_groups.hpp>
+#include <modbus/default_handler.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "overlapping groups are rejected"_test = []() {
+    modbus::atomic_groups groups;
+    expect(groups.declare(10, 2));
+    expect(!groups.declare(11, 2));
+    expect(!groups.declare(8, 3));
+    expect(!groups.declare(20, 1));
+    expect(!groups.declare(20, 5));
+    expect(!groups.declare(0xffff, 2));
+    expect(groups.declare(12, 4));
+    expect(groups.declare(8, 2));
+    expect(groups.size() == 3);
+  };
+
+  "typed values are stored most significant register first"_test = []() {
+    modbus::atomic_groups groups;
+    groups.declare(0, 2);
+    groups.declare(2, 4);
+    groups.store<std::uint32_t>(0, 0x11223344U);
+    groups.store(2, 1234.5);
+    std::vector<std::uint16_t> values(6);
+    groups.read(0, 6, [&](std::uint16_t address, std::uint16_t value) { values[address] = value; });
+    expect(values[0] == 0x1122 && values[1] == 0x3344);
+    expect(groups.load<std::uint32_t>(0) == 0x11223344U);
+    expect(groups.load<double>(2) == 1234.5);
+  };
+
+  "partial writes update the whole group at once"_test = []() {
+    modbus::atomic_groups groups;
+    groups.declare(4, 2);
+    groups.store<std::uint32_t>(4, 0x00010002U);
+    std::array<std::uint16_t, 2> values{ 7, 9 };
+    groups.write(3, values, groups.lock());
+    expect(groups.load<std::uint32_t>(4) == 0x00090002U);
+  };
+
+  "readers never see a torn value"_test = []() {
+    modbus::atomic_groups groups;
+    groups.declare(0, 4);
+    std::atomic<bool> done{ false };
+    std::thread writer{ [&]() {
+      for (std::uint64_t i = 0; i < 200000; ++i) {
+        // Both halves always hold the same counter
+        groups.store<std::uint64_t>(0, (i << 32U) | i);
+      }
+      done = true;
+    } };
+    bool torn = false;
+    while (!done) {
+      auto value = groups.load<std::uint64_t>(0);
+      torn = torn || (value >> 32U) != (value & 0xffffffffU);
+    }
+    writer.join();
+    expect(!torn);
+  };
+
+  "the handler serves grouped registers"_test = []() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    handler->register_groups.declare(100, 2);
+    handler->register_groups.store(100, 2.5F);
+    modbus::errc_t error = modbus::errc::no_error;
+    auto read = handler->handle(0, modbus::request::read_holding_registers{ 99, 3 }, error);
+    expect(!error);
+    expect(read.values == std::vector<std::uint16_t>{ 0, 0x4020, 0x0000 });
+    handler->handle(0, modbus::request::write_multiple_registers{ 100, std::vector<std::uint16_t>{ 0x4049, 0x0fdb } },
+                    error);
+    expect(!error);
+    expect(handler->register_groups.load<float>(100) > 3.14F);
+    handler->handle(0, modbus::request::mask_write_register{ 101, 0xff00, 0x0011 }, error);
+    expect(!error);
+    auto rw = handler->handle(0, modbus::request::read_write_multiple_registers{ 100, 2, 0, {} }, error);
+    expect(rw.values == std::vector<std::uint16_t>{ 0x4049, 0x0f11 });
+  };
+
+  "the wire handler serves grouped registers"_test = []() {
+    auto handler = std::make_shared<modbus::wire_default_handler>();
+    handler->register_groups.declare(0, 2);
+    handler->register_groups.store<std::uint32_t>(0, 0xa1b2c3d4U);
+    modbus::errc_t error = modbus::errc::no_error;
+    auto read = handler->handle(0, modbus::request::read_holding_registers{ 0, 2 }, error);
+    expect(!error);
+    expect(read.serialize() == std::vector<std::uint8_t>{ 0x03, 0x04, 0xa1, 0xb2, 0xc3, 0xd4 });
+  };
+}
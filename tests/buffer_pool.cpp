@@ -0,0 +1,47 @@
+#include <modbus/buffer_pool.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "buffers hold a complete frame"_test = []() {
+    modbus::buffer_pool pool{ 4 };
+    auto buffer = pool.acquire();
+    expect(static_cast<bool>(buffer));
+    expect(buffer.data().size() == modbus::tcp_mbap::size + modbus::modbus_max_pdu);
+  };
+
+  "released buffers are reused"_test = []() {
+    modbus::buffer_pool pool{ 4 };
+    auto first = pool.acquire();
+    auto* memory = first.data().data();
+    expect(pool.available() == 3);
+    first.release();
+    expect(!first);
+    expect(pool.available() == 4);
+    auto second = pool.acquire();
+    expect(second.data().data() == memory);
+  };
+
+  "pool grows by whole slabs"_test = []() {
+    modbus::buffer_pool pool{ 2 };
+    auto first = pool.acquire();
+    auto second = pool.acquire();
+    auto third = pool.acquire();
+    expect(pool.capacity() == 4);
+    expect(pool.available() == 1);
+  };
+
+  "moved buffers are returned once"_test = []() {
+    modbus::buffer_pool pool{ 2 };
+    {
+      auto first = pool.acquire();
+      auto moved = std::move(first);
+      expect(!first);
+      expect(static_cast<bool>(moved));
+    }
+    expect(pool.available() == 2);
+  };
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <modbus/capture.hpp>
+#include <modbus/client.hpp>
+#include <modbus/default_handler.hpp>
+#include <modbus/server.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+auto temporary(std::string const& name) -> std::filesystem::path {
+  return std::filesystem::temp_directory_path() / ("modbus_" + name + "_" + std::to_string(::getpid()) + ".mbcap");
+}
+
+auto host_u32(std::string const& data, std::size_t offset) -> std::uint32_t {
+  std::uint32_t value{};
+  std::memcpy(&value, data.data() + offset, sizeof(value));
+  return value;
+}
+}  // namespace
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+  using modbus::capture_direction;
+
+  "records are read back in order and dropped once the file is full"_test = []() {
+    auto path = temporary("log");
+    std::vector<std::uint8_t> request{ 0, 1, 0, 0, 0, 6, 1, 3, 0, 0, 0, 4 };
+    std::vector<std::uint8_t> header{ 0, 1, 0, 0, 0, 3 };
+    std::vector<std::uint8_t> pdu{ 1, 0x83, 2 };
+    {
+      modbus::capture_log log{ path, 64 };
+      log.record(capture_direction::to_server, { 40000, 502 }, request);
+      log.record(capture_direction::to_client, { 40000, 502 }, header, pdu);
+      log.record(capture_direction::to_client, { 40000, 502 }, request);
+      expect(log.size() == 64);
+      expect(log.dropped() == 1);
+    }
+    expect(std::filesystem::file_size(path) == modbus::capture_log::file_header_size + 64);
+
+    auto adus = modbus::read_capture(path);
+    expect(adus.has_value());
+    expect(adus->size() == 2);
+    expect(adus->at(0).direction == capture_direction::to_server);
+    expect(adus->at(0).ports.client == 40000 && adus->at(0).ports.server == 502);
+    expect(adus->at(0).adu == request);
+    expect(adus->at(1).direction == capture_direction::to_client);
+    expect(adus->at(1).adu == std::vector<std::uint8_t>{ 0, 1, 0, 0, 0, 3, 1, 0x83, 2 });
+    expect(adus->at(0).timestamp <= adus->at(1).timestamp);
+    std::filesystem::remove(path);
+
+    expect(modbus::read_capture(temporary("missing")).error() == std::errc::no_such_file_or_directory);
+  };
+
+  "client and server captures of a connection line up"_test = []() {
+    auto client_path = temporary("client");
+    auto server_path = temporary("server");
+    {
+      asio::io_context ctx;
+      auto handler = std::make_shared<modbus::default_handler>();
+      modbus::server_options options{};
+      options.capture = std::make_shared<modbus::capture_log>(server_path);
+      modbus::server server{ ctx, handler, 15513, options };
+      server.start();
+      modbus::client client{ ctx };
+      client.set_capture(std::make_shared<modbus::capture_log>(client_path));
+      bool finished = false;
+      co_spawn(
+          ctx,
+          [&]() -> asio::awaitable<void> {
+            auto [error] = co_await client.connect("127.0.0.1", "15513", asio::as_tuple(asio::use_awaitable));
+            expect(!error);
+            expect((co_await client.write_single_register(1, 7, 42, asio::use_awaitable)).has_value());
+            expect((co_await client.read_holding_registers(1, 7, 1, asio::use_awaitable)).has_value());
+            client.close();
+            finished = true;
+          },
+          asio::detached);
+      ctx.run_for(std::chrono::milliseconds(500));
+      expect(finished);
+    }
+
+    auto client_adus = modbus::read_capture(client_path);
+    auto server_adus = modbus::read_capture(server_path);
+    expect(client_adus.has_value() && server_adus.has_value());
+    expect(client_adus->size() == 4);
+    expect(server_adus->size() == 4);
+    for (std::size_t index = 0; index < std::min(client_adus->size(), server_adus->size()); ++index) {
+      auto const& sent = client_adus->at(index);
+      auto const& received = server_adus->at(index);
+      expect(sent.direction == (index % 2 == 0 ? capture_direction::to_server : capture_direction::to_client));
+      expect(sent.direction == received.direction);
+      expect(sent.adu == received.adu);
+      expect(sent.ports.client == received.ports.client && sent.ports.server == 15513);
+      expect(received.ports.server == 15513);
+    }
+    expect(client_adus->at(0).adu == std::vector<std::uint8_t>{ 0, 1, 0, 0, 0, 6, 1, 6, 0, 7, 0, 42 });
+    std::filesystem::remove(client_path);
+    std::filesystem::remove(server_path);
+  };
+
+  "captures convert to pcapng"_test = []() {
+    std::vector<modbus::captured_adu> adus{
+      { 1'000'000'123, { 40000, 502 }, capture_direction::to_server, { 0, 1, 0, 0, 0, 6, 1, 3, 0, 0, 0, 4 } },
+      { 1'000'050'000, { 40000, 502 }, capture_direction::to_client, { 0, 1, 0, 0, 0, 3, 1, 0x83, 2 } },
+    };
+    std::string pcapng;
+    modbus::write_pcapng(adus, pcapng);
+
+    expect(host_u32(pcapng, 0) == 0x0a0d0d0a);
+    expect(host_u32(pcapng, 8) == 0x1a2b3c4d);
+    expect(pcapng.size() % 4 == 0);
+    // Every block ends with its total length.
+    std::size_t blocks{};
+    for (std::size_t offset = 0; offset < pcapng.size(); ++blocks) {
+      auto length = host_u32(pcapng, offset + 4);
+      expect(length >= 12 && offset + length <= pcapng.size());
+      expect(host_u32(pcapng, offset + length - 4) == length);
+      offset += length;
+    }
+    expect(blocks == 4);
+    // The first packet, after the section and interface blocks, starts 28 bytes into its block.
+    auto packet = pcapng.substr(28 + 32 + 28, 40 + 12);
+    expect(static_cast<std::uint8_t>(packet[0]) == 0x45);
+    expect(static_cast<std::uint8_t>(packet[20]) == 40000 >> 8U && static_cast<std::uint8_t>(packet[23]) == 502 % 256);
+    expect(packet.substr(40) == std::string{ "\0\1\0\0\0\6\1\3\0\0\0\4", 12 });
+  };
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <modbus/change_feed.hpp>
+#include <modbus/default_handler.hpp>
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "events are drained in order"_test = []() {
+    modbus::change_feed feed{ 4 };
+    std::array<std::uint16_t, 2> values{ 1, 2 };
+    expect(feed.publish(1, 10, values));
+    expect(feed.publish_coils(2, 20, std::vector<bool>{ true, false, true }));
+    std::vector<modbus::write_event> events;
+    expect(feed.drain([&](modbus::write_event const& event) { events.push_back(event); }) == 2);
+    expect(events.size() == 2);
+    expect(events[0].unit == 1 && events[0].table == modbus::data_table::holding_registers);
+    expect(events[0].address == 10 && events[0].registers().size() == 2 && events[0].registers()[1] == 2);
+    expect(events[1].table == modbus::data_table::coils && events[1].count == 3);
+    expect(events[1].coil(0) && !events[1].coil(1) && events[1].coil(2));
+    expect(events[0].timestamp <= events[1].timestamp);
+  };
+
+  "writes to a full feed are dropped"_test = []() {
+    modbus::change_feed feed{ 2 };
+    std::array<std::uint16_t, 1> values{ 1 };
+    expect(feed.publish(1, 0, values));
+    expect(feed.publish(1, 1, values));
+    expect(!feed.publish(1, 2, values));
+    expect(feed.dropped() == 1);
+    modbus::write_event event;
+    expect(feed.try_pop(event) && event.address == 0);
+    expect(feed.publish(1, 3, values));
+    expect(feed.try_pop(event) && event.address == 1);
+    expect(feed.try_pop(event) && event.address == 3);
+    expect(!feed.try_pop(event));
+  };
+
+  "concurrent producers lose nothing"_test = []() {
+    modbus::change_feed feed{ 1 << 16 };
+    std::vector<std::thread> producers;
+    for (std::uint8_t unit = 1; unit <= 4; ++unit) {
+      producers.emplace_back([&feed, unit]() {
+        for (std::uint16_t i = 0; i < 10000; ++i) {
+          std::array<std::uint16_t, 1> values{ i };
+          feed.publish(unit, i, values);
+        }
+      });
+    }
+    for (auto& producer : producers) {
+      producer.join();
+    }
+    std::array<std::uint16_t, 5> next{};
+    bool ordered = true;
+    auto count = feed.drain([&](modbus::write_event const& event) {
+      ordered = ordered && event.address == next[event.unit]++;
+    });
+    expect(count == 40000);
+    expect(ordered);
+    expect(feed.dropped() == 0);
+  };
+
+#ifdef __linux__
+  "the eventfd becomes readable on publish"_test = []() {
+    modbus::change_feed feed;
+    auto handle = feed.enable_eventfd();
+    expect(handle >= 0);
+    pollfd descriptor{ .fd = handle, .events = POLLIN, .revents = 0 };
+    expect(::poll(&descriptor, 1, 0) == 0);
+    std::array<std::uint16_t, 1> values{ 1 };
+    feed.publish(1, 0, values);
+    expect(::poll(&descriptor, 1, 0) == 1);
+    feed.drain([](modbus::write_event const&) {});
+    expect(::poll(&descriptor, 1, 0) == 0);
+  };
+#endif
+
+  "the handler publishes accepted writes"_test = []() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    handler->changes = std::make_shared<modbus::change_feed>();
+    handler->registers.set_flags(0x1000, 1, modbus::page_flags::read_only);
+    modbus::errc_t error = modbus::errc::no_error;
+    handler->handle(5, modbus::request::write_multiple_registers{ 7, std::vector<std::uint16_t>{ 3, 4 } }, error);
+    handler->handle(5, modbus::request::write_single_register{ 0x1000, 1 }, error);
+    expect(error == modbus::errc::illegal_data_address);
+    error = modbus::errc::no_error;
+    handler->handle(6, modbus::request::write_single_coil{ 2, true }, error);
+    handler->handle(6, modbus::request::mask_write_register{ 7, 0x00ff, 0x0100 }, error);
+    std::vector<modbus::write_event> events;
+    handler->changes->drain([&](modbus::write_event const& event) { events.push_back(event); });
+    expect(events.size() == 3);
+    expect(events[0].unit == 5 && events[0].address == 7 && events[0].count == 2);
+    expect(events[1].unit == 6 && events[1].table == modbus::data_table::coils && events[1].coil(0));
+    expect(events[2].address == 7 && events[2].registers()[0] == 0x0103);
+  };
+}
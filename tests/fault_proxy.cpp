@@ -0,0 +1,135 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <modbus/client.hpp>
+#include <modbus/default_handler.hpp>
+#include <modbus/fault_proxy.hpp>
+#include <modbus/server.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+constexpr std::uint16_t server_port = 15517;
+
+/// Run test with a client connected to a server through a proxy injecting options.
+auto through_proxy(modbus::fault_proxy_options options,
+                   std::function<asio::awaitable<void>(modbus::client&, modbus::fault_proxy&)> test) -> bool {
+  asio::io_context ctx;
+  auto handler = std::make_shared<modbus::default_handler>();
+  modbus::server server{ ctx, handler, server_port };
+  server.start();
+  modbus::fault_proxy proxy{ ctx, { asio::ip::address_v4::loopback(), server_port }, options };
+  proxy.start();
+  modbus::client client{ ctx };
+  bool finished = false;
+  co_spawn(
+      ctx,
+      [&]() -> asio::awaitable<void> {
+        auto port = std::to_string(proxy.local_endpoint().port());
+        auto [error] = co_await client.connect("127.0.0.1", port, asio::as_tuple(asio::use_awaitable));
+        boost::ut::expect(!error);
+        co_await test(client, proxy);
+        client.close();
+        proxy.stop();
+        finished = true;
+      },
+      asio::detached);
+  ctx.run_for(std::chrono::seconds(5));
+  return finished;
+}
+}  // namespace
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+  using std::chrono_literals::operator""ms;
+  using std::chrono_literals::operator""us;
+
+  "frames split into segments and sent a byte at a time are reassembled"_test = []() {
+    modbus::fault_proxy_options options{};
+    options.to_server.split_probability = 0.5;
+    options.to_server.slow_probability = 0.3;
+    options.to_server.slow_interval = 100us;
+    options.to_client = options.to_server;
+    expect(through_proxy(options, [](modbus::client& client, modbus::fault_proxy& proxy) -> asio::awaitable<void> {
+      for (std::uint16_t index = 0; index < 50; ++index) {
+        expect((co_await client.write_single_register(1, index, index, asio::use_awaitable)).has_value());
+        auto values = co_await client.read_holding_registers(1, index, 1, asio::use_awaitable);
+        expect(values.has_value() && values->values.at(0) == index);
+      }
+      expect(proxy.to_server_stats().frames == 100);
+      expect(proxy.to_client_stats().frames == 100);
+      expect(proxy.to_server_stats().splits > 0 && proxy.to_server_stats().slowed > 0);
+      expect(proxy.to_client_stats().splits > 0 && proxy.to_client_stats().slowed > 0);
+    }));
+  };
+
+  "responses are delayed"_test = []() {
+    modbus::fault_proxy_options options{};
+    options.to_client.delay.base = 20ms;
+    expect(through_proxy(options, [](modbus::client& client, modbus::fault_proxy&) -> asio::awaitable<void> {
+      auto start = std::chrono::steady_clock::now();
+      expect((co_await client.read_coils(1, 0, 8, asio::use_awaitable)).has_value());
+      expect(std::chrono::steady_clock::now() - start >= 20ms);
+    }));
+  };
+
+  "dropped requests are never answered"_test = []() {
+    modbus::fault_proxy_options options{};
+    options.to_server.drop_probability = 1;
+    expect(through_proxy(options, [](modbus::client& client, modbus::fault_proxy& proxy) -> asio::awaitable<void> {
+      // The client has no timeout of its own, give up on the request by closing it.
+      asio::steady_timer timeout{ client.io_executor(), 50ms };
+      timeout.async_wait([&client](std::error_code) { client.close(); });
+      auto start = std::chrono::steady_clock::now();
+      expect(!(co_await client.read_coils(1, 0, 8, asio::use_awaitable)).has_value());
+      expect(std::chrono::steady_clock::now() - start >= 50ms);
+      expect(proxy.to_server_stats().drops == 1);
+    }));
+  };
+
+  "reset and truncated responses fail the transaction"_test = []() {
+    modbus::fault_proxy_options reset{};
+    reset.to_client.reset_probability = 1;
+    expect(through_proxy(reset, [](modbus::client& client, modbus::fault_proxy& proxy) -> asio::awaitable<void> {
+      expect(!(co_await client.read_coils(1, 0, 8, asio::use_awaitable)).has_value());
+      expect(proxy.to_client_stats().resets == 1);
+    }));
+
+    modbus::fault_proxy_options truncate{};
+    truncate.to_client.truncate_probability = 1;
+    expect(through_proxy(truncate, [](modbus::client& client, modbus::fault_proxy& proxy) -> asio::awaitable<void> {
+      expect(!(co_await client.read_holding_registers(1, 0, 8, asio::use_awaitable)).has_value());
+      expect(proxy.to_client_stats().truncations == 1);
+      // A new connection through the proxy works again.
+      client.close();
+      auto port = std::to_string(proxy.local_endpoint().port());
+      auto [error] = co_await client.connect("127.0.0.1", port, asio::as_tuple(asio::use_awaitable));
+      expect(!error);
+      expect(proxy.to_client_stats().frames == 1);
+    }));
+
+    // A frame of length 1 ends with the unit, it is passed on whole.
+    modbus::fault_proxy_options truncate_requests{};
+    truncate_requests.to_server.truncate_probability = 1;
+    expect(through_proxy(truncate_requests, [](modbus::client& client, modbus::fault_proxy& proxy) -> asio::awaitable<void> {
+      asio::ip::tcp::socket socket{ client.io_executor() };
+      co_await socket.async_connect(proxy.local_endpoint(), asio::use_awaitable);
+      std::array<std::uint8_t, 7> request{ 0, 1, 0, 0, 0, 1, 1 };
+      co_await asio::async_write(socket, asio::buffer(request), asio::use_awaitable);
+      std::array<std::uint8_t, 9> response{};
+      auto [error, count] = co_await asio::async_read(socket, asio::buffer(response), asio::as_tuple(asio::use_awaitable));
+      expect(!error);
+      expect(response[7] == 0x80 && response[8] == static_cast<std::uint8_t>(modbus::errc::illegal_function));
+      expect(proxy.to_server_stats().frames == 1);
+      expect(proxy.to_server_stats().truncations == 0);
+    }));
+  };
+
+  return 0;
+}
@@ -1,15 +1,63 @@
 #include <array>
+#include <bitset>
+#include <span>
+#include <asio/deferred.hpp>
 #include <modbus/client.hpp>
 #include <modbus/default_handler.hpp>
 #include <modbus/server.hpp>
 
 #include <boost/ut.hpp>
 
+namespace {
+/// Answers holding register reads after a delay depending on the address, and input register reads through a
+/// completion token.
+struct delayed_handler : modbus::default_handler {
+  using modbus::default_handler::handle;
+
+  auto handle(uint8_t unit, modbus::request::read_holding_registers const& req, modbus::errc_t& error)
+      -> asio::awaitable<modbus::response::read_holding_registers> {
+    asio::steady_timer timer{ co_await asio::this_coro::executor };
+    timer.expires_after(std::chrono::milliseconds(req.address == 0 ? 200 : 10));
+    co_await timer.async_wait(asio::use_awaitable);
+    co_return modbus::default_handler::handle(unit, req, error);
+  }
+
+  template <asio::completion_token_for<void(std::expected<modbus::response::read_input_registers, modbus::errc_t>)>
+                completion_token>
+  auto handle(uint8_t unit, modbus::request::read_input_registers const& req, completion_token&& token) {
+    using result_type = std::expected<modbus::response::read_input_registers, modbus::errc_t>;
+    return asio::async_initiate<completion_token, void(result_type)>(
+        [this, unit, req](auto handler) {
+          modbus::errc_t error{};
+          auto resp = modbus::default_handler::handle(unit, req, error);
+          asio::post(asio::get_associated_executor(handler), [handler = std::move(handler), resp]() mutable {
+            std::move(handler)(result_type{ resp });
+          });
+        },
+        token);
+  }
+};
+}  // namespace
+
 int main() {
   using boost::ut::operator""_test;
   using boost::ut::operator|;
   using boost::ut::expect;
 
+  "unsupported function codes are answered with illegal_function"_test = []() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    modbus::tcp_mbap header{ .transaction = 1, .protocol = 0, .length = 5, .unit = 0 };
+    std::array<uint8_t, 4> read_device_identification{ 0x2b, 0x0e, 0x01, 0x00 };
+    auto resp = modbus::handle_request(header, read_device_identification, handler);
+    expect(!resp.has_value());
+    expect(resp.error() == modbus::errc_t::illegal_function);
+
+    std::array<uint8_t, 3> truncated_read{ 0x03, 0x00, 0x00 };
+    resp = modbus::handle_request(header, truncated_read, handler);
+    expect(!resp.has_value());
+    expect(resp.error() == modbus::errc_t::illegal_data_value);
+  };
+
   // Setup a server to use for tests
   int port = 15502;
   asio::io_context ctx;
@@ -67,4 +115,241 @@ int main() {
   };
   ctx.run_for(std::chrono::milliseconds(1500));
   "Finished"_test = [&]() { expect(finished); };
-}
\ No newline at end of file
+  finished = false;
+
+  "borrowed views and decode into caller buffers"_test = [&]() {
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          auto [connect_error] =
+              co_await client.connect("localhost", std::to_string(port), asio::as_tuple(asio::use_awaitable));
+          expect(!connect_error);
+          handler->registers[10] = 1000;
+          handler->registers[11] = 1001;
+          handler->coils[3] = true;
+
+          auto view = co_await client.read_holding_registers_view(0, 10, 2, asio::use_awaitable);
+          expect(view.has_value());
+          expect(view->size() == 2);
+          expect((*view)[0] == 1000) << (*view)[0];
+          expect((*view)[1] == 1001) << (*view)[1];
+
+          std::array<std::uint16_t, 2> words{};
+          auto words_error = co_await client.read_holding_registers(0, 10, std::span(words), asio::use_awaitable);
+          expect(!words_error);
+          expect(words[0] == 1000 && words[1] == 1001);
+
+          std::bitset<5> bits{};
+          auto bits_error = co_await client.read_coils(0, 0, bits, asio::use_awaitable);
+          expect(!bits_error);
+          expect(bits.test(3) && !bits.test(2));
+
+          auto coils_view = co_await client.read_coils_view(0, 0, 5, asio::use_awaitable);
+          expect(coils_view.has_value());
+          expect(coils_view->size() == 5);
+          expect((*coils_view)[3]);
+          finished = true;
+          co_return;
+        },
+        asio::detached);
+  };
+  ctx.run_for(std::chrono::milliseconds(1500));
+  "Finished"_test = [&]() { expect(finished); };
+  finished = false;
+
+  "deferred transactions encode their request when started"_test = [&]() {
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          auto [connect_error] =
+              co_await client.connect("localhost", std::to_string(port), asio::as_tuple(asio::use_awaitable));
+          expect(!connect_error);
+          handler->registers[20] = 20;
+          handler->registers[21] = 21;
+
+          auto first = client.read_holding_registers(0, 20, 1, asio::deferred);
+          auto second = client.read_holding_registers(0, 21, 1, asio::deferred);
+          auto second_res = co_await std::move(second)(asio::use_awaitable);
+          auto first_res = co_await std::move(first)(asio::use_awaitable);
+          expect(second_res.has_value() && second_res->values[0] == 21);
+          expect(first_res.has_value() && first_res->values[0] == 20);
+          finished = true;
+          co_return;
+        },
+        asio::detached);
+  };
+  ctx.run_for(std::chrono::milliseconds(1500));
+  "Finished"_test = [&]() { expect(finished); };
+  finished = false;
+
+  "idle connections are evicted and drain closes connections"_test = [&]() {
+    int limited_port = 15503;
+    modbus::server limited{ ctx, handler, limited_port, modbus::server_options{ .max_connections = 1 } };
+    limited.start();
+    modbus::client first{ ctx };
+    modbus::client second{ ctx };
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          auto [first_error] =
+              co_await first.connect("localhost", std::to_string(limited_port), asio::as_tuple(asio::use_awaitable));
+          expect(!first_error);
+          expect((co_await first.read_holding_registers(0, 0, 1, asio::use_awaitable)).has_value());
+
+          // The registry is full, the idle first connection makes room for the second one.
+          auto [second_error] =
+              co_await second.connect("localhost", std::to_string(limited_port), asio::as_tuple(asio::use_awaitable));
+          expect(!second_error);
+          expect((co_await second.read_holding_registers(0, 0, 1, asio::use_awaitable)).has_value());
+          expect(limited.connections() == 1);
+          expect(!(co_await first.read_holding_registers(0, 0, 1, asio::use_awaitable)).has_value());
+
+          co_await limited.drain(asio::use_awaitable);
+          expect(limited.connections() == 0);
+          expect(!(co_await second.read_holding_registers(0, 0, 1, asio::use_awaitable)).has_value());
+          finished = true;
+          co_return;
+        },
+        asio::detached);
+    ctx.run_for(std::chrono::milliseconds(1500));
+  };
+  "Finished"_test = [&]() { expect(finished); };
+  finished = false;
+
+  "asynchronous handlers answer out of order"_test = [&]() {
+    int async_port = 15504;
+    auto async_handler = std::make_shared<delayed_handler>();
+    async_handler->registers[1] = 11;
+    async_handler->input_registers[2] = 22;
+    modbus::server async_server{ ctx, async_handler, async_port };
+    async_server.start();
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          asio::ip::tcp::socket socket{ ctx };
+          co_await socket.async_connect({ asio::ip::make_address("127.0.0.1"), static_cast<uint16_t>(async_port) },
+                                        asio::use_awaitable);
+          // Transaction 1 waits 200ms, transaction 2 waits 10ms and transaction 3 is answered right away.
+          std::array<uint8_t, 36> requests{ 0, 1, 0, 0, 0, 6, 0, 0x03, 0, 0, 0, 1,  //
+                                            0, 2, 0, 0, 0, 6, 0, 0x03, 0, 1, 0, 1,  //
+                                            0, 3, 0, 0, 0, 6, 0, 0x04, 0, 2, 0, 1 };
+          co_await asio::async_write(socket, asio::buffer(requests), asio::use_awaitable);
+
+          std::array<uint8_t, 11> response{};
+          co_await asio::async_read(socket, asio::buffer(response), asio::use_awaitable);
+          expect(response[1] == 3);
+          expect(response[10] == 22);
+          co_await asio::async_read(socket, asio::buffer(response), asio::use_awaitable);
+          expect(response[1] == 2);
+          expect(response[10] == 11);
+          expect(async_server.in_flight() == 1);
+          co_await asio::async_read(socket, asio::buffer(response), asio::use_awaitable);
+          expect(response[1] == 1);
+          expect(async_server.in_flight() == 0);
+          finished = true;
+        },
+        asio::detached);
+    ctx.run_for(std::chrono::milliseconds(1500));
+  };
+  "Finished"_test = [&]() { expect(finished); };
+  finished = false;
+
+  "requests without a function code are answered with illegal_function"_test = [&]() {
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          asio::ip::tcp::socket socket{ ctx };
+          co_await socket.async_connect({ asio::ip::make_address("127.0.0.1"), static_cast<uint16_t>(port) },
+                                        asio::use_awaitable);
+          std::array<uint8_t, 7> empty_request{ 0, 1, 0, 0, 0, 0, 0 };
+          co_await asio::async_write(socket, asio::buffer(empty_request), asio::use_awaitable);
+          std::array<uint8_t, 9> response{};
+          co_await asio::async_read(socket, asio::buffer(response), asio::use_awaitable);
+          expect(response[7] == 0x80);
+          expect(response[8] == modbus::errc::illegal_function);
+          finished = true;
+        },
+        asio::detached);
+    ctx.run_for(std::chrono::milliseconds(1500));
+  };
+  "Finished"_test = [&]() { expect(finished); };
+  finished = false;
+
+  "connections served without a server answer requests in flight after the peer stops sending"_test = [&]() {
+    int standalone_port = 15505;
+    auto async_handler = std::make_shared<delayed_handler>();
+    async_handler->registers[0] = 7;
+    asio::ip::tcp::acceptor acceptor{ ctx, { asio::ip::tcp::v4(), static_cast<uint16_t>(standalone_port) } };
+    bool served = false;
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+          co_await modbus::handle_connection(std::move(socket), async_handler);
+          served = true;
+        },
+        asio::detached);
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          asio::ip::tcp::socket socket{ ctx };
+          co_await socket.async_connect({ asio::ip::make_address("127.0.0.1"), static_cast<uint16_t>(standalone_port) },
+                                        asio::use_awaitable);
+          // Answered after 200ms, the connection reads end of stream long before that.
+          std::array<uint8_t, 12> request{ 0, 1, 0, 0, 0, 6, 0, 0x03, 0, 0, 0, 1 };
+          co_await asio::async_write(socket, asio::buffer(request), asio::use_awaitable);
+          socket.shutdown(asio::ip::tcp::socket::shutdown_send);
+
+          std::array<uint8_t, 11> response{};
+          co_await asio::async_read(socket, asio::buffer(response), asio::use_awaitable);
+          expect(response[1] == 1);
+          expect(response[10] == 7);
+          finished = true;
+        },
+        asio::detached);
+    ctx.run_for(std::chrono::milliseconds(1500));
+    expect(served);
+  };
+  "Finished"_test = [&]() { expect(finished); };
+  finished = false;
+
+  "oversized requests are refused and malformed responses close the connection"_test = [&]() {
+    int malformed_port = 15506;
+    asio::ip::tcp::acceptor acceptor{ ctx, { asio::ip::tcp::v4(), static_cast<uint16_t>(malformed_port) } };
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+          std::array<uint8_t, 12> request{};
+          co_await asio::async_read(socket, asio::buffer(request), asio::use_awaitable);
+          // The length of the MBAP header does not even cover the unit.
+          std::array<uint8_t, 7> response{ request[0], request[1], 0, 0, 0, 0, 0 };
+          co_await asio::async_write(socket, asio::buffer(response), asio::use_awaitable);
+          asio::steady_timer linger{ ctx, std::chrono::milliseconds(500) };
+          co_await linger.async_wait(asio::as_tuple(asio::use_awaitable));
+        },
+        asio::detached);
+    co_spawn(
+        ctx,
+        [&]() mutable -> asio::awaitable<void> {
+          modbus::client malformed{ ctx };
+          auto [connect_error] =
+              co_await malformed.connect("localhost", std::to_string(malformed_port), asio::as_tuple(asio::use_awaitable));
+          expect(!connect_error);
+          // 200 registers take 400 bytes, more than a PDU holds. Nothing is sent, the connection stays usable.
+          auto oversized = co_await malformed.write_multiple_registers(0, 0, std::vector<uint16_t>(200),
+                                                                       asio::use_awaitable);
+          expect(!oversized.has_value() &&
+                 oversized.error() == modbus::modbus_error(modbus::errc::message_size_mismatch));
+          expect(malformed.is_connected());
+
+          auto res = co_await malformed.read_holding_registers(0, 0, 1, asio::use_awaitable);
+          expect(!res.has_value() && res.error() == modbus::modbus_error(modbus::errc::message_size_mismatch));
+          expect(!malformed.is_connected());
+          finished = true;
+        },
+        asio::detached);
+    ctx.run_for(std::chrono::milliseconds(1500));
+  };
+  "Finished"_test = [&]() { expect(finished); };
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <modbus/logger.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+/// Sink collecting the formatted lines.
+struct collector {
+  std::mutex mutex;
+  std::vector<std::string> lines;
+
+  auto sink() -> modbus::logger::sink_type {
+    return [this](modbus::log_record const&, std::string_view line) {
+      std::lock_guard lock{ mutex };
+      lines.emplace_back(line);
+    };
+  }
+};
+}  // namespace
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "records are formatted by the sink"_test = []() {
+    collector lines;
+    modbus::logger log{ lines.sink() };
+    asio::ip::tcp::endpoint endpoint{ asio::ip::make_address("127.0.0.1"), 502 };
+    log.log<modbus::log_level::warning>(modbus::log_category::request, "request length too large", endpoint, 300);
+    log.log<modbus::log_level::error>(modbus::log_category::accept, "accept failed", {}, 0,
+                                      std::make_error_code(std::errc::too_many_files_open));
+    log.flush();
+    expect(lines.lines.size() == 2);
+    expect(lines.lines[0] == "[warning] request length too large client: 127.0.0.1:502 300");
+    expect(lines.lines[1].starts_with("[error] accept failed error: "));
+  };
+
+  "records below the level are discarded"_test = []() {
+    collector lines;
+    modbus::logger log{ lines.sink() };
+    log.set_level(modbus::log_level::warning);
+    log.log<modbus::log_level::info>(modbus::log_category::connection, "timeout");
+    log.log<modbus::log_level::debug>(modbus::log_category::connection, "timeout");
+    log.flush();
+    expect(lines.lines.empty());
+  };
+
+  "categories are rate limited"_test = []() {
+    collector lines;
+    modbus::logger log{ lines.sink(), modbus::logger::options{ .rate_limit = 10 } };
+    for (int i = 0; i < 50; ++i) {
+      log.log<modbus::log_level::warning>(modbus::log_category::request, "exception response");
+    }
+    log.log<modbus::log_level::warning>(modbus::log_category::accept, "refusing client, busy connections");
+    log.flush();
+    // Unless the second changed while logging, 10 requests, the accept record and the summary
+    expect(lines.lines.size() >= 12 && lines.lines.size() <= 22);
+    expect(lines.lines.back().starts_with("[warning] rate limit suppressed records"));
+  };
+
+  "full rings drop records"_test = []() {
+    collector lines;
+    modbus::logger log{ lines.sink(), modbus::logger::options{ .ring_size = 4, .flush_interval = std::chrono::hours{ 1 },
+                                                                .rate_limit = 0 } };
+    for (int i = 0; i < 6; ++i) {
+      log.log<modbus::log_level::info>(modbus::log_category::connection, "timeout");
+    }
+    expect(log.dropped() == 2);
+    log.flush();
+    expect(lines.lines.size() == 4);
+  };
+
+  "threads log to their own rings"_test = []() {
+    collector lines;
+    {
+      modbus::logger log{ lines.sink(), modbus::logger::options{ .rate_limit = 0 } };
+      std::vector<std::thread> threads;
+      for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&log]() {
+          for (int i = 0; i < 100; ++i) {
+            log.log<modbus::log_level::info>(modbus::log_category::connection, "timeout");
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    }
+    // The destructor writes what is left
+    expect(lines.lines.size() == 400);
+  };
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <modbus/client.hpp>
+#include <modbus/default_handler.hpp>
+#include <modbus/metrics.hpp>
+#include <modbus/server.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+  using std::chrono_literals::operator""ns;
+  using std::chrono_literals::operator""us;
+
+  "histogram buckets bound their values within 12.5%"_test = []() {
+    using modbus::histogram_snapshot;
+    for (std::uint64_t value : { 0UL, 1UL, 7UL, 8UL, 9UL, 15UL, 16UL, 1000UL, 123456789UL, ~0UL }) {
+      auto index = histogram_snapshot::bucket(value);
+      expect(index < histogram_snapshot::bucket_count);
+      auto bound = histogram_snapshot::upper_bound(index);
+      expect(bound >= value);
+      expect(bound - value <= value / 8);
+    }
+    expect(histogram_snapshot::bucket(8) == 8);
+    expect(histogram_snapshot::bucket(15) == 15);
+    expect(histogram_snapshot::bucket(16) == 16);
+    expect(histogram_snapshot::upper_bound(histogram_snapshot::bucket_count - 1) == ~0UL);
+  };
+
+  "percentiles come from the bucket bounds"_test = []() {
+    modbus::metrics registry{ 1 };
+    expect(registry.snapshot().round_trip.percentile(0.5) == 0ns);
+    for (int i = 0; i < 99; ++i) {
+      registry.round_trip(100us);
+    }
+    registry.round_trip(std::chrono::milliseconds{ 10 });
+    auto round_trip = registry.snapshot().round_trip;
+    expect(round_trip.count() == 100);
+    expect(round_trip.percentile(0.5) >= 100us);
+    expect(round_trip.percentile(0.5) < 113us);
+    expect(round_trip.percentile(1.0) >= std::chrono::milliseconds{ 10 });
+  };
+
+  "counters recorded on many threads add up on snapshot"_test = []() {
+    modbus::metrics registry{ 4 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+      threads.emplace_back([&registry]() {
+        for (int i = 0; i < 10000; ++i) {
+          registry.request(3);
+          registry.add(modbus::metric::bytes_in, 12);
+          registry.add(modbus::metric::in_flight);
+          registry.add(modbus::metric::in_flight, -1);
+        }
+        registry.exception(2);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto snapshot = registry.snapshot();
+    expect(snapshot.requests[3] == 80000);
+    expect(snapshot.exceptions[2] == 8);
+    expect(snapshot[modbus::metric::bytes_in] == 960000);
+    expect(snapshot[modbus::metric::in_flight] == 0);
+  };
+
+  "client and server count the same transactions"_test = []() {
+    asio::io_context ctx;
+    int port = 15510;
+    auto server_metrics = std::make_shared<modbus::metrics>();
+    auto client_metrics = std::make_shared<modbus::metrics>();
+    auto handler = std::make_shared<modbus::default_handler>();
+    modbus::server server{ ctx, handler, port, modbus::server_options{ .metrics = server_metrics } };
+    server.start();
+    modbus::client client{ ctx };
+    client.set_metrics(client_metrics);
+    bool finished = false;
+    co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+          auto [error] = co_await client.connect("localhost", std::to_string(port), asio::as_tuple(asio::use_awaitable));
+          expect(!error);
+          expect((co_await client.read_holding_registers(1, 0, 4, asio::use_awaitable)).has_value());
+          expect((co_await client.write_single_register(1, 0, 42, asio::use_awaitable)).has_value());
+          expect(!(co_await client.read_holding_registers(1, 65535, 100, asio::use_awaitable)).has_value());
+          finished = true;
+        },
+        asio::detached);
+    ctx.run_for(std::chrono::milliseconds(500));
+    expect(finished);
+
+    auto served = server_metrics->snapshot();
+    auto sent = client_metrics->snapshot();
+    expect(served.requests[3] == 2);
+    expect(served.requests[6] == 1);
+    expect(sent.requests == served.requests);
+    expect(served.exceptions[2] == 1);
+    expect(sent.exceptions == served.exceptions);
+    expect(served[modbus::metric::connections] == 1);
+    expect(served[modbus::metric::in_flight] == 0);
+    expect(served[modbus::metric::bytes_in] == sent[modbus::metric::bytes_out]);
+    expect(served[modbus::metric::bytes_out] == sent[modbus::metric::bytes_in]);
+    expect(served[modbus::metric::bytes_in] == 3 * 12);
+    expect(sent.round_trip.count() == 3);
+  };
+
+  return 0;
+}
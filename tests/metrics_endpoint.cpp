@@ -0,0 +1,86 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <asio/io_context.hpp>
+#include <asio/read.hpp>
+
+#include <modbus/metrics_endpoint.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+/// Send request to the endpoint the way curl would and read the response until the server closes.
+auto scrape(modbus::metrics_endpoint const& endpoint, std::string request) -> std::string {
+  asio::io_context ctx;
+  asio::ip::tcp::socket socket{ ctx };
+  socket.connect(asio::ip::tcp::endpoint{ asio::ip::make_address("127.0.0.1"), endpoint.local_endpoint().port() });
+  asio::write(socket, asio::buffer(request));
+  std::string response;
+  asio::error_code error;
+  asio::read(socket, asio::dynamic_buffer(response), error);
+  return response;
+}
+}  // namespace
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "snapshots are written in the OpenMetrics text format"_test = []() {
+    modbus::metrics registry{ 1 };
+    registry.request(3);
+    registry.request(3);
+    registry.request(16);
+    registry.exception(2);
+    registry.add(modbus::metric::bytes_in, 24);
+    registry.add(modbus::metric::in_flight, 3);
+    registry.round_trip(std::chrono::microseconds{ 3 });
+    registry.round_trip(std::chrono::milliseconds{ 1 });
+    std::string text;
+    modbus::write_openmetrics(registry.snapshot(), text);
+
+    expect(text.contains("modbus_requests_total{function=\"3\"} 2\n"));
+    expect(text.contains("modbus_requests_total{function=\"16\"} 1\n"));
+    expect(!text.contains("function=\"4\""));
+    expect(text.contains("modbus_exceptions_total{code=\"2\"} 1\n"));
+    expect(text.contains("modbus_received_bytes_total 24\n"));
+    expect(text.contains("modbus_sent_bytes_total 0\n"));
+    expect(text.contains("modbus_in_flight 3\n"));
+    expect(text.contains("modbus_round_trip_seconds_bucket{le=\"1.024e-06\"} 0\n"));
+    expect(text.contains("modbus_round_trip_seconds_bucket{le=\"4.096e-06\"} 1\n"));
+    expect(text.contains("modbus_round_trip_seconds_bucket{le=\"0.001048576\"} 2\n"));
+    expect(text.contains("modbus_round_trip_seconds_bucket{le=\"+Inf\"} 2\n"));
+    expect(text.contains("modbus_round_trip_seconds_count 2\n"));
+    expect(text.ends_with("# EOF\n"));
+  };
+
+  "the endpoint answers scrapes over loopback"_test = []() {
+    asio::io_context ctx;
+    auto registry = std::make_shared<modbus::metrics>();
+    registry->add(modbus::metric::connections, 7);
+    modbus::metrics_endpoint endpoint{ ctx, registry,
+                                       asio::ip::tcp::endpoint{ asio::ip::make_address("127.0.0.1"), 0 } };
+    endpoint.start();
+    std::thread runner{ [&ctx]() { ctx.run_for(std::chrono::seconds{ 2 }); } };
+
+    auto metrics = scrape(endpoint, "GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n");
+    expect(metrics.starts_with("HTTP/1.1 200 OK\r\n"));
+    expect(metrics.contains("Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"));
+    expect(metrics.contains("\r\n\r\n# TYPE modbus_requests counter\n"));
+    expect(metrics.contains("modbus_connections_total 7\n"));
+    expect(metrics.ends_with("# EOF\n"));
+    auto body = metrics.substr(metrics.find("\r\n\r\n") + 4);
+    expect(metrics.contains("Content-Length: " + std::to_string(body.size()) + "\r\n"));
+
+    expect(scrape(endpoint, "GET / HTTP/1.1\r\n\r\n").starts_with("HTTP/1.1 404 Not Found\r\n"));
+    expect(scrape(endpoint, "POST /metrics HTTP/1.1\r\n\r\n").starts_with("HTTP/1.1 405 Method Not Allowed\r\n"));
+
+    asio::post(ctx, [&endpoint]() { endpoint.stop(); });
+    runner.join();
+  };
+
+  return 0;
+}
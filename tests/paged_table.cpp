@@ -0,0 +1,57 @@
+#include <array>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <modbus/paged_table.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "pages are allocated on write"_test = []() {
+    modbus::paged_table<std::uint16_t> table;
+    expect(table.allocated_pages() == 0);
+    expect(std::as_const(table)[1000] == 0);
+    expect(table.allocated_pages() == 0);
+    table[1000] = 42;
+    table[1001] = 43;
+    expect(table.allocated_pages() == 1);
+    table[0xffff] = 44;
+    expect(table.allocated_pages() == 2);
+    expect(std::as_const(table)[0xffff] == 44);
+  };
+
+  "bulk copies cross page boundaries"_test = []() {
+    modbus::paged_table<std::uint16_t> table;
+    std::vector<std::uint16_t> values{ 1, 2, 3, 4, 5, 6 };
+    expect(table.write(253, values) == modbus::errc::no_error);
+    expect(table.allocated_pages() == 2);
+    std::vector<std::uint16_t> read;
+    expect(table.read(252, 8, std::back_inserter(read)) == modbus::errc::no_error);
+    expect(read == std::vector<std::uint16_t>{ 0, 1, 2, 3, 4, 5, 6, 0 });
+  };
+
+  "ranges beyond the address space are rejected"_test = []() {
+    modbus::paged_table<bool> table;
+    std::vector<bool> read;
+    expect(table.read(0xfff0, 16, std::back_inserter(read)) == modbus::errc::no_error);
+    expect(table.read(0xfff0, 17, std::back_inserter(read)) == modbus::errc::illegal_data_address);
+    expect(table.write(0xffff, std::array{ true, true }) == modbus::errc::illegal_data_address);
+  };
+
+  "absent and read only pages"_test = []() {
+    modbus::paged_table<std::uint16_t> table;
+    table.set_flags(0x100, 0x100, modbus::page_flags::absent);
+    table.set_flags(0x200, 1, modbus::page_flags::read_only);
+    std::vector<std::uint16_t> read;
+    expect(table.read(0xf0, 0x20, std::back_inserter(read)) == modbus::errc::illegal_data_address);
+    expect(read.empty());
+    expect(table.write(0x150, std::array<std::uint16_t, 1>{ 1 }) == modbus::errc::illegal_data_address);
+    expect(table.read(0x200, 4, std::back_inserter(read)) == modbus::errc::no_error);
+    expect(table.write(0x2ff, std::array<std::uint16_t, 1>{ 1 }) == modbus::errc::illegal_data_address);
+    expect(table.write(0x300, std::array<std::uint16_t, 1>{ 1 }) == modbus::errc::no_error);
+  };
+}
@@ -0,0 +1,48 @@
+#include <thread>
+#include <vector>
+
+#include <modbus/recycling_allocator.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "released blocks are reused"_test = []() {
+    auto& pool = modbus::recycling_pool::this_thread();
+    auto before = pool.stats();
+    void* first = pool.allocate(100, alignof(std::max_align_t));
+    pool.deallocate(first, 100, alignof(std::max_align_t));
+    // Same size class, 100 and 128 bytes both use the 128 byte blocks.
+    void* second = pool.allocate(128, alignof(std::max_align_t));
+    expect(first == second);
+    pool.deallocate(second, 128, alignof(std::max_align_t));
+    auto after = pool.stats();
+    expect(after.misses - before.misses == 1);
+    expect(after.hits - before.hits == 1);
+  };
+
+  "large allocations bypass the pool"_test = []() {
+    auto& pool = modbus::recycling_pool::this_thread();
+    auto before = pool.stats();
+    void* block = pool.allocate(modbus::recycling_pool::max_block_size + 1, alignof(std::max_align_t));
+    pool.deallocate(block, modbus::recycling_pool::max_block_size + 1, alignof(std::max_align_t));
+    expect(pool.stats().cached == before.cached);
+  };
+
+  "pools are per thread"_test = []() {
+    auto* main_pool = &modbus::recycling_pool::this_thread();
+    modbus::recycling_pool* other_pool = nullptr;
+    std::thread{ [&]() { other_pool = &modbus::recycling_pool::this_thread(); } }.join();
+    expect(main_pool != other_pool);
+  };
+
+  "allocator works with standard containers"_test = []() {
+    std::vector<int, modbus::recycling_allocator<int>> values;
+    for (int i = 0; i < 100; ++i) {
+      values.push_back(i);
+    }
+    expect(values[99] == 99);
+  };
+}
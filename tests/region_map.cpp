@@ -0,0 +1,107 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <modbus/region_handler.hpp>
+#include <modbus/region_map.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  using map_t = modbus::region_map<std::uint16_t>;
+
+  /// Region returning its address plus offset.
+  auto counting = [](std::uint16_t offset) {
+    return [offset](std::uint16_t address, std::size_t count, map_t::values::iterator out) {
+      for (std::size_t i = 0; i < count; ++i) {
+        *out++ = static_cast<std::uint16_t>(address + i + offset);
+      }
+      return modbus::errc_t{ modbus::errc::no_error };
+    };
+  };
+
+  "overlapping regions are rejected"_test = [&]() {
+    map_t map;
+    expect(map.add(10, 20, counting(0)));
+    expect(!map.add(15, 25, counting(0)));
+    expect(!map.add(5, 11, counting(0)));
+    expect(!map.add(12, 13, counting(0)));
+    expect(!map.add(30, 30, counting(0)));
+    expect(!map.add(0xfff0, 0x10001, counting(0)));
+    expect(map.add(20, 30, counting(0)));
+    expect(map.add(0, 10, counting(0)));
+    expect(map.size() == 3);
+  };
+
+  "reads span adjacent regions"_test = [&]() {
+    map_t map;
+    map.add(0, 4, counting(0));
+    map.add(4, 8, counting(100));
+    map_t::values values;
+    expect(map.read(2, 4, values) == modbus::errc::no_error);
+    expect(values == map_t::values{ 2, 3, 104, 105 });
+  };
+
+  "unmapped addresses are answered with illegal_data_address"_test = [&]() {
+    map_t map;
+    map.add(0, 4, counting(0));
+    map.add(6, 8, counting(0));
+    map_t::values values;
+    expect(map.read(2, 6, values) == modbus::errc::illegal_data_address);
+    expect(map.read(4, 1, values) == modbus::errc::illegal_data_address);
+    expect(map.read(8, 1, values) == modbus::errc::illegal_data_address);
+    expect(map.read(6, 2, values) == modbus::errc::no_error);
+  };
+
+  "writes need a write callback for every region"_test = [&]() {
+    map_t map;
+    std::vector<std::uint16_t> stored(8);
+    map.add(0, 4, counting(0), [&](std::uint16_t address, map_t::values::const_iterator in, std::size_t count) {
+      std::copy_n(in, count, stored.begin() + address);
+      return modbus::errc_t{ modbus::errc::no_error };
+    });
+    map.add(4, 8, counting(0));
+    expect(map.write(1, { 5, 6, 7, 8 }) == modbus::errc::illegal_data_address);
+    expect(stored == std::vector<std::uint16_t>(8));
+    expect(map.write(1, { 5, 6, 7 }) == modbus::errc::no_error);
+    expect(stored == std::vector<std::uint16_t>{ 0, 5, 6, 7, 0, 0, 0, 0 });
+  };
+
+  "callback errors are passed on"_test = []() {
+    map_t map;
+    map.add(0, 1, [](std::uint16_t, std::size_t, map_t::values::iterator) {
+      return modbus::errc_t{ modbus::errc::server_device_failure };
+    });
+    map_t::values values;
+    expect(map.read(0, 1, values) == modbus::errc::server_device_failure);
+  };
+
+  "the handler answers requests from regions"_test = []() {
+    modbus::region_handler handler;
+    std::uint16_t stored = 0x00f0;
+    handler.registers.add(
+        100, 101,
+        [&](std::uint16_t, std::size_t, map_t::values::iterator out) {
+          *out = stored;
+          return modbus::errc_t{ modbus::errc::no_error };
+        },
+        [&](std::uint16_t, map_t::values::const_iterator in, std::size_t) {
+          stored = *in;
+          return modbus::errc_t{ modbus::errc::no_error };
+        });
+    modbus::errc_t error = modbus::errc::no_error;
+    handler.handle(0, modbus::request::mask_write_register{ 100, 0x00ff, 0x0f00 }, error);
+    expect(!error);
+    expect(stored == 0x0ff0);
+    auto response = handler.handle(0, modbus::request::read_holding_registers{ 100, 1 }, error);
+    expect(!error);
+    expect(response.values == std::vector<std::uint16_t>{ 0x0ff0 });
+    handler.handle(0, modbus::request::read_coils{ 0, 1 }, error);
+    expect(error == modbus::errc::illegal_data_address);
+  };
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <modbus/default_handler.hpp>
+#include <modbus/response_cache.hpp>
+#include <modbus/unit_router.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  using cache_t = modbus::response_cache<modbus::default_handler>;
+
+  auto read = [](auto& cache, std::uint8_t unit, std::uint16_t address, std::uint16_t count) {
+    modbus::errc_t error = modbus::errc::no_error;
+    auto resp = cache.handle(unit, modbus::request::read_holding_registers{ address, count }, error);
+    return std::pair{ error, resp.serialize() };
+  };
+
+  "repeated reads are answered from the cache"_test = [&]() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    handler->registers[10] = 42;
+    cache_t cache{ handler };
+    auto [error, first] = read(cache, 1, 10, 2);
+    expect(!error);
+    expect(first == std::vector<std::uint8_t>{ 0x03, 0x04, 0x00, 42, 0x00, 0x00 });
+    handler->registers[10] = 43;
+    expect(read(cache, 1, 10, 2).second == first);
+    expect(cache.hits() == 1 && cache.misses() == 1);
+    expect(read(cache, 2, 10, 2).second != first);
+    expect(cache.misses() == 2);
+  };
+
+  "writes drop overlapping ranges"_test = [&]() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    cache_t cache{ handler };
+    read(cache, 1, 0, 10);
+    read(cache, 1, 20, 10);
+    read(cache, 2, 0, 10);
+    expect(cache.size() == 3);
+    modbus::errc_t error = modbus::errc::no_error;
+    cache.handle(1, modbus::request::write_single_register{ 9, 7 }, error);
+    expect(cache.size() == 1);
+    expect(read(cache, 1, 0, 10).second[2 + 19] == 7);
+    cache.handle(0, modbus::request::write_multiple_registers{ 5, std::vector<std::uint16_t>{ 1, 2 } }, error);
+    expect(cache.size() == 1);
+  };
+
+  "writes to one unit drop the ranges of every unit sharing the data"_test = [&]() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    cache_t cache{ handler };
+    read(cache, 1, 0, 10);
+    modbus::errc_t error = modbus::errc::no_error;
+    cache.handle(2, modbus::request::write_single_register{ 3, 9 }, error);
+    expect(cache.size() == 0);
+    expect(read(cache, 1, 0, 10).second[2 + 7] == 9);
+  };
+
+  "writes to one routed unit keep the ranges of the other units"_test = [&]() {
+    using router_t = modbus::unit_router<modbus::default_handler>;
+    auto router = std::make_shared<router_t>();
+    router->add(1, std::make_shared<modbus::default_handler>());
+    router->add(2, std::make_shared<modbus::default_handler>());
+    modbus::response_cache<router_t> cache{ router };
+    read(cache, 1, 0, 10);
+    read(cache, 2, 0, 10);
+    modbus::errc_t error = modbus::errc::no_error;
+    cache.handle(2, modbus::request::write_single_register{ 3, 9 }, error);
+    expect(cache.size() == 1);
+    expect(read(cache, 2, 0, 10).second[2 + 7] == 9);
+    expect(read(cache, 1, 0, 10).second[2 + 7] == 0);
+  };
+
+  "failed reads are not cached"_test = [&]() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    handler->registers.set_flags(0, 1, modbus::page_flags::absent);
+    cache_t cache{ handler };
+    expect(read(cache, 1, 0, 1).first == modbus::errc::illegal_data_address);
+    expect(cache.size() == 0);
+  };
+
+  "version bumps make entries stale"_test = [&]() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    cache_t cache{ handler };
+    auto first = read(cache, 1, 0, 1).second;
+    handler->registers[0] = 1;
+    handler->bump_version();
+    expect(read(cache, 1, 0, 1).second != first);
+    expect(cache.hits() == 0);
+  };
+
+  "stores into atomic groups make entries stale"_test = [&]() {
+    auto handler = std::make_shared<modbus::default_handler>();
+    expect(handler->register_groups.declare(4, 2));
+    cache_t cache{ handler };
+    expect(read(cache, 1, 4, 2).second == std::vector<std::uint8_t>{ 0x03, 4, 0, 0, 0, 0 });
+    handler->register_groups.store<std::uint32_t>(4, 0x12345678);
+    expect(read(cache, 1, 4, 2).second == std::vector<std::uint8_t>{ 0x03, 4, 0x12, 0x34, 0x56, 0x78 });
+    expect(cache.hits() == 0);
+  };
+
+  "the server answers from the cache"_test = []() {
+    auto router = std::make_shared<modbus::unit_router<modbus::default_handler>>();
+    router->add(1, std::make_shared<modbus::default_handler>());
+    auto cache = std::make_shared<modbus::response_cache<modbus::unit_router<modbus::default_handler>>>(router);
+    auto pdu = modbus::request::read_coils{ 0, 8 }.serialize();
+    modbus::tcp_mbap header{ .transaction = 1, .protocol = 0, .length = 6, .unit = 1 };
+    auto first = modbus::handle_request(header, pdu, cache);
+    auto second = modbus::handle_request(header, pdu, cache);
+    expect(first.has_value() && first == second);
+    expect(cache->hits() == 1);
+    expect(!cache->responds(0));
+  };
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <asio/io_context.hpp>
+
+#include <modbus/timer_wheel.hpp>
+
+#include <boost/ut.hpp>
+
+namespace {
+struct counting_entry final : modbus::timer_wheel::entry {
+  void expire() override { ++expired; }
+  int expired{};
+};
+}  // namespace
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+  using boost::ut::throws;
+  using std::chrono_literals::operator""s;
+
+  asio::io_context ctx;
+
+  "entries expire after the timeout"_test = [&]() {
+    modbus::timer_wheel wheel{ ctx.get_executor(), 10s, 1s };
+    counting_entry node;
+    wheel.add(node);
+    for (int i = 0; i < 9; ++i) {
+      wheel.advance();
+    }
+    expect(node.expired == 0);
+    wheel.advance();
+    expect(node.expired == 1);
+    expect(!node.scheduled());
+    expect(wheel.size() == 0);
+  };
+
+  "touch postpones expiry"_test = [&]() {
+    modbus::timer_wheel wheel{ ctx.get_executor(), 10s, 1s };
+    counting_entry node;
+    wheel.add(node);
+    for (int i = 0; i < 8; ++i) {
+      wheel.advance();
+    }
+    node.touch();
+    for (int i = 0; i < 9; ++i) {
+      wheel.advance();
+    }
+    expect(node.expired == 0);
+    wheel.advance();
+    expect(node.expired == 1);
+  };
+
+  "timeouts beyond the first level cascade"_test = [&]() {
+    modbus::timer_wheel wheel{ ctx.get_executor(), 300s, 1s };
+    counting_entry node;
+    wheel.add(node);
+    for (int i = 0; i < 299; ++i) {
+      wheel.advance();
+    }
+    expect(node.expired == 0);
+    wheel.advance();
+    expect(node.expired == 1);
+  };
+
+  "removed and destroyed entries never expire"_test = [&]() {
+    modbus::timer_wheel wheel{ ctx.get_executor(), 2s, 1s };
+    std::vector<counting_entry> nodes(100);
+    for (auto& node : nodes) {
+      wheel.add(node);
+    }
+    wheel.remove(nodes.front());
+    {
+      counting_entry temporary;
+      wheel.add(temporary);
+    }
+    expect(wheel.size() == 99);
+    wheel.advance();
+    wheel.advance();
+    expect(nodes.front().expired == 0);
+    expect(nodes.back().expired == 1);
+    expect(wheel.size() == 0);
+  };
+
+  "zero timeouts expire on the next tick and invalid durations are refused"_test = [&]() {
+    modbus::timer_wheel wheel{ ctx.get_executor(), 0s, 1s };
+    counting_entry node;
+    wheel.add(node);
+    wheel.advance();
+    expect(node.expired == 1);
+
+    expect(throws<std::invalid_argument>([&]() { modbus::timer_wheel{ ctx.get_executor(), 10s, 0s }; }));
+    expect(throws<std::invalid_argument>([&]() { modbus::timer_wheel{ ctx.get_executor(), 10s, -1s }; }));
+    expect(throws<std::invalid_argument>([&]() { modbus::timer_wheel{ ctx.get_executor(), -1s, 1s }; }));
+  };
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <modbus/client.hpp>
+#include <modbus/default_handler.hpp>
+#include <modbus/server.hpp>
+#include <modbus/tracing.hpp>
+
+#include <boost/ut.hpp>
+
+// The no-op policy takes no space in the client or the server.
+static_assert(sizeof(modbus::client) < sizeof(modbus::basic_client<modbus::buffer_tracing>));
+static_assert(sizeof(modbus::server<modbus::default_handler>) <
+              sizeof(modbus::server<modbus::default_handler, modbus::buffer_tracing>));
+
+namespace {
+auto points_of(std::vector<modbus::trace_event> const& events, modbus::trace_side side)
+    -> std::vector<modbus::trace_point> {
+  std::vector<modbus::trace_point> points;
+  for (auto const& event : events) {
+    if (event.side == side) {
+      points.push_back(event.point);
+    }
+  }
+  return points;
+}
+}  // namespace
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+  using modbus::trace_point;
+
+  "events are dropped once the buffer is full"_test = []() {
+    modbus::trace_buffer buffer{ 2 };
+    for (int i = 0; i < 3; ++i) {
+      buffer.record({ i, { 1, 2, 3, 4 }, modbus::trace_side::client, trace_point::write_start });
+    }
+    expect(buffer.events().size() == 2);
+    expect(buffer.dropped() == 1);
+  };
+
+  "steps become spans from the previous step of the transaction"_test = []() {
+    std::vector<modbus::trace_event> events{
+      { 1000, { 40000, 7, 1, 3 }, modbus::trace_side::client, trace_point::write_start },
+      { 3500, { 40000, 7, 1, 3 }, modbus::trace_side::client, trace_point::write_finish },
+      { 2000, { 40000, 8, 1, 3 }, modbus::trace_side::client, trace_point::write_start },
+    };
+    std::string json;
+    modbus::write_chrome_trace(events, json);
+    expect(json.starts_with("{\"traceEvents\":["));
+    expect(json.contains("{\"name\":\"write_start\",\"cat\":\"client\",\"ph\":\"i\",\"s\":\"t\",\"ts\":1.000,"
+                         "\"pid\":40000,\"tid\":7,\"args\":{\"unit\":1,\"function\":3}}"));
+    expect(json.contains("{\"name\":\"write_finish\",\"cat\":\"client\",\"ph\":\"X\",\"ts\":1.000,\"dur\":2.500,"
+                         "\"pid\":40000,\"tid\":7,"));
+    expect(json.contains("\"ts\":2.000,\"pid\":40000,\"tid\":8,"));
+    expect(json.ends_with("]}\n"));
+  };
+
+  "client and server trace every step of a transaction"_test = []() {
+    asio::io_context ctx;
+    int port = 15511;
+    auto buffer = std::make_shared<modbus::trace_buffer>();
+    auto handler = std::make_shared<modbus::default_handler>();
+    modbus::server server{ ctx, handler, port, modbus::server_options{}, modbus::buffer_tracing{ buffer } };
+    server.start();
+    modbus::basic_client client{ ctx, modbus::buffer_tracing{ buffer } };
+    bool finished = false;
+    co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+          auto [error] = co_await client.connect("localhost", std::to_string(port), asio::as_tuple(asio::use_awaitable));
+          expect(!error);
+          expect((co_await client.read_holding_registers(1, 0, 4, asio::use_awaitable)).has_value());
+          finished = true;
+        },
+        asio::detached);
+    ctx.run_for(std::chrono::milliseconds(500));
+    expect(finished);
+
+    auto events = buffer->events();
+    expect(points_of(events, modbus::trace_side::client) ==
+           std::vector{ trace_point::write_start, trace_point::write_finish, trace_point::first_byte,
+                        trace_point::frame_complete, trace_point::decode_complete });
+    expect(points_of(events, modbus::trace_side::server) ==
+           std::vector{ trace_point::first_byte, trace_point::frame_complete, trace_point::decode_complete,
+                        trace_point::handler_complete, trace_point::write_start, trace_point::write_finish });
+    expect(std::ranges::all_of(events, [&](auto const& event) {
+      return event.id.source == events.front().id.source && event.id.transaction == 1 && event.id.unit == 1;
+    }));
+    expect(events.front().id.source != 0);
+    expect(std::ranges::is_sorted(events, {}, &modbus::trace_event::timestamp));
+  };
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <memory>
+#include <vector>
+
+#include <modbus/default_handler.hpp>
+#include <modbus/unit_router.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  using router_t = modbus::unit_router<modbus::default_handler>;
+
+  "requests are routed by unit"_test = []() {
+    router_t router;
+    auto first = std::make_shared<modbus::default_handler>();
+    auto second = std::make_shared<modbus::default_handler>();
+    expect(router.add(1, first));
+    expect(router.add(2, second));
+    modbus::errc_t error = modbus::errc::no_error;
+    router.handle(1, modbus::request::write_single_register{ 10, 42 }, error);
+    expect(!error);
+    expect(first->registers[10] == 42);
+    expect(second->registers[10] == 0);
+    auto response = router.handle(2, modbus::request::read_holding_registers{ 10, 1 }, error);
+    expect(!error);
+    expect(response.values == std::vector<std::uint16_t>{ 0 });
+    expect(router.stats(1).requests == 1);
+    expect(router.stats(2).requests == 1);
+  };
+
+  "unrouted units are answered with gateway_path_unavailable"_test = []() {
+    router_t router;
+    modbus::errc_t error = modbus::errc::no_error;
+    router.handle(5, modbus::request::read_coils{ 0, 1 }, error);
+    expect(error == modbus::errc::gateway_path_unavailable);
+    expect(router.stats(5).requests == 1);
+    expect(router.stats(5).exceptions == 1);
+  };
+
+  "reserved units can not be routed"_test = []() {
+    router_t router;
+    expect(!router.add(0, std::make_shared<modbus::default_handler>()));
+    expect(!router.add(248, std::make_shared<modbus::default_handler>()));
+    expect(router.get(0) == nullptr);
+  };
+
+  "broadcast writes reach every unit without a response"_test = []() {
+    router_t router;
+    auto first = std::make_shared<modbus::default_handler>();
+    auto second = std::make_shared<modbus::default_handler>();
+    router.add(1, first);
+    router.add(247, second);
+    expect(!router.responds(0));
+    expect(router.responds(1));
+    modbus::errc_t error = modbus::errc::no_error;
+    router.handle(0, modbus::request::write_multiple_registers{ 3, std::vector<std::uint16_t>{ 7, 8 } }, error);
+    expect(!error);
+    expect(first->registers[3] == 7 && first->registers[4] == 8);
+    expect(second->registers[3] == 7 && second->registers[4] == 8);
+    expect(router.stats(1).broadcasts == 1);
+    expect(router.stats(247).broadcasts == 1);
+    expect(router.stats(1).requests == 0);
+  };
+
+  "broadcast reads are dropped"_test = []() {
+    router_t router;
+    router.add(1, std::make_shared<modbus::default_handler>());
+    modbus::errc_t error = modbus::errc::no_error;
+    router.handle(0, modbus::request::read_holding_registers{ 0, 1 }, error);
+    expect(!error);
+    expect(router.stats(1).broadcasts == 0);
+  };
+
+  "the server dispatches through the router"_test = []() {
+    auto router = std::make_shared<router_t>();
+    router->add(3, std::make_shared<modbus::default_handler>());
+    modbus::request::write_single_coil request{ 1, true };
+    auto pdu = request.serialize();
+    modbus::tcp_mbap header{ .transaction = 1, .protocol = 0, .length = static_cast<uint16_t>(pdu.size() + 1), .unit = 3 };
+    auto response = modbus::handle_request(header, pdu, router);
+    expect(response.has_value());
+    header.unit = 4;
+    response = modbus::handle_request(header, pdu, router);
+    expect(!response.has_value() && response.error() == modbus::errc::gateway_path_unavailable);
+    expect(router->get(3)->coils[1]);
+  };
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <modbus/default_handler.hpp>
+#include <modbus/wire_table.hpp>
+
+#include <boost/ut.hpp>
+
+int main() {
+  using boost::ut::operator""_test;
+  using boost::ut::expect;
+
+  "registers are stored big endian"_test = []() {
+    modbus::wire_table table;
+    expect(table.write(10, std::array<std::uint16_t, 2>{ 0x1234, 0xabcd }) == modbus::errc::no_error);
+    std::array<std::uint8_t, 6> wire{};
+    expect(table.read_wire(9, 3, wire.data()) == modbus::errc::no_error);
+    expect(wire == std::array<std::uint8_t, 6>{ 0x00, 0x00, 0x12, 0x34, 0xab, 0xcd });
+    expect(std::as_const(table)[10] == 0x1234);
+    std::vector<std::uint16_t> host;
+    expect(table.read(10, 2, std::back_inserter(host)) == modbus::errc::no_error);
+    expect(host == std::vector<std::uint16_t>{ 0x1234, 0xabcd });
+  };
+
+  "wire reads cross page boundaries"_test = []() {
+    modbus::wire_table table;
+    table.write(255, std::array<std::uint16_t, 2>{ 1, 2 });
+    std::array<std::uint8_t, 4> wire{};
+    expect(table.read_wire(255, 2, wire.data()) == modbus::errc::no_error);
+    expect(wire == std::array<std::uint8_t, 4>{ 0, 1, 0, 2 });
+    expect(table.allocated_pages() == 2);
+  };
+
+  "page flags are honoured"_test = []() {
+    modbus::wire_table table;
+    table.set_flags(0, 1, modbus::page_flags::absent);
+    std::array<std::uint8_t, 2> wire{};
+    expect(table.read_wire(0, 1, wire.data()) == modbus::errc::illegal_data_address);
+    expect(table.read_wire(0xffff, 2, wire.data()) == modbus::errc::illegal_data_address);
+  };
+
+  "typed accessors span registers most significant first"_test = []() {
+    modbus::wire_table table;
+    table.store<std::uint32_t>(20, 0x11223344U);
+    expect(std::as_const(table)[20] == 0x1122);
+    expect(std::as_const(table)[21] == 0x3344);
+    expect(table.load<std::uint32_t>(20) == 0x11223344U);
+    table.store(30, 1.5F);
+    expect(table.load<float>(30) == 1.5F);
+    table.store<std::int16_t>(40, -2);
+    expect(table.load<std::int16_t>(40) == -2);
+  };
+
+  "wire handler answers like the default handler"_test = []() {
+    auto host = std::make_shared<modbus::default_handler>();
+    auto wire = std::make_shared<modbus::wire_default_handler>();
+    std::vector<std::uint16_t> values{ 1, 0x0203, 0xfffe, 42 };
+    host->registers.write(100, values);
+    wire->registers.write(100, values);
+    host->input_registers.write(7, values);
+    wire->input_registers.write(7, values);
+    modbus::tcp_mbap header{ .transaction = 1, .protocol = 0, .length = 6, .unit = 1 };
+    auto holding = modbus::request::read_holding_registers{ 99, 6 }.serialize();
+    auto input = modbus::request::read_input_registers{ 7, 4 }.serialize();
+    expect(modbus::handle_request(header, holding, wire) == modbus::handle_request(header, holding, host));
+    expect(modbus::handle_request(header, input, wire) == modbus::handle_request(header, input, host));
+    auto mask = modbus::request::mask_write_register{ 101, 0x00ff, 0x1100 }.serialize();
+    expect(modbus::handle_request(header, mask, wire).has_value());
+    expect(std::as_const(wire->registers)[101] == 0x1103);
+    auto out_of_range = modbus::request::read_holding_registers{ 0xfffe, 4 }.serialize();
+    expect(modbus::handle_request(header, out_of_range, wire).error() == modbus::errc::illegal_data_address);
+  };
+
+  "wire reads are encoded straight into the frame"_test = []() {
+    using read_request = modbus::request::read_holding_registers;
+    static_assert(modbus::impl::encoding_handler_for<modbus::wire_default_handler, read_request>);
+    static_assert(!modbus::impl::encoding_handler_for<modbus::default_handler, read_request>);
+    modbus::wire_default_handler wire;
+    wire.registers.write(10, std::vector<std::uint16_t>{ 0x0102, 0x0304 });
+    std::array<std::uint8_t, 6> frame{};
+    expect(modbus::impl::handle_sync(wire, 1, read_request{ 10, 2 }, frame) == std::size_t{ 6 });
+    expect(frame == std::array<std::uint8_t, 6>{ 0x03, 4, 1, 2, 3, 4 });
+    auto too_long = modbus::impl::handle_sync(wire, 1, read_request{ 10, 3 }, frame);
+    expect(!too_long.has_value() && too_long.error() == modbus::errc::illegal_data_value);
+  };
+}
@@ -0,0 +1,423 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// Open loop load generator for capacity testing Modbus TCP servers.
+//
+// Opens many modbus::client connections and sends a weighted mix of requests at a fixed total rate. Every
+// connection follows its own schedule of send times, spread evenly over the interval so the connections do
+// not fire at once. A request that is late, because the server was slow to answer the previous one, is sent
+// as soon as possible and its latency is measured from the time it was scheduled for, so a stalled server
+// shows in the percentiles instead of hiding behind fewer samples (coordinated omission).
+//
+// The report holds latency percentiles and histogram, service time percentiles (the round trip of the
+// request on the wire), exception responses by code and errors by category.
+//
+// usage: modbus_load --host 127.0.0.1 --port 502 [--connections 100] [--rate 1000] [--duration 10]
+//                    [--threads 1] [--unit 1] [--address 0] [--count 16] [--timeout 1000]
+//                    [--mix read_holding_registers:8,write_multiple_registers:2]
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <asio/steady_timer.hpp>
+
+#include <modbus/client.hpp>
+#include <modbus/metrics.hpp>
+
+namespace {
+
+using std::chrono::steady_clock;
+
+constexpr std::array<std::string_view, 8> function_names{
+  "read_coils",           "read_discrete_inputs",  "read_holding_registers", "read_input_registers",
+  "write_single_coil",    "write_single_register", "write_multiple_coils",   "write_multiple_registers",
+};
+
+struct options {
+  std::string host{ "127.0.0.1" };
+  std::string port{ "502" };
+  std::size_t connections{ 100 };
+  double rate{ 1000 };
+  std::chrono::seconds duration{ 10 };
+  std::size_t threads{ 1 };
+  std::uint8_t unit{ 1 };
+  std::uint16_t address{};
+  std::uint16_t count{ 16 };
+  std::chrono::milliseconds timeout{ 1000 };
+  /// Weight of every entry of function_names.
+  std::array<unsigned, function_names.size()> weights{ 0, 0, 1 };
+};
+
+/// Errors that are not exception responses, by category and value.
+class error_breakdown {
+public:
+  void add(std::error_code const& error) {
+    auto& entry = entries_[{ error.category().name(), error.value() }];
+    if (entry.count++ == 0) {
+      entry.message = error.message();
+    }
+  }
+
+  void merge(error_breakdown const& other) {
+    for (auto const& [key, entry] : other.entries_) {
+      auto& mine = entries_[key];
+      mine.count += entry.count;
+      mine.message = entry.message;
+    }
+  }
+
+  [[nodiscard]] auto total() const -> std::uint64_t {
+    std::uint64_t sum{};
+    for (auto const& [key, entry] : entries_) {
+      sum += entry.count;
+    }
+    return sum;
+  }
+
+  void print(std::ostream& out) const {
+    for (auto const& [key, entry] : entries_) {
+      out << "  " << std::setw(10) << entry.count << "  " << key.first << ':' << key.second << ' ' << entry.message << '\n';
+    }
+  }
+
+private:
+  struct entry_t {
+    std::uint64_t count{};
+    std::string message;
+  };
+
+  std::map<std::pair<std::string, int>, entry_t> entries_;
+};
+
+/// The state shared by the connections of one thread.
+struct worker {
+  asio::io_context ctx{ 1 };
+  std::vector<std::unique_ptr<modbus::client>> clients;
+  error_breakdown errors;
+  std::uint64_t sent{};
+  std::uint64_t timeouts{};
+};
+
+/// Send one request of the function at index of function_names.
+auto send(modbus::client& client, options const& setup, std::size_t function) -> asio::awaitable<std::error_code> {
+  auto result_of = [](auto const& result) { return result.has_value() ? std::error_code{} : result.error(); };
+  auto unit = setup.unit;
+  auto address = setup.address;
+  auto count = setup.count;
+  switch (function) {
+    case 0:
+      co_return result_of(co_await client.read_coils_view(unit, address, count, asio::use_awaitable));
+    case 1:
+      co_return result_of(co_await client.read_discrete_inputs_view(unit, address, count, asio::use_awaitable));
+    case 2:
+      co_return result_of(co_await client.read_holding_registers_view(unit, address, count, asio::use_awaitable));
+    case 3:
+      co_return result_of(co_await client.read_input_registers_view(unit, address, count, asio::use_awaitable));
+    case 4:
+      co_return result_of(co_await client.write_single_coil(unit, address, true, asio::use_awaitable));
+    case 5:
+      co_return result_of(co_await client.write_single_register(unit, address, 42, asio::use_awaitable));
+    case 6:
+      co_return result_of(co_await client.write_multiple_coils(unit, address, std::vector<bool>(count, true),
+                                                               asio::use_awaitable));
+    default:
+      co_return result_of(co_await client.write_multiple_registers(unit, address, std::vector<std::uint16_t>(count, 42),
+                                                                   asio::use_awaitable));
+  }
+}
+
+void close_quietly(modbus::client& client) {
+  try {
+    client.close();
+  } catch (std::exception const&) {
+    // The server already closed the connection.
+  }
+}
+
+/// Send requests on client at the times of its schedule until deadline, reconnecting after failures.
+auto drive(worker& state,
+           modbus::client& client,
+           options const& setup,
+           steady_clock::duration interval,
+           steady_clock::time_point first,
+           steady_clock::time_point deadline,
+           modbus::metrics& latencies,
+           std::uint32_t seed) -> asio::awaitable<void> {
+  asio::steady_timer pacing{ state.ctx };
+  asio::steady_timer watchdog{ state.ctx };
+  // The last attempt whose watchdog expired, shared with handlers that may run after the loop is done.
+  auto expired = std::make_shared<std::uint64_t>(0);
+  std::uint64_t attempt{};
+  std::minstd_rand random{ seed };
+  std::discrete_distribution<std::size_t> mix{ setup.weights.begin(), setup.weights.end() };
+  for (auto scheduled = first; scheduled < deadline; scheduled += interval) {
+    if (steady_clock::now() < scheduled) {
+      pacing.expires_at(scheduled);
+      co_await pacing.async_wait(asio::as_tuple(asio::use_awaitable));
+    }
+    if (!client.is_connected()) {
+      auto [error] = co_await client.connect(setup.host, setup.port, asio::as_tuple(asio::use_awaitable));
+      if (error) {
+        state.errors.add(error);
+        continue;
+      }
+    }
+
+    // The client cannot cancel a single transaction, a request running past the timeout closes the connection.
+    watchdog.expires_after(setup.timeout);
+    watchdog.async_wait([&client, expired, current = ++attempt](std::error_code const& error) {
+      if (!error && *expired < current) {
+        *expired = current;
+        close_quietly(client);
+      }
+    });
+    ++state.sent;
+    auto error = co_await send(client, setup, mix(random));
+    bool timed_out = *expired == attempt;
+    // A watchdog expiring along with the response must not close the connection of the next request.
+    watchdog.cancel();
+    *expired = attempt;
+
+    // Modbus category codes from message_size_mismatch on are malformed responses, not answers of the server.
+    bool malformed = error && error.category() == modbus::modbus_category() &&
+                     error.value() >= modbus::errc::message_size_mismatch;
+    if (timed_out) {
+      ++state.timeouts;
+    } else if (!error || (error.category() == modbus::modbus_category() && !malformed)) {
+      // Exception responses are answers too, the client registry counts them by code.
+      latencies.round_trip(steady_clock::now() - scheduled);
+    } else {
+      // Socket errors and malformed responses leave the stream out of step, start over on a new connection.
+      state.errors.add(error);
+      close_quietly(client);
+    }
+  }
+}
+
+auto percentile_line(modbus::histogram_snapshot const& histogram) -> std::string {
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(3);
+  for (auto [name, fraction] : std::initializer_list<std::pair<std::string_view, double>>{
+           { "p50", 0.5 }, { "p90", 0.9 }, { "p99", 0.99 }, { "p99.9", 0.999 }, { "p99.99", 0.9999 }, { "max", 1.0 } }) {
+    line << "  " << name << ' ' << std::chrono::duration<double, std::milli>(histogram.percentile(fraction)).count()
+         << " ms";
+  }
+  return line.str();
+}
+
+/// Print histogram with one row per power of two.
+void print_histogram(modbus::histogram_snapshot const& histogram, std::ostream& out) {
+  auto total = histogram.count();
+  std::uint64_t seen{};
+  std::uint64_t row{};
+  constexpr auto sub_buckets = modbus::histogram_snapshot::sub_buckets;
+  for (std::size_t index = 0; index < modbus::histogram_snapshot::bucket_count; ++index) {
+    row += histogram.counts[index];
+    if (index % sub_buckets != sub_buckets - 1 || row == 0) {
+      continue;
+    }
+    seen += row;
+    auto upper = std::chrono::nanoseconds{ modbus::histogram_snapshot::upper_bound(index) };
+    out << "  <= " << std::setw(12) << std::fixed << std::setprecision(3)
+        << std::chrono::duration<double, std::milli>(upper).count() << " ms " << std::setw(12) << row << std::setw(9)
+        << std::setprecision(3) << 100.0 * static_cast<double>(seen) / static_cast<double>(total) << " %\n";
+    row = 0;
+  }
+}
+
+auto parse_mix(std::string_view text, options& setup) -> bool {
+  setup.weights.fill(0);
+  while (!text.empty()) {
+    auto comma = text.find(',');
+    auto entry = text.substr(0, comma);
+    text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+    auto colon = entry.find(':');
+    auto name = entry.substr(0, colon);
+    auto found = std::ranges::find(function_names, name);
+    if (found == function_names.end()) {
+      std::cerr << "unknown function " << name << '\n';
+      return false;
+    }
+    auto weight =
+        colon == std::string_view::npos ? 1 : std::strtoul(std::string{ entry.substr(colon + 1) }.c_str(), nullptr, 10);
+    setup.weights[static_cast<std::size_t>(found - function_names.begin())] = static_cast<unsigned>(weight);
+  }
+  return std::ranges::any_of(setup.weights, [](auto weight) { return weight != 0; });
+}
+
+auto parse(int argc, char** argv, options& setup) -> bool {
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string_view option{ argv[index] };
+    std::string value{ argv[index + 1] };
+    auto number = [&value]() { return std::strtoul(value.c_str(), nullptr, 10); };
+    if (option == "--host") {
+      setup.host = value;
+    } else if (option == "--port") {
+      setup.port = value;
+    } else if (option == "--connections") {
+      setup.connections = std::max<std::size_t>(number(), 1);
+    } else if (option == "--rate") {
+      setup.rate = std::strtod(value.c_str(), nullptr);
+    } else if (option == "--duration") {
+      setup.duration = std::chrono::seconds{ number() };
+    } else if (option == "--threads") {
+      setup.threads = std::max<std::size_t>(number(), 1);
+    } else if (option == "--unit") {
+      setup.unit = static_cast<std::uint8_t>(number());
+    } else if (option == "--address") {
+      setup.address = static_cast<std::uint16_t>(number());
+    } else if (option == "--count") {
+      // The largest count every function of the mix accepts.
+      setup.count = static_cast<std::uint16_t>(std::clamp<unsigned long>(number(), 1, 123));
+    } else if (option == "--timeout") {
+      setup.timeout = std::chrono::milliseconds{ number() };
+    } else if (option == "--mix") {
+      if (!parse_mix(value, setup)) {
+        return false;
+      }
+    } else {
+      std::cerr << "unknown option " << option << '\n';
+      return false;
+    }
+  }
+  return (argc % 2) == 1 && setup.rate > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  options setup;
+  if (!parse(argc, argv, setup)) {
+    std::cerr << "usage: " << argv[0]
+              << " --host 127.0.0.1 --port 502 [--connections 100] [--rate 1000] [--duration 10] [--threads 1]\n"
+                 "         [--unit 1] [--address 0] [--count 16] [--timeout 1000]\n"
+                 "         [--mix read_holding_registers:8,write_multiple_registers:2]\n";
+    return 1;
+  }
+
+  // One descriptor per connection and a few to spare.
+  rlimit files{};
+  getrlimit(RLIMIT_NOFILE, &files);
+  files.rlim_cur = files.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &files);
+  if (setup.connections + 64 > files.rlim_cur) {
+    std::cerr << "the file descriptor limit allows " << (files.rlim_cur > 64 ? files.rlim_cur - 64 : 0)
+              << " connections\n";
+    return 1;
+  }
+
+  auto service = std::make_shared<modbus::metrics>(setup.threads);
+  // Only the round_trip histogram is used, it holds the latencies measured from the scheduled send times.
+  modbus::metrics latencies{ setup.threads };
+  std::vector<std::unique_ptr<worker>> workers;
+  for (std::size_t index = 0; index < setup.threads; ++index) {
+    workers.push_back(std::make_unique<worker>());
+  }
+
+  // Connect one at a time on every thread, so the listen backlog of the server is not exceeded.
+  std::vector<std::thread> threads;
+  for (std::size_t index = 0; index < setup.threads; ++index) {
+    auto& state = *workers[index];
+    for (std::size_t connection = index; connection < setup.connections; connection += setup.threads) {
+      state.clients.push_back(std::make_unique<modbus::client>(state.ctx));
+      state.clients.back()->set_metrics(service);
+    }
+    co_spawn(
+        state.ctx,
+        [&state, &setup]() -> asio::awaitable<void> {
+          for (auto& client : state.clients) {
+            auto [error] = co_await client->connect(setup.host, setup.port, asio::as_tuple(asio::use_awaitable));
+            if (error) {
+              state.errors.add(error);
+            }
+          }
+        },
+        asio::detached);
+    threads.emplace_back([&state]() { state.ctx.run(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  std::size_t connected{};
+  for (auto& state : workers) {
+    connected += static_cast<std::size_t>(std::ranges::count_if(state->clients, [](auto& client) {
+      return client->is_connected();
+    }));
+  }
+  std::cout << "connected " << connected << " of " << setup.connections << " connections to " << setup.host << ':'
+            << setup.port << '\n';
+
+  // Every connection sends rate / connections requests per second, the first ones spread over one interval.
+  auto interval = std::chrono::duration_cast<steady_clock::duration>(
+      std::chrono::duration<double>(static_cast<double>(setup.connections) / setup.rate));
+  auto start = steady_clock::now() + std::chrono::milliseconds{ 10 };
+  auto deadline = start + setup.duration;
+  std::uint32_t seed{};
+  for (std::size_t index = 0; index < setup.threads; ++index) {
+    auto& state = *workers[index];
+    state.ctx.restart();
+    for (std::size_t position = 0; position < state.clients.size(); ++position) {
+      auto connection = index + position * setup.threads;
+      auto first = start + interval * static_cast<std::int64_t>(connection) / static_cast<std::int64_t>(setup.connections);
+      co_spawn(state.ctx, drive(state, *state.clients[position], setup, interval, first, deadline, latencies, ++seed),
+               asio::detached);
+    }
+    threads.emplace_back([&state]() { state.ctx.run(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto elapsed = steady_clock::now() - start;
+
+  error_breakdown errors;
+  std::uint64_t sent{};
+  std::uint64_t timeouts{};
+  for (auto& state : workers) {
+    errors.merge(state->errors);
+    sent += state->sent;
+    timeouts += state->timeouts;
+    for (auto& client : state->clients) {
+      close_quietly(*client);
+    }
+  }
+
+  auto latency = latencies.snapshot().round_trip;
+  auto counters = service->snapshot();
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << std::fixed << std::setprecision(1) << "target " << setup.rate << " req/s, sent " << sent
+            << ", answered " << latency.count() << " (" << static_cast<double>(latency.count()) / seconds
+            << " req/s), timeouts " << timeouts << ", errors " << errors.total() << ", reconnects "
+            << counters[modbus::metric::reconnects] << '\n';
+  std::cout << "sent " << counters[modbus::metric::bytes_out] << " bytes, received " << counters[modbus::metric::bytes_in]
+            << " bytes\n";
+  std::cout << "latency from schedule:" << percentile_line(latency) << '\n';
+  std::cout << "service time:         " << percentile_line(counters.round_trip) << '\n';
+  std::cout << "latency histogram:\n";
+  print_histogram(latency, std::cout);
+  std::cout << "exception responses:\n";
+  for (std::size_t code = 1; code < counters.exceptions.size(); ++code) {
+    if (counters.exceptions[code] != 0) {
+      std::cout << "  " << std::setw(10) << counters.exceptions[code] << "  "
+                << modbus::modbus_error(static_cast<modbus::errc_t>(code)).message() << '\n';
+    }
+  }
+  std::cout << "errors:\n";
+  errors.print(std::cout);
+  return errors.total() + timeouts == 0 ? 0 : 2;
+}
@@ -0,0 +1,349 @@
+// Copyright (c) 2024, Skaginn3x (https://skaginn3x.com)
+
+// Replay traffic recorded by modbus::capture_log.
+//
+//   modbus_replay pcapng <capture> <out.pcapng>
+//     Convert a capture to pcapng for Wireshark.
+//   modbus_replay server <capture> [--host 127.0.0.1] [--port 502] [--speed 1] [--timeout 1000]
+//     Send the recorded requests of every connection to a server on a connection of its own, at the
+//     recorded times divided by speed, zero for as fast as possible. Responses are compared to the
+//     recorded ones and their round trip times reported.
+//   modbus_replay client <capture> [--port 502] [--speed 1]
+//     Act as the recorded server. The n-th accepted connection is answered with the responses of the
+//     n-th recorded connection, in order and with the recorded delays divided by speed. Exits once
+//     every recorded connection has been replayed.
+//
+// Captures of the client side and the server side of a connection both work, they hold the same ADUs.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <asio/any_io_executor.hpp>
+#include <asio/as_tuple.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/read.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include <modbus/capture.hpp>
+#include <modbus/constants.hpp>
+#include <modbus/metrics.hpp>
+#include <modbus/tcp.hpp>
+
+namespace {
+
+using asio::ip::tcp;
+using std::chrono::steady_clock;
+
+/// The ADUs of one recorded connection, in the order they were recorded.
+struct recorded_connection {
+  std::vector<modbus::captured_adu const*> requests;
+  std::vector<modbus::captured_adu const*> responses;
+};
+
+struct options {
+  std::string host{ "127.0.0.1" };
+  std::string port{ "502" };
+  double speed{ 1.0 };
+  std::chrono::milliseconds timeout{ 1000 };
+};
+
+struct replay_stats {
+  std::uint64_t sent{};
+  std::uint64_t answered{};
+  std::uint64_t matched{};
+  std::uint64_t differing{};
+  std::uint64_t errors{};
+  modbus::metrics latencies{ 1 };
+};
+
+auto group_connections(std::vector<modbus::captured_adu> const& adus) -> std::vector<recorded_connection> {
+  std::vector<recorded_connection> connections;
+  std::map<std::pair<std::uint16_t, std::uint16_t>, std::size_t> index;
+  for (auto const& entry : adus) {
+    auto [found, inserted] = index.try_emplace({ entry.ports.client, entry.ports.server }, connections.size());
+    if (inserted) {
+      connections.emplace_back();
+    }
+    auto& connection = connections[found->second];
+    (entry.direction == modbus::capture_direction::to_server ? connection.requests : connection.responses)
+        .push_back(&entry);
+  }
+  return connections;
+}
+
+auto transaction_of(std::span<std::uint8_t const> adu) -> std::uint16_t {
+  return adu.size() < 2 ? 0 : static_cast<std::uint16_t>((adu[0] << 8U) | adu[1]);
+}
+
+/// The recorded offset from the start of the capture, scaled by speed.
+auto scaled(std::int64_t timestamp, std::int64_t first, double speed) -> steady_clock::duration {
+  if (speed <= 0) {
+    return {};
+  }
+  auto offset = std::chrono::nanoseconds{ timestamp - first };
+  return std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double, std::nano>(offset) / speed);
+}
+
+/// Read one ADU, empty when the connection failed.
+auto read_adu(tcp::socket& socket) -> asio::awaitable<std::vector<std::uint8_t>> {
+  std::vector<std::uint8_t> adu(modbus::tcp_mbap::size);
+  auto [header_error, header_size] =
+      co_await asio::async_read(socket, asio::buffer(adu), asio::as_tuple(asio::use_awaitable));
+  auto header = modbus::tcp_mbap::from_bytes(std::span(adu).first<modbus::tcp_mbap::size>());
+  if (header_error || header.length < 1 || header.length - 1U > modbus::modbus_max_pdu) {
+    co_return std::vector<std::uint8_t>{};
+  }
+  adu.resize(modbus::tcp_mbap::size + header.length - 1U);
+  auto [body_error, body_size] = co_await asio::async_read(
+      socket, asio::buffer(adu.data() + modbus::tcp_mbap::size, adu.size() - modbus::tcp_mbap::size),
+      asio::as_tuple(asio::use_awaitable));
+  co_return body_error ? std::vector<std::uint8_t>{} : adu;
+}
+
+/// State of a connection replaying requests, shared with the coroutine reading the responses.
+struct request_replay {
+  explicit request_replay(asio::any_io_executor const& executor) : socket{ executor } {}
+
+  tcp::socket socket;
+  /// Recorded responses not yet received, by transaction.
+  std::multimap<std::uint16_t, modbus::captured_adu const*> expected;
+  /// Send times of the requests waiting for their response, by transaction.
+  std::map<std::uint16_t, steady_clock::time_point> pending;
+};
+
+/// Read responses of replay and compare them with the recorded ones until the connection closes.
+auto read_responses(std::shared_ptr<request_replay> replay, replay_stats& stats) -> asio::awaitable<void> {
+  for (;;) {
+    auto adu = co_await read_adu(replay->socket);
+    if (adu.empty()) {
+      co_return;
+    }
+    auto transaction = transaction_of(adu);
+    if (auto sent = replay->pending.find(transaction); sent != replay->pending.end()) {
+      stats.latencies.round_trip(steady_clock::now() - sent->second);
+      replay->pending.erase(sent);
+    }
+    ++stats.answered;
+    auto recorded = replay->expected.find(transaction);
+    if (recorded != replay->expected.end() && recorded->second->adu == adu) {
+      ++stats.matched;
+    } else {
+      ++stats.differing;
+    }
+    if (recorded != replay->expected.end()) {
+      replay->expected.erase(recorded);
+    }
+  }
+}
+
+/// Send the requests of recorded to server and compare the responses with the recorded ones.
+auto replay_requests(recorded_connection const& recorded,
+                     tcp::endpoint server,
+                     steady_clock::time_point start,
+                     std::int64_t first,
+                     options const& setup,
+                     replay_stats& stats) -> asio::awaitable<void> {
+  auto executor = co_await asio::this_coro::executor;
+  auto replay = std::make_shared<request_replay>(executor);
+  auto [connect_error] = co_await replay->socket.async_connect(server, asio::as_tuple(asio::use_awaitable));
+  if (connect_error) {
+    stats.errors += recorded.requests.size();
+    co_return;
+  }
+  replay->socket.set_option(tcp::no_delay{ true });
+  for (auto const* response : recorded.responses) {
+    replay->expected.emplace(transaction_of(response->adu), response);
+  }
+  asio::co_spawn(executor, read_responses(replay, stats), asio::detached);
+
+  asio::steady_timer timer{ executor };
+  for (auto const* request : recorded.requests) {
+    timer.expires_at(start + scaled(request->timestamp, first, setup.speed));
+    co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+    replay->pending[transaction_of(request->adu)] = steady_clock::now();
+    auto [write_error, written] =
+        co_await asio::async_write(replay->socket, asio::buffer(request->adu), asio::as_tuple(asio::use_awaitable));
+    if (write_error) {
+      ++stats.errors;
+      break;
+    }
+    ++stats.sent;
+  }
+
+  // Give the last responses time to arrive.
+  auto deadline = steady_clock::now() + setup.timeout;
+  while (!replay->pending.empty() && steady_clock::now() < deadline) {
+    timer.expires_after(std::chrono::milliseconds{ 5 });
+    co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+  }
+  stats.errors += replay->pending.size();
+  asio::error_code ignored;
+  replay->socket.close(ignored);
+}
+
+/// Answer the requests of a client with the responses of recorded, in order.
+auto replay_responses(tcp::socket socket, recorded_connection const& recorded, options const& setup, replay_stats& stats)
+    -> asio::awaitable<void> {
+  asio::steady_timer timer{ socket.get_executor() };
+  for (std::size_t index = 0; index < recorded.responses.size(); ++index) {
+    auto request = co_await read_adu(socket);
+    if (request.empty()) {
+      break;
+    }
+    auto response = recorded.responses[index]->adu;
+    if (index < recorded.requests.size()) {
+      auto delay = scaled(recorded.responses[index]->timestamp, recorded.requests[index]->timestamp, setup.speed);
+      timer.expires_after(std::max(delay, steady_clock::duration::zero()));
+      co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+      if (recorded.requests[index]->adu.size() > 7 && request.size() > 7 &&
+          recorded.requests[index]->adu[7] == request[7]) {
+        ++stats.matched;
+      } else {
+        ++stats.differing;
+      }
+    }
+    // Answer with the transaction id of the request, the client may have numbered them differently.
+    response[0] = request[0];
+    response[1] = request[1];
+    auto [write_error, written] =
+        co_await asio::async_write(socket, asio::buffer(response), asio::as_tuple(asio::use_awaitable));
+    if (write_error) {
+      ++stats.errors;
+      break;
+    }
+    ++stats.sent;
+  }
+  asio::error_code ignored;
+  socket.close(ignored);
+}
+
+void print_latency(replay_stats const& stats) {
+  auto round_trip = stats.latencies.snapshot().round_trip;
+  std::cout << std::fixed << std::setprecision(3) << "round trip:";
+  for (auto [name, fraction] : std::initializer_list<std::pair<std::string_view, double>>{
+           { "p50", 0.5 }, { "p99", 0.99 }, { "p99.9", 0.999 }, { "max", 1.0 } }) {
+    std::cout << "  " << name << ' '
+              << std::chrono::duration<double, std::milli>(round_trip.percentile(fraction)).count() << " ms";
+  }
+  std::cout << '\n';
+}
+
+auto parse(int argc, char** argv, options& setup) -> bool {
+  for (int index = 3; index + 1 < argc; index += 2) {
+    std::string_view option{ argv[index] };
+    std::string value{ argv[index + 1] };
+    if (option == "--host") {
+      setup.host = value;
+    } else if (option == "--port") {
+      setup.port = value;
+    } else if (option == "--speed") {
+      setup.speed = std::strtod(value.c_str(), nullptr);
+    } else if (option == "--timeout") {
+      setup.timeout = std::chrono::milliseconds{ std::strtol(value.c_str(), nullptr, 10) };
+    } else {
+      std::cerr << "unknown option " << option << '\n';
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string_view mode{ argc > 1 ? argv[1] : "" };
+  options setup;
+  bool convert = mode == "pcapng" && argc == 4;
+  if (argc < 3 || (!convert && ((mode != "server" && mode != "client") || !parse(argc, argv, setup)))) {
+    std::cerr << "usage: " << argv[0] << " pcapng <capture> <out.pcapng>\n"
+              << "       " << argv[0]
+              << " server <capture> [--host 127.0.0.1] [--port 502] [--speed 1] [--timeout 1000]\n"
+              << "       " << argv[0] << " client <capture> [--port 502] [--speed 1]\n";
+    return 1;
+  }
+
+  auto adus = modbus::read_capture(argv[2]);
+  if (!adus) {
+    std::cerr << "can not read " << argv[2] << ": " << adus.error().message() << '\n';
+    return 1;
+  }
+  if (convert) {
+    std::string pcapng;
+    modbus::write_pcapng(*adus, pcapng);
+    std::ofstream out{ argv[3], std::ios::binary };
+    out.write(pcapng.data(), static_cast<std::streamsize>(pcapng.size()));
+    return out ? 0 : 1;
+  }
+
+  auto connections = group_connections(*adus);
+  std::cout << "replaying " << adus->size() << " ADUs of " << connections.size() << " connections\n";
+  if (adus->empty()) {
+    return 0;
+  }
+  asio::io_context ctx;
+  replay_stats stats;
+  auto started = steady_clock::now();
+
+  if (mode == "server") {
+    tcp::resolver resolver{ ctx };
+    asio::error_code resolve_error;
+    auto endpoints = resolver.resolve(setup.host, setup.port, resolve_error);
+    if (resolve_error || endpoints.empty()) {
+      std::cerr << "can not resolve " << setup.host << ": " << resolve_error.message() << '\n';
+      return 1;
+    }
+    auto start = steady_clock::now() + std::chrono::milliseconds{ 10 };
+    for (auto const& connection : connections) {
+      asio::co_spawn(ctx,
+                     replay_requests(connection, endpoints.begin()->endpoint(), start, adus->front().timestamp, setup,
+                                     stats),
+                     asio::detached);
+    }
+    ctx.run();
+    std::cout << "sent " << stats.sent << " requests, " << stats.answered << " answered, " << stats.matched
+              << " as recorded, " << stats.differing << " differently, " << stats.errors << " errors\n";
+    print_latency(stats);
+  } else {
+    tcp::acceptor acceptor{ ctx, tcp::endpoint{ tcp::v4(), static_cast<std::uint16_t>(std::stoi(setup.port)) } };
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+          for (auto const& connection : connections) {
+            auto [accept_error, socket] = co_await acceptor.async_accept(asio::as_tuple(asio::use_awaitable));
+            if (accept_error) {
+              ++stats.errors;
+              co_return;
+            }
+            socket.set_option(tcp::no_delay{ true });
+            asio::co_spawn(ctx, replay_responses(std::move(socket), connection, setup, stats), asio::detached);
+          }
+        },
+        asio::detached);
+    ctx.run();
+    std::cout << "sent " << stats.sent << " responses, " << stats.matched << " to the recorded function, "
+              << stats.differing << " to another, " << stats.errors << " errors\n";
+  }
+  std::cout << "took " << std::chrono::duration<double>(steady_clock::now() - started).count() << " s, recorded "
+            << std::chrono::duration<double>(std::chrono::nanoseconds{ adus->back().timestamp - adus->front().timestamp })
+                   .count()
+            << " s\n";
+  return stats.errors == 0 ? 0 : 2;
+}